@@ -0,0 +1,70 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include <iostream>
+#include <string>
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+namespace benchmark = mapcrafter::benchmark;
+
+int main(int argc, char** argv) {
+	benchmark::Options options;
+	std::string filter;
+	fs::path json_file;
+
+	po::options_description all("Allowed options");
+	all.add_options()
+		("help,h", "shows a help message")
+		("filter,f", po::value<std::string>(&filter),
+			"runs only the benchmarks whose names contain this string")
+		("min-time,t", po::value<double>(&options.min_time)->default_value(1),
+			"how many seconds every benchmark runs at least")
+		("data-dir,d", po::value<fs::path>(&options.data_dir)->default_value(BENCHMARK_DATA_DIR),
+			"the directory with the test data (region files and images)")
+		("texture-dir,i", po::value<fs::path>(&options.texture_dir),
+			"the path to the textures to render with (default: the installed textures)")
+		("json,j", po::value<fs::path>(&json_file),
+			"writes the results to a JSON file, to compare them with other builds");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, all), vm);
+	} catch (po::error& ex) {
+		std::cout << "There is a problem parsing the command line arguments: "
+				<< ex.what() << std::endl << std::endl;
+		std::cout << all << std::endl;
+		return 1;
+	}
+
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		std::cout << all << std::endl;
+		return 1;
+	}
+
+	if (benchmark::runBenchmarks(options, filter, json_file) == 0) {
+		std::cerr << "No benchmarks match '" << filter << "'." << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include "../mapcraftercore/renderer/image.h"
+#include "../mapcraftercore/renderer/image/scaling.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace benchmark = mapcrafter::benchmark;
+
+using namespace mapcrafter::renderer;
+
+namespace {
+
+/**
+ * Creates an image with some noise, optionally with partly transparent pixels
+ * (transparent at the edges, opaque in the middle, like block images).
+ */
+RGBAImage createImage(int width, int height, bool transparent) {
+	RGBAImage image(width, height);
+	std::srand(42);
+	for (int x = 0; x < width; x++)
+		for (int y = 0; y < height; y++) {
+			uint8_t alpha = 255;
+			if (transparent) {
+				int edge = std::min(std::min(x, width - 1 - x), std::min(y, height - 1 - y));
+				alpha = std::min(edge * 32, 255);
+			}
+			image.pixel(x, y) = rgba(std::rand() % 256, std::rand() % 256,
+					std::rand() % 256, alpha);
+		}
+	return image;
+}
+
+/**
+ * Reads the test image which is written as PNG, skips the benchmark if that's not
+ * possible.
+ */
+bool readImage(benchmark::State& state, RGBAImage& image) {
+	fs::path file = benchmark::getOptions().data_dir / "platypus.png";
+	if (!image.readPNG(file.string())) {
+		state.skip("unable to read '" + file.string() + "'");
+		return false;
+	}
+	return true;
+}
+
+fs::path getTemporaryFile() {
+	return fs::temp_directory_path() / fs::unique_path("mapcrafter-benchmark-%%%%-%%%%.png");
+}
+
+}
+
+BENCHMARK(image_alpha_blit) {
+	// blits block sized images overlapping each other onto a tile
+	RGBAImage tile(512, 512), block = createImage(32, 32, true);
+	int blits = 0;
+	while (state.keepRunning()) {
+		tile.clear();
+		blits = 0;
+		for (int y = 0; y <= 512 - 32; y += 16)
+			for (int x = 0; x <= 512 - 32; x += 16, blits++)
+				tile.alphaBlit(block, x, y);
+	}
+	state.setItemsPerIteration(blits, "blits");
+	state.setBytesPerIteration((uint64_t) blits * 32 * 32 * sizeof(RGBAPixel));
+}
+
+BENCHMARK(image_resize_half) {
+	RGBAImage image = createImage(1024, 1024, false), half;
+	while (state.keepRunning())
+		imageResizeHalf(image, half);
+	state.setItemsPerIteration(1024 * 1024, "pixels");
+	state.setBytesPerIteration(1024 * 1024 * sizeof(RGBAPixel));
+}
+
+BENCHMARK(image_write_png) {
+	RGBAImage image;
+	if (!readImage(state, image))
+		return;
+
+	fs::path file = getTemporaryFile();
+	while (state.keepRunning())
+		image.writePNG(file.string());
+	fs::remove(file);
+	state.setItemsPerIteration(image.getWidth() * image.getHeight(), "pixels");
+	state.setBytesPerIteration(image.getWidth() * image.getHeight() * sizeof(RGBAPixel));
+}
+
+BENCHMARK(image_write_indexed_png) {
+	RGBAImage image;
+	if (!readImage(state, image))
+		return;
+
+	fs::path file = getTemporaryFile();
+	while (state.keepRunning())
+		image.writeIndexedPNG(file.string());
+	fs::remove(file);
+	state.setItemsPerIteration(image.getWidth() * image.getHeight(), "pixels");
+	state.setBytesPerIteration(image.getWidth() * image.getHeight() * sizeof(RGBAPixel));
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include "../mapcraftercore/mc/chunk.h"
+#include "../mapcraftercore/mc/nbt.h"
+#include "../mapcraftercore/mc/region.h"
+#include "../mapcraftercore/mc/world.h"
+#include "../mapcraftercore/mc/worldcache.h"
+
+#include <vector>
+
+namespace mc = mapcrafter::mc;
+namespace nbt = mapcrafter::mc::nbt;
+namespace benchmark = mapcrafter::benchmark;
+
+namespace {
+
+fs::path getRegionFile() {
+	return benchmark::getOptions().data_dir / "region" / "r.-1.0.mca";
+}
+
+/**
+ * Reads the test region file, skips the benchmark if that's not possible.
+ */
+bool readRegion(benchmark::State& state, mc::RegionFile& region) {
+	region = mc::RegionFile(getRegionFile().string());
+	if (!region.read()) {
+		state.skip("unable to read '" + getRegionFile().string() + "'");
+		return false;
+	}
+	return true;
+}
+
+nbt::Compression getCompression(const mc::RegionFile& region, const mc::ChunkPos& pos) {
+	uint8_t compression = region.getChunkDataCompression(pos);
+	if (compression == 1)
+		return nbt::Compression::GZIP;
+	if (compression == 2)
+		return nbt::Compression::ZLIB;
+	return nbt::Compression::NO_COMPRESSION;
+}
+
+uint64_t getChunkDataSize(const mc::RegionFile& region) {
+	uint64_t size = 0;
+	const auto& chunks = region.getContainingChunks();
+	for (auto it = chunks.begin(); it != chunks.end(); ++it)
+		size += region.getChunkData(*it).size();
+	return size;
+}
+
+}
+
+BENCHMARK(region_read) {
+	mc::RegionFile region;
+	if (!readRegion(state, region))
+		return;
+
+	while (state.keepRunning())
+		region.read();
+	state.setItemsPerIteration(region.getContainingChunksCount(), "chunks");
+	state.setBytesPerIteration(fs::file_size(getRegionFile()));
+}
+
+BENCHMARK(nbt_decode) {
+	mc::RegionFile region;
+	if (!readRegion(state, region))
+		return;
+
+	const auto& chunks = region.getContainingChunks();
+	while (state.keepRunning()) {
+		for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+			const std::vector<uint8_t>& data = region.getChunkData(*it);
+			nbt::NBTFile nbt;
+			nbt.readNBT(reinterpret_cast<const char*>(&data[0]), data.size(),
+					getCompression(region, *it));
+		}
+	}
+	state.setItemsPerIteration(chunks.size(), "chunks");
+	state.setBytesPerIteration(getChunkDataSize(region));
+}
+
+BENCHMARK(chunk_load) {
+	mc::RegionFile region;
+	if (!readRegion(state, region))
+		return;
+
+	// decoding the NBT data and building the sections of the chunks
+	const auto& chunks = region.getContainingChunks();
+	mc::Chunk chunk;
+	while (state.keepRunning())
+		for (auto it = chunks.begin(); it != chunks.end(); ++it)
+			region.loadChunk(*it, chunk);
+	state.setItemsPerIteration(chunks.size(), "chunks");
+	state.setBytesPerIteration(getChunkDataSize(region));
+}
+
+BENCHMARK(chunk_accessors) {
+	mc::RegionFile region;
+	if (!readRegion(state, region))
+		return;
+
+	const auto& chunk_positions = region.getContainingChunks();
+	std::vector<mc::Chunk> chunks(chunk_positions.size());
+	size_t i = 0;
+	for (auto it = chunk_positions.begin(); it != chunk_positions.end(); ++it, ++i)
+		region.loadChunk(*it, chunks[i]);
+
+	uint64_t sum = 0;
+	while (state.keepRunning()) {
+		for (auto chunk = chunks.begin(); chunk != chunks.end(); ++chunk)
+			for (int x = 0; x < 16; x++)
+				for (int z = 0; z < 16; z++) {
+					mc::LocalBlockPos pos(x, z, 0);
+					sum += chunk->getBiomeAt(pos) + chunk->getHeightAt(pos);
+					for (pos.y = 0; pos.y < 256; pos.y++)
+						sum += chunk->getBlockID(pos) + chunk->getBlockData(pos)
+							+ chunk->getBlockLight(pos) + chunk->getSkyLight(pos);
+				}
+	}
+	benchmark::doNotOptimize(sum);
+	state.setItemsPerIteration(chunks.size() * 16 * 16 * 256, "blocks");
+}
+
+BENCHMARK(worldcache_get_block) {
+	std::string world_dir = benchmark::getOptions().data_dir.string();
+	mc::World world(world_dir);
+	if (!world.load()) {
+		state.skip("unable to load the world '" + world_dir + "'");
+		return;
+	}
+	mc::WorldCache cache(world);
+
+	const auto& regions = world.getAvailableRegions();
+	std::vector<mc::ChunkPos> chunks;
+	for (auto it = regions.begin(); it != regions.end(); ++it) {
+		mc::RegionFile* region = cache.getRegion(*it);
+		if (region != nullptr)
+			chunks.insert(chunks.end(), region->getContainingChunks().begin(),
+					region->getContainingChunks().end());
+	}
+
+	uint64_t sum = 0;
+	auto getBlocks = [&]() {
+		for (auto chunk = chunks.begin(); chunk != chunks.end(); ++chunk)
+			for (int x = 0; x < 16; x++)
+				for (int z = 0; z < 16; z++)
+					for (int y = 0; y < 256; y++) {
+						mc::Block block = cache.getBlock(mc::BlockPos(chunk->x * 16 + x,
+								chunk->z * 16 + z, y), nullptr);
+						sum += block.id + block.data;
+					}
+	};
+
+	// all chunks of the region fit into the cache, they are read before measuring
+	getBlocks();
+	while (state.keepRunning())
+		getBlocks();
+	benchmark::doNotOptimize(sum);
+	state.setItemsPerIteration(chunks.size() * 16 * 16 * 256, "blocks");
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include "../mapcraftercore/config/mapcrafterconfig.h"
+#include "../mapcraftercore/renderer/blockimages.h"
+#include "../mapcraftercore/renderer/image.h"
+#include "../mapcraftercore/renderer/renderview.h"
+#include "../mapcraftercore/renderer/tilerenderer.h"
+#include "../mapcraftercore/renderer/tilerenderworker.h"
+#include "../mapcraftercore/renderer/tileset.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+namespace benchmark = mapcrafter::benchmark;
+namespace config = mapcrafter::config;
+namespace mc = mapcrafter::mc;
+
+using namespace mapcrafter::renderer;
+
+namespace {
+
+/**
+ * Everything needed to render the tiles of the test world with a render view.
+ */
+struct RenderSetup {
+	std::unique_ptr<RenderView> render_view;
+	std::unique_ptr<BlockImages> block_images;
+	std::unique_ptr<TileSet> tile_set;
+	RenderContext context;
+
+	/**
+	 * Loads the textures, generates the block images and scans the tiles of the test
+	 * world. Skips the benchmark if something of that fails.
+	 */
+	bool initialize(benchmark::State& state, const std::string& view);
+};
+
+bool RenderSetup::initialize(benchmark::State& state, const std::string& view) {
+	const benchmark::Options& options = benchmark::getOptions();
+
+	// nothing is written, the output and template directory just need to exist
+	fs::path temp_dir = fs::temp_directory_path();
+	std::ostringstream config_string;
+	config_string << "output_dir = " << temp_dir.string() << std::endl;
+	config_string << "template_dir = " << temp_dir.string() << std::endl;
+	config_string << "[world:test]" << std::endl;
+	config_string << "input_dir = " << fs::absolute(options.data_dir).string() << std::endl;
+	config_string << "[map:test]" << std::endl;
+	config_string << "world = test" << std::endl;
+	config_string << "render_view = " << view << std::endl;
+	if (!options.texture_dir.empty())
+		config_string << "texture_dir = " << fs::absolute(options.texture_dir).string()
+				<< std::endl;
+
+	config::MapcrafterConfig config;
+	config::ValidationMap validation = config.parseString(config_string.str());
+	if (validation.isCritical()) {
+		validation.log();
+		state.skip("invalid configuration (specify the textures with --texture-dir)");
+		return false;
+	}
+	const config::WorldSection& world_config = config.getWorld("test");
+	const config::MapSection& map_config = config.getMap("test");
+
+	TextureResources resources;
+	if (!resources.loadTextures(map_config.getTextureDir().string(),
+			map_config.getTextureSize(), map_config.getTextureBlur(),
+			map_config.getWaterOpacity())) {
+		state.skip("unable to load the textures (specify them with --texture-dir)");
+		return false;
+	}
+
+	render_view.reset(createRenderView(map_config.getRenderView()));
+	block_images.reset(render_view->createBlockImages());
+	render_view->configureBlockImages(block_images.get(), world_config, map_config);
+	block_images->setRotation(0);
+	block_images->generateBlocks(resources);
+
+	mc::World world(world_config.getInputDir().string(), world_config.getDimension());
+	if (!world.load()) {
+		state.skip("unable to load the world '" + world_config.getInputDir().string() + "'");
+		return false;
+	}
+	tile_set.reset(render_view->createTileSet(map_config.getTileWidth()));
+	tile_set->scan(world);
+
+	context.world_config = world_config;
+	context.map_config = map_config;
+	context.render_view = render_view.get();
+	context.block_images = block_images.get();
+	context.tile_set = tile_set.get();
+	context.tile_fingerprints = nullptr;
+	context.chunk_fingerprints = nullptr;
+	context.profile = nullptr;
+	context.metrics = nullptr;
+	context.world = world;
+	context.initializeTileRenderer();
+	return true;
+}
+
+/**
+ * Renders all tiles of the test world. The tiles are rendered once before measuring,
+ * so the chunks are already in the world cache and mostly the tile renderer is
+ * measured.
+ */
+void renderTiles(benchmark::State& state, const std::string& view) {
+	RenderSetup setup;
+	if (!setup.initialize(state, view))
+		return;
+
+	const std::vector<TilePos>& tiles = setup.tile_set->getRenderTiles();
+	TilePos offset = setup.tile_set->getTileOffset();
+	RGBAImage image;
+	auto render = [&]() {
+		for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+			image.clear();
+			setup.context.tile_renderer->renderTile(*it + offset, image);
+		}
+	};
+
+	render();
+	while (state.keepRunning())
+		render();
+	int size = setup.context.tile_renderer->getTileSize();
+	state.setItemsPerIteration(tiles.size(), "tiles");
+	state.setBytesPerIteration((uint64_t) tiles.size() * size * size * sizeof(RGBAPixel));
+}
+
+}
+
+BENCHMARK(render_tile_isometric) {
+	renderTiles(state, "isometric");
+}
+
+BENCHMARK(render_tile_topdown) {
+	renderTiles(state, "topdown");
+}
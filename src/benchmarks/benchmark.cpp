@@ -0,0 +1,215 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include "../mapcraftercore/util/json.h"
+#include "../mapcraftercore/version.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace mapcrafter {
+namespace benchmark {
+
+namespace {
+
+Options options;
+
+// values written to this can not be optimized away
+volatile uint64_t optimization_sink;
+
+std::vector<std::pair<std::string, BenchmarkFunction> >& getBenchmarks() {
+	// constructed on first use, the benchmarks are registered during static initialization
+	static std::vector<std::pair<std::string, BenchmarkFunction> > benchmarks;
+	return benchmarks;
+}
+
+/**
+ * Formats a rate with a k/M/G suffix.
+ */
+std::string formatRate(double rate) {
+	const char* suffixes[] = {"", "k", "M", "G"};
+	int suffix = 0;
+	while (rate >= 1000 && suffix < 3) {
+		rate /= 1000;
+		suffix++;
+	}
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(2) << rate << suffixes[suffix];
+	return out.str();
+}
+
+std::string formatTime(double seconds) {
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(3);
+	if (seconds >= 1)
+		out << seconds << " s";
+	else if (seconds >= 1e-3)
+		out << seconds * 1e3 << " ms";
+	else
+		out << seconds * 1e6 << " us";
+	return out.str();
+}
+
+}
+
+Options::Options()
+	: min_time(1) {
+}
+
+const Options& getOptions() {
+	return options;
+}
+
+State::State(double min_time)
+	: min_time(min_time), started(false), iterations(0), items(0), bytes(0),
+	  skipped(false) {
+}
+
+State::~State() {
+}
+
+bool State::keepRunning() {
+	auto now = std::chrono::steady_clock::now();
+	if (!started) {
+		started = true;
+		start = end = now;
+		return !skipped;
+	}
+	iterations++;
+	end = now;
+	return !skipped && std::chrono::duration<double>(end - start).count() < min_time;
+}
+
+void State::setItemsPerIteration(uint64_t items, const std::string& unit) {
+	this->items = items;
+	this->item_unit = unit;
+}
+
+void State::setBytesPerIteration(uint64_t bytes) {
+	this->bytes = bytes;
+}
+
+void State::skip(const std::string& reason) {
+	skipped = true;
+	skip_reason = reason;
+}
+
+bool State::isSkipped() const {
+	return skipped;
+}
+
+const std::string& State::getSkipReason() const {
+	return skip_reason;
+}
+
+uint64_t State::getIterations() const {
+	return iterations;
+}
+
+double State::getSeconds() const {
+	return std::chrono::duration<double>(end - start).count();
+}
+
+uint64_t State::getItemsPerIteration() const {
+	return items;
+}
+
+const std::string& State::getItemUnit() const {
+	return item_unit;
+}
+
+uint64_t State::getBytesPerIteration() const {
+	return bytes;
+}
+
+Registrar::Registrar(const std::string& name, BenchmarkFunction function) {
+	getBenchmarks().push_back(std::make_pair(name, function));
+}
+
+int runBenchmarks(const Options& options, const std::string& filter,
+		const fs::path& json_file) {
+	benchmark::options = options;
+
+	std::cout << std::left << std::setw(28) << "benchmark" << std::right
+			<< std::setw(12) << "iterations" << std::setw(14) << "time/iter"
+			<< std::setw(24) << "items/s" << std::setw(14) << "MB/s" << std::endl;
+
+	picojson::array results;
+	int count = 0;
+	const auto& benchmarks = getBenchmarks();
+	for (auto it = benchmarks.begin(); it != benchmarks.end(); ++it) {
+		if (it->first.find(filter) == std::string::npos)
+			continue;
+		count++;
+
+		State state(options.min_time);
+		it->second(state);
+
+		std::cout << std::left << std::setw(28) << it->first << std::right;
+		if (state.isSkipped() || state.getIterations() == 0) {
+			std::cout << "  skipped: " << state.getSkipReason() << std::endl;
+			continue;
+		}
+
+		double seconds = state.getSeconds();
+		double per_iteration = seconds / state.getIterations();
+		double items_per_second = state.getItemsPerIteration() * state.getIterations() / seconds;
+		double bytes_per_second = state.getBytesPerIteration() * state.getIterations() / seconds;
+		std::cout << std::setw(12) << state.getIterations()
+				<< std::setw(14) << formatTime(per_iteration)
+				<< std::setw(24) << (formatRate(items_per_second) + " " + state.getItemUnit());
+		if (state.getBytesPerIteration() != 0)
+			std::cout << std::setw(14) << std::fixed << std::setprecision(2)
+					<< bytes_per_second / 1e6;
+		std::cout << std::endl;
+
+		picojson::object result;
+		result["name"] = picojson::value(it->first);
+		result["iterations"] = picojson::value((double) state.getIterations());
+		result["seconds_per_iteration"] = picojson::value(per_iteration);
+		result["items_per_second"] = picojson::value(items_per_second);
+		result["item_unit"] = picojson::value(state.getItemUnit());
+		result["bytes_per_second"] = picojson::value(bytes_per_second);
+		results.push_back(picojson::value(result));
+	}
+
+	if (!json_file.empty()) {
+		picojson::object report;
+		report["version"] = picojson::value(std::string(MAPCRAFTER_VERSION)
+				+ MAPCRAFTER_GITVERSION);
+		report["benchmarks"] = picojson::value(results);
+		std::ofstream out(json_file.string().c_str());
+		if (!out || !(out << picojson::value(report).serialize()))
+			std::cerr << "Unable to write '" << json_file.string() << "'." << std::endl;
+	}
+	return count;
+}
+
+void doNotOptimize(uint64_t value) {
+	optimization_sink = value;
+}
+
+} /* namespace benchmark */
+} /* namespace mapcrafter */
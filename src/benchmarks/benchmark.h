@@ -0,0 +1,136 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace benchmark {
+
+/**
+ * The options of the benchmarks.
+ */
+struct Options {
+	Options();
+
+	// directory with the test data (region files, images)
+	fs::path data_dir;
+	// texture directory to render with, the default one if empty
+	fs::path texture_dir;
+	// how many seconds every benchmark runs at least
+	double min_time;
+};
+
+const Options& getOptions();
+
+/**
+ * The state of a running benchmark.
+ *
+ * A benchmark does its setup first, then runs the measured code in a loop as long as
+ * keepRunning() returns true and tells the state how many items (and bytes) one
+ * iteration processed. The throughput is computed from that.
+ */
+class State {
+public:
+	State(double min_time);
+	~State();
+
+	/**
+	 * Returns whether another iteration should be run. The first call starts the
+	 * clock, every other call counts a finished iteration.
+	 */
+	bool keepRunning();
+
+	/**
+	 * Sets how many items (with their unit, for example "chunks") and bytes one
+	 * iteration processes.
+	 */
+	void setItemsPerIteration(uint64_t items, const std::string& unit);
+	void setBytesPerIteration(uint64_t bytes);
+
+	/**
+	 * Marks the benchmark as skipped, for example because some data is missing.
+	 */
+	void skip(const std::string& reason);
+
+	bool isSkipped() const;
+	const std::string& getSkipReason() const;
+
+	uint64_t getIterations() const;
+	double getSeconds() const;
+
+	uint64_t getItemsPerIteration() const;
+	const std::string& getItemUnit() const;
+	uint64_t getBytesPerIteration() const;
+
+private:
+	double min_time;
+
+	bool started;
+	uint64_t iterations;
+	std::chrono::steady_clock::time_point start, end;
+
+	uint64_t items, bytes;
+	std::string item_unit;
+
+	bool skipped;
+	std::string skip_reason;
+};
+
+typedef void (*BenchmarkFunction)(State& state);
+
+/**
+ * Registers a benchmark when constructed, used by the BENCHMARK macro.
+ */
+class Registrar {
+public:
+	Registrar(const std::string& name, BenchmarkFunction function);
+};
+
+/**
+ * Runs the benchmarks whose names contain the filter, prints the results and writes
+ * them to a JSON file if a filename is specified. Returns the count of benchmarks run.
+ */
+int runBenchmarks(const Options& options, const std::string& filter,
+		const fs::path& json_file);
+
+/**
+ * Prevents the compiler from optimizing away a computed value.
+ */
+void doNotOptimize(uint64_t value);
+
+} /* namespace benchmark */
+} /* namespace mapcrafter */
+
+/**
+ * Defines and registers a benchmark function, the state is available as 'state'.
+ */
+#define BENCHMARK(name) \
+	static void benchmark_##name(mapcrafter::benchmark::State& state); \
+	static mapcrafter::benchmark::Registrar registrar_##name(#name, benchmark_##name); \
+	static void benchmark_##name(mapcrafter::benchmark::State& state)
+
+#endif /* BENCHMARK_H_ */
@@ -47,7 +47,7 @@ int main(int argc, char** argv) {
 	}
 
 	renderer::RenderOpts opts;
-	std::string arg_color, arg_config;
+	std::string arg_color, arg_config, arg_pin_threads, arg_metrics_format;
 
 	po::options_description general("General options");
 	general.add_options()
@@ -77,7 +77,19 @@ int main(int argc, char** argv) {
 			"renders the specified map(s) completely")
 		("render-force-all,F", "force renders all maps")
 		("jobs,j", po::value<int>(&opts.jobs)->default_value(1),
-			"the count of jobs to use when rendering the map");
+			"the count of jobs to use when rendering the map")
+		("pin-threads", po::value<std::string>(&arg_pin_threads)->default_value("none"),
+			"whether render threads are pinned to single CPUs or NUMA nodes (none, cpu or numa)")
+		("watch", "keeps running and renders the maps again when the worlds change")
+		("watch-delay", po::value<int>(&opts.watch_delay)->default_value(10),
+			"seconds without world changes to wait before rendering again")
+		("profile", "shows how much time the render stages took for every map and rotation")
+		("profile-json", po::value<fs::path>(&opts.profile_json),
+			"writes the profiles of the rendered maps to a JSON file (implies --profile)")
+		("metrics-file", po::value<fs::path>(&opts.metrics_file),
+			"periodically writes metrics of the rendering to a file")
+		("metrics-format", po::value<std::string>(&arg_metrics_format)->default_value("prometheus"),
+			"the format of the metrics file (prometheus or jsonl)");
 
 	po::options_description all("Allowed options");
 	all.add(general).add(logging).add(renderer);
@@ -107,6 +119,20 @@ int main(int argc, char** argv) {
 		return 1;
 	}
 
+	if (!thread::parseThreadPinning(arg_pin_threads, opts.pin_threads)) {
+		std::cerr << "Invalid argument '" << arg_pin_threads << "' for '--pin-threads'." << std::endl;
+		std::cerr << "Allowed arguments are 'none', 'cpu' or 'numa'." << std::endl;
+		std::cerr << "Use '" << argv[0] << " --help' for more information." << std::endl;
+		return 1;
+	}
+
+	if (!util::parseMetricsFormat(arg_metrics_format, opts.metrics_format)) {
+		std::cerr << "Invalid argument '" << arg_metrics_format << "' for '--metrics-format'." << std::endl;
+		std::cerr << "Allowed arguments are 'prometheus' or 'jsonl'." << std::endl;
+		std::cerr << "Use '" << argv[0] << " --help' for more information." << std::endl;
+		return 1;
+	}
+
 	if (vm.count("help")) {
 		std::cout << all << std::endl;
 		std::cout << "Mapcrafter online documentation: <http://docs.mapcrafter.org>" << std::endl;
@@ -171,6 +197,8 @@ int main(int argc, char** argv) {
 	opts.skip_all = vm.count("render-reset");
 	opts.force_all = vm.count("render-force-all");
 	opts.batch = vm.count("batch");
+	opts.watch = vm.count("watch");
+	opts.profile = vm.count("profile") || vm.count("profile-json");
 	if (!vm.count("logging-config"))
 		opts.logging_config = util::findLoggingConfigFile();
 
@@ -207,7 +235,14 @@ int main(int argc, char** argv) {
 
 	renderer::RenderManager manager(config);
 	manager.setRenderBehaviors(renderer::RenderBehaviors::fromRenderOpts(config, opts));
-	if (!manager.run(opts.jobs, opts.batch))
+	manager.setThreadPinning(opts.pin_threads);
+	manager.setProfiling(opts.profile, opts.profile_json);
+	if (!opts.metrics_file.empty())
+		manager.setMetrics(opts.metrics_file, opts.metrics_format);
+	if (opts.watch) {
+		if (!manager.watch(opts.jobs, opts.batch, opts.watch_delay))
+			return 1;
+	} else if (!manager.run(opts.jobs, opts.batch))
 		return 1;
 	return 0;
 }
@@ -162,6 +162,10 @@ void MapSection::dump(std::ostream& out) const {
 	out << "  render_leaves_transparent = " << render_leaves_transparent << std::endl;
 	out << "  render_biomes = " << render_biomes << std::endl;
 	out << "  use_image_timestamps = " << use_image_mtimes << std::endl;
+	out << "  use_chunk_fingerprints = " << use_chunk_fingerprints << std::endl;
+	out << "  use_tile_fingerprints = " << use_tile_fingerprints << std::endl;
+	out << "  use_partial_rendering = " << use_partial_rendering << std::endl;
+	out << "  use_block_images_cache = " << use_block_images_cache << std::endl;
 }
 
 void MapSection::setConfigDir(const fs::path& config_dir) {
@@ -258,6 +262,22 @@ bool MapSection::useImageModificationTimes() const {
 	return use_image_mtimes.getValue();
 }
 
+bool MapSection::useChunkFingerprints() const {
+	return use_chunk_fingerprints.getValue();
+}
+
+bool MapSection::useTileFingerprints() const {
+	return use_tile_fingerprints.getValue();
+}
+
+bool MapSection::usePartialRendering() const {
+	return use_partial_rendering.getValue();
+}
+
+bool MapSection::useBlockImagesCache() const {
+	return use_block_images_cache.getValue();
+}
+
 TileSetGroupID MapSection::getTileSetGroup() const {
 	return TileSetGroupID(getWorld(), getRenderView(), getTileWidth());
 }
@@ -300,6 +320,10 @@ void MapSection::preParse(const INIConfigSection& section,
 	render_leaves_transparent.setDefault(true);
 	render_biomes.setDefault(true);
 	use_image_mtimes.setDefault(true);
+	use_chunk_fingerprints.setDefault(true);
+	use_tile_fingerprints.setDefault(true);
+	use_partial_rendering.setDefault(true);
+	use_block_images_cache.setDefault(true);
 }
 
 bool MapSection::parseField(const std::string key, const std::string value,
@@ -360,6 +384,14 @@ bool MapSection::parseField(const std::string key, const std::string value,
 		render_biomes.load(key, value, validation);
 	} else if (key == "use_image_mtimes") {
 		use_image_mtimes.load(key, value, validation);
+	} else if (key == "use_chunk_fingerprints") {
+		use_chunk_fingerprints.load(key, value, validation);
+	} else if (key == "use_tile_fingerprints") {
+		use_tile_fingerprints.load(key, value, validation);
+	} else if (key == "use_partial_rendering") {
+		use_partial_rendering.load(key, value, validation);
+	} else if (key == "use_block_images_cache") {
+		use_block_images_cache.load(key, value, validation);
 	} else
 		return false;
 	return true;
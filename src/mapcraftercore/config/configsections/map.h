@@ -118,6 +118,10 @@ public:
 	bool renderLeavesTransparent() const;
 	bool renderBiomes() const;
 	bool useImageModificationTimes() const;
+	bool useChunkFingerprints() const;
+	bool useTileFingerprints() const;
+	bool usePartialRendering() const;
+	bool useBlockImagesCache() const;
 
 	TileSetGroupID getTileSetGroup() const;
 	TileSetID getTileSet(int rotation) const;
@@ -154,6 +158,8 @@ private:
 	Field<double> lighting_intensity, lighting_water_intensity;
 	Field<bool> cave_high_contrast;
 	Field<bool> render_unknown_blocks, render_leaves_transparent, render_biomes, use_image_mtimes;
+	Field<bool> use_chunk_fingerprints, use_tile_fingerprints, use_partial_rendering;
+	Field<bool> use_block_images_cache;
 
 	std::set<TileSetID> tile_sets;
 };
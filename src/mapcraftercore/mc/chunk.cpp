@@ -19,6 +19,9 @@
 
 #include "chunk.h"
 
+#include "../util.h"
+
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -50,11 +53,35 @@ void Chunk::setWorldCrop(const WorldCrop& world_crop) {
 	this->world_crop = world_crop;
 }
 
+void Chunk::computeHeights() {
+	std::fill(heights, heights + 256, -1);
+	// go through the sections from top to bottom until every column has a block
+	int remaining = 256;
+	for (int y = CHUNK_HEIGHT - 1; y >= 0 && remaining > 0; y--) {
+		if (section_offsets[y] == -1)
+			continue;
+		const ChunkSection& section = sections[section_offsets[y]];
+		for (int section_y = 15; section_y >= 0 && remaining > 0; section_y--) {
+			for (int i = 0; i < 256; i++) {
+				if (heights[i] != -1)
+					continue;
+				int offset = section_y * 256 + i;
+				uint8_t add = (section.add[offset / 2] >> ((offset % 2) * 4)) & 0x0f;
+				if (section.blocks[offset] != 0 || add != 0) {
+					heights[i] = y * 16 + section_y;
+					remaining--;
+				}
+			}
+		}
+	}
+}
+
 int Chunk::positionToKey(int x, int z, int y) const {
 	return y + 256 * (x + 16 * z);
 }
 
 bool Chunk::readNBT(const char* data, size_t len, nbt::Compression compression) {
+	util::ProfileTimer timer(util::ProfileStage::CHUNK_BUILD);
 	clear();
 
 	nbt::NBTFile nbt;
@@ -163,6 +190,7 @@ bool Chunk::readNBT(const char* data, size_t len, nbt::Compression compression)
 		sections.push_back(section);
 	}
 
+	computeHeights();
 	return true;
 }
 
@@ -170,6 +198,9 @@ void Chunk::clear() {
 	sections.clear();
 	for (int i = 0; i < CHUNK_HEIGHT; i++)
 		section_offsets[i] = -1;
+	std::fill(biomes, biomes + 256, 0);
+	std::fill(heights, heights + 256, -1);
+	extra_data_map.clear();
 }
 
 bool Chunk::hasSection(int section) const {
@@ -306,10 +337,46 @@ uint8_t Chunk::getBiomeAt(const LocalBlockPos& pos) const {
 	return biomes[z * 16 + x];
 }
 
+int Chunk::getHeightAt(const LocalBlockPos& pos) const {
+	int x = pos.x;
+	int z = pos.z;
+	if (rotation)
+		rotateBlockPos(x, z, rotation);
+
+	return heights[z * 16 + x];
+}
+
 const ChunkPos& Chunk::getPos() const {
 	return chunkpos;
 }
 
+const ChunkPos& Chunk::getOriginalPos() const {
+	return chunkpos_original;
+}
+
+uint64_t Chunk::getContentHash() const {
+	uint64_t hash = 0;
+	// go through the sections ordered by their y coordinate,
+	// independent of the order they were stored in the NBT data
+	for (int y = 0; y < CHUNK_HEIGHT; y++) {
+		if (section_offsets[y] == -1)
+			continue;
+		const ChunkSection& section = sections[section_offsets[y]];
+		hash = util::hash64(&section, sizeof(ChunkSection), hash);
+	}
+	hash = util::hash64(biomes, sizeof(biomes), hash);
+
+	// the extra data map is unordered, so sort it first
+	std::vector<std::pair<int, uint16_t> > extra_data(extra_data_map.begin(),
+			extra_data_map.end());
+	std::sort(extra_data.begin(), extra_data.end());
+	for (auto it = extra_data.begin(); it != extra_data.end(); ++it) {
+		int64_t entry = ((int64_t) it->first << 16) | it->second;
+		hash = util::hash64(&entry, sizeof(entry), hash);
+	}
+	return hash;
+}
+
 void Chunk::insertExtraData(const LocalBlockPos &pos, uint16_t extra_data) {
 	int key = positionToKey(pos.x, pos.z, pos.y);
 	std::pair<int,uint16_t> pair (key, extra_data);
@@ -118,12 +118,32 @@ public:
 	 */
 	uint8_t getBiomeAt(const LocalBlockPos& pos) const;
 
+	/**
+	 * Returns the y-coordinate of the highest block of a column (local coordinates, y is
+	 * ignored) which isn't air, or -1 if the column is empty. The heights are computed
+	 * from the block IDs when the chunk is loaded, blocks hidden by the world crop or a
+	 * block mask are not considered, so there might be only hidden blocks at that height.
+	 */
+	int getHeightAt(const LocalBlockPos& pos) const;
+
 	/**
 	 * Returns the position of the chunk. This position may be, depending on the map,
 	 * the rotated version of the original position.
 	 */
 	const ChunkPos& getPos() const;
 
+	/**
+	 * Returns the original (not rotated) position of the chunk.
+	 */
+	const ChunkPos& getOriginalPos() const;
+
+	/**
+	 * Returns a fingerprint of the loaded chunk content which is relevant for rendering
+	 * (block IDs/data, lighting, biomes and additional block data). Unlike the
+	 * timestamp of a chunk, it changes only if the content actually changes.
+	 */
+	uint64_t getContentHash() const;
+
 private:
 	// internal original chunk position and public chunk position (which may be rotated)
 	ChunkPos chunkpos, chunkpos_original;
@@ -146,6 +166,8 @@ private:
 
 	// the biomes in this chunk, as index z*16+x
 	uint8_t biomes[256];
+	// the height of the highest not-air block of every column, as index z*16+x
+	int16_t heights[256];
 
 	// extra_data (e.g. from attributes read from NBT data, like beds) are stored in this map
 	std::unordered_map<int, uint16_t> extra_data_map;
@@ -155,6 +177,11 @@ private:
 	 * part of the world and therefore not rendered.
 	 */
 	bool checkBlockWorldCrop(int x, int z, int y) const;
+
+	/**
+	 * Computes the heights of the columns from the loaded sections.
+	 */
+	void computeHeights();
 	/**
 	 * Returns a specific block data (block data value, block light, sky light) at a
 	 * specific position. The parameter array specifies which one:
@@ -20,6 +20,7 @@
 #include "region.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 
 namespace mapcrafter {
@@ -59,11 +60,19 @@ bool RegionFile::readHeaders(std::ifstream& file, uint32_t chunk_offsets[1024])
 		return false;
 	}
 
+	// read the offset and timestamp tables at once instead of seeking around for
+	// every single chunk
+	uint8_t header[8192];
+	file.read(reinterpret_cast<char*>(header), 8192);
+	if (!file) {
+		LOG(ERROR) << "Corrupt region '" << filename << "': Unable to read header.";
+		return false;
+	}
+
 	for (int x = 0; x < 32; x++) {
 		for (int z = 0; z < 32; z++) {
-			file.seekg(4 * (x + z * 32), std::ios::beg);
 			int tmp;
-			file.read(reinterpret_cast<char*>(&tmp), 4);
+			std::memcpy(&tmp, &header[4 * (x + z * 32)], 4);
 			if (tmp == 0)
 				continue;
 			uint32_t offset = util::bigEndian32(tmp << 8) * 4096;
@@ -74,9 +83,8 @@ bool RegionFile::readHeaders(std::ifstream& file, uint32_t chunk_offsets[1024])
 			}
 			//uint8_t sectors = ((uint8_t*) &tmp)[3];
 
-			file.seekg(4096, std::ios::cur);
 			uint32_t timestamp;
-			file.read(reinterpret_cast<char*>(&timestamp), 4);
+			std::memcpy(&timestamp, &header[4096 + 4 * (x + z * 32)], 4);
 			timestamp = util::bigEndian32(timestamp);
 
 			// get the original (not rotated) position of the chunk
@@ -123,6 +131,7 @@ void RegionFile::setWorldCrop(const WorldCrop& world_crop) {
 }
 
 bool RegionFile::read() {
+	util::ProfileTimer timer(util::ProfileStage::REGION_READ);
 	std::ifstream file(filename.c_str(), std::ios_base::binary);
 	uint32_t chunk_offsets[1024];
 	if (!readHeaders(file, chunk_offsets))
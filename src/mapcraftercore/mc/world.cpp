@@ -65,6 +65,9 @@ World::~World() {
 bool World::readRegions(const fs::path& region_dir) {
 	if(!fs::exists(region_dir))
 		return false;
+	// the world might be loaded again to find new region files
+	available_regions.clear();
+	region_files.clear();
 	std::string ending = ".mca";
 	for(fs::directory_iterator it(region_dir); it != fs::directory_iterator(); ++it) {
 		std::string region_file = (*it).path().string();
@@ -19,6 +19,8 @@
 
 #include "worldcache.h"
 
+#include <algorithm>
+
 namespace mapcrafter {
 namespace mc {
 
@@ -41,19 +43,27 @@ bool Block::isStairs() const {
 	return id == 53 || id == 67 || id == 108 || id == 109 || id == 114 || id == 128 || id == 134 || id == 135 || id == 136 || id == 156 || id == 163 || id == 164 || id == 180 || id == 203;
 }
 
-WorldCache::WorldCache() {
+ChunkData::~ChunkData() {
+}
+
+WorldCache::WorldCache()
+	: chunkdata_slots(0), chunk_hashes(nullptr) {
 	for (int i = 0; i < RSIZE; i++)
 		regioncache[i].used = false;
 	for (int i = 0; i < CSIZE; i++)
 		chunkcache[i].used = false;
+	for (int i = 0; i < DSIZE; i++)
+		chunkdata[i].used = false;
 }
 
 WorldCache::WorldCache(const World& world)
-	: world(world) {
+	: world(world), chunkdata_slots(0), chunk_hashes(nullptr) {
 	for (int i = 0; i < RSIZE; i++)
 		regioncache[i].used = false;
 	for (int i = 0; i < CSIZE; i++)
 		chunkcache[i].used = false;
+	for (int i = 0; i < DSIZE; i++)
+		chunkdata[i].used = false;
 }
 
 const World& WorldCache::getWorld() const {
@@ -75,12 +85,19 @@ int WorldCache::getChunkCacheIndex(const ChunkPos& pos) const {
 	return (((pos.x + 131072) & CMASK) * CWIDTH + (pos.z + 131072)) & CMASK;
 }
 
+/**
+ * Calculates the position of the data of a chunk position in the cache.
+ */
+int WorldCache::getChunkDataIndex(const ChunkPos& pos) const {
+	return ((pos.x + 131072) & (DWIDTH - 1)) * DWIDTH + ((pos.z + 131072) & (DWIDTH - 1));
+}
+
 RegionFile* WorldCache::getRegion(const RegionPos& pos) {
 	CacheEntry<RegionPos, RegionFile>& entry = regioncache[getRegionCacheIndex(pos)];
 
 	// check if region is already in cache
 	if (entry.used && entry.key == pos) {
-		//regionstats.hits++;
+		regionstats.hits++;
 		return &entry.value;
 	}
 
@@ -90,10 +107,13 @@ RegionFile* WorldCache::getRegion(const RegionPos& pos) {
 		return nullptr;
 
 	// region does not exist, region in cache was not modified
-	if (!world.getRegion(pos, entry.value))
+	if (!world.getRegion(pos, entry.value)) {
+		regionstats.not_found++;
 		return nullptr;
+	}
 
 	if (!entry.value.read()) {
+		regionstats.invalid++;
 		// the region is not valid, region in cache was probably modified
 		entry.used = false;
 		// remember this region as broken and do not try to load it again
@@ -103,22 +123,23 @@ RegionFile* WorldCache::getRegion(const RegionPos& pos) {
 
 	entry.used = true;
 	entry.key = pos;
-	//regionstats.misses++;
+	regionstats.misses++;
 	return &entry.value;
 }
 
 Chunk* WorldCache::getChunk(const ChunkPos& pos) {
-	CacheEntry<ChunkPos, Chunk>& entry = chunkcache[getChunkCacheIndex(pos)];
+	int index = getChunkCacheIndex(pos);
+	CacheEntry<ChunkPos, Chunk>& entry = chunkcache[index];
 	// check if chunk is already in cache
 	if (entry.used && entry.key == pos) {
-		//chunkstats.hits++;
+		chunkstats.hits++;
 		return &entry.value;
 	}
 
 	// if not try to get the region of the chunk from the cache
 	RegionFile* region = getRegion(pos.getRegion());
 	if (region == nullptr) {
-		//chunkstats.unavailable++;
+		chunkstats.region_not_found++;
 		return nullptr;
 	}
 
@@ -129,11 +150,20 @@ Chunk* WorldCache::getChunk(const ChunkPos& pos) {
 
 	int status = region->loadChunk(pos, entry.value);
 	// the chunk does not exist, chunk in cache was not modified
-	if (status == RegionFile::CHUNK_DOES_NOT_EXIST)
+	if (status == RegionFile::CHUNK_DOES_NOT_EXIST) {
+		chunkstats.not_found++;
 		return nullptr;
+	}
+	// otherwise data derived from a previously loaded copy of this chunk is invalid now
+	CacheEntry<ChunkPos, std::vector<std::unique_ptr<ChunkData> > >& data_entry =
+			chunkdata[getChunkDataIndex(pos)];
+	if (data_entry.used && data_entry.key == pos) {
+		data_entry.value.clear();
+		data_entry.used = false;
+	}
 
 	if (status != RegionFile::CHUNK_OK) {
-		//chunkstats.unavailable++;
+		chunkstats.invalid++;
 		// the chunk is not valid, chunk in cache was probably modified
 		entry.used = false;
 		// remember this chunk as broken and do not try to load it again
@@ -143,7 +173,9 @@ Chunk* WorldCache::getChunk(const ChunkPos& pos) {
 
 	entry.used = true;
 	entry.key = pos;
-	//chunkstats.misses++;
+	chunkstats.misses++;
+	if (chunk_hashes != nullptr)
+		(*chunk_hashes)[entry.value.getOriginalPos()] = entry.value.getContentHash();
 	return &entry.value;
 }
 
@@ -184,6 +216,44 @@ Block WorldCache::getBlock(const mc::BlockPos& pos, const mc::Chunk* chunk, int
 	}
 }
 
+int WorldCache::addChunkDataSlot() {
+	return chunkdata_slots++;
+}
+
+ChunkData* WorldCache::getChunkData(const Chunk* chunk, int slot) {
+	int index = getChunkCacheIndex(chunk->getPos());
+	if (chunk != &chunkcache[index].value || !chunkcache[index].used)
+		return nullptr;
+	CacheEntry<ChunkPos, std::vector<std::unique_ptr<ChunkData> > >& entry =
+			chunkdata[getChunkDataIndex(chunk->getPos())];
+	if (!entry.used || entry.key != chunk->getPos() || slot >= (int) entry.value.size())
+		return nullptr;
+	return entry.value[slot].get();
+}
+
+bool WorldCache::setChunkData(const Chunk* chunk, int slot, ChunkData* data) {
+	std::unique_ptr<ChunkData> ptr(data);
+	int index = getChunkCacheIndex(chunk->getPos());
+	if (chunk != &chunkcache[index].value || !chunkcache[index].used)
+		return false;
+	// the data of another chunk at this position in the cache is replaced
+	CacheEntry<ChunkPos, std::vector<std::unique_ptr<ChunkData> > >& entry =
+			chunkdata[getChunkDataIndex(chunk->getPos())];
+	if (!entry.used || entry.key != chunk->getPos()) {
+		entry.value.clear();
+		entry.key = chunk->getPos();
+		entry.used = true;
+	}
+	if (slot >= (int) entry.value.size())
+		entry.value.resize(std::max(slot + 1, chunkdata_slots));
+	entry.value[slot] = std::move(ptr);
+	return true;
+}
+
+void WorldCache::setChunkHashes(std::map<ChunkPos, uint64_t>* chunk_hashes) {
+	this->chunk_hashes = chunk_hashes;
+}
+
 const CacheStats& WorldCache::getRegionCacheStats() const {
 	return regionstats;
 }
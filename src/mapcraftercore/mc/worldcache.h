@@ -25,7 +25,10 @@
 #include "region.h"
 #include "world.h"
 
+#include <map>
+#include <memory>
 #include <set>
+#include <vector>
 
 namespace mapcrafter {
 namespace mc {
@@ -57,7 +60,7 @@ const int GET_SKY_LIGHT = 16;
 const int GET_LIGHT = GET_BLOCK_LIGHT | GET_SKY_LIGHT;
 
 /**
- * Some cache statistics for debugging. Not used at the moment.
+ * Some cache statistics, counted since the cache was created.
  *
  * Maybe add a set of corrupt chunks/regions to dump them at the end of the rendering.
  */
@@ -75,12 +78,12 @@ struct CacheStats {
 				  << "  invalid: " << invalid << std::endl;
 	}
 
-	int hits;
-	int misses;
+	uint64_t hits;
+	uint64_t misses;
 
-	int region_not_found;
-	int not_found;
-	int invalid;
+	uint64_t region_not_found;
+	uint64_t not_found;
+	uint64_t invalid;
 };
 
 /**
@@ -93,6 +96,16 @@ struct CacheEntry {
 	bool used;
 };
 
+/**
+ * Data derived from a chunk (and maybe the blocks around it), for example by a render
+ * mode. It is stored in the world cache with the chunk and deleted when the chunk is
+ * removed from the cache, or earlier because only the data of a few chunks is kept.
+ */
+class ChunkData {
+public:
+	virtual ~ChunkData();
+};
+
 #define RBITS 2
 #define RWIDTH (1 << RBITS)
 #define RSIZE (RWIDTH*RWIDTH)
@@ -103,6 +116,11 @@ struct CacheEntry {
 #define CSIZE (CWIDTH*CWIDTH)
 #define CMASK (CSIZE-1)
 
+#define DBITS 3
+#define DWIDTH (1 << DBITS)
+#define DSIZE (DWIDTH*DWIDTH)
+#define DMASK (DSIZE-1)
+
 /**
  * This is a world cache with regions and chunks.
  *
@@ -123,6 +141,9 @@ struct CacheEntry {
  * the coordinate of the requested region/chunk. If yes, the cache returns the objects.
  * If not, the cache tries to load the chunk/region and puts it in this cache entry
  * (overwrites an already loaded region/chunk at this cache position).
+ *
+ * The data stored with the chunks (see ChunkData) can be much bigger than the chunks
+ * themselves, so it is kept the same way for only 8x8 chunks (the first 3 bits).
  */
 class WorldCache {
 private:
@@ -130,6 +151,11 @@ private:
 
 	CacheEntry<RegionPos, RegionFile> regioncache[RSIZE];
 	CacheEntry<ChunkPos, Chunk> chunkcache[CSIZE];
+	// data stored with some of the chunks, one slot for everyone who stores data
+	CacheEntry<ChunkPos, std::vector<std::unique_ptr<ChunkData> > > chunkdata[DSIZE];
+	int chunkdata_slots;
+	// optional map the content hashes of the loaded chunks are put into
+	std::map<ChunkPos, uint64_t>* chunk_hashes;
 
 	// provisional set to keep track of broken regions/chunks
 	// we do not want to try to load them again and again
@@ -141,6 +167,7 @@ private:
 
 	int getRegionCacheIndex(const RegionPos& pos) const;
 	int getChunkCacheIndex(const ChunkPos& pos) const;
+	int getChunkDataIndex(const ChunkPos& pos) const;
 
 public:
 	WorldCache();
@@ -153,6 +180,31 @@ public:
 
 	Block getBlock(const mc::BlockPos& pos, const mc::Chunk* chunk, int get = GET_ID | GET_DATA);
 
+	/**
+	 * Returns a new slot to store data with the chunks.
+	 */
+	int addChunkDataSlot();
+
+	/**
+	 * Returns the data stored in a slot with a chunk of this cache, nullptr if there is
+	 * no data.
+	 */
+	ChunkData* getChunkData(const Chunk* chunk, int slot);
+
+	/**
+	 * Stores data in a slot with a chunk of this cache. The cache takes ownership of the
+	 * data and deletes it when the chunk is removed from the cache. Returns false (and
+	 * deletes the data) if the chunk is not in this cache.
+	 */
+	bool setChunkData(const Chunk* chunk, int slot, ChunkData* data);
+
+	/**
+	 * Sets a map the content hashes (see Chunk::getContentHash) of all chunks loaded
+	 * from now on are put into, with their original (not rotated) positions. Nothing is
+	 * put anywhere if it's nullptr (the default).
+	 */
+	void setChunkHashes(std::map<ChunkPos, uint64_t>* chunk_hashes);
+
 	const CacheStats& getRegionCacheStats() const;
 	const CacheStats& getChunkCacheStats() const;
 };
@@ -78,9 +78,9 @@ uint8_t Biome::getID() const {
 }
 
 /**
- * Calculates the color of the biome with a biome color image.
+ * Calculates the position of the tinting color in a biome color image.
  */
-uint32_t Biome::getColor(const RGBAImage& colors, bool flip_xy) const {
+void Biome::getColorPosition(int& x, int& y) const {
 	// x is temperature
 	double tmp_temperature = temperature;
 	// y is temperature * rainfall
@@ -93,8 +93,16 @@ uint32_t Biome::getColor(const RGBAImage& colors, bool flip_xy) const {
 		tmp_rainfall = 1;
 
 	// calculate positions
-	int x = 255 - (255 * tmp_temperature);
-	int y = 255 - (255 * tmp_rainfall);
+	x = 255 - (255 * tmp_temperature);
+	y = 255 - (255 * tmp_rainfall);
+}
+
+/**
+ * Calculates the color of the biome with a biome color image.
+ */
+uint32_t Biome::getColor(const RGBAImage& colors, bool flip_xy) const {
+	int x, y;
+	getColorPosition(x, y);
 
 	// flip them, if needed
 	if (flip_xy) {
@@ -113,6 +121,19 @@ uint32_t Biome::getColor(const RGBAImage& colors, bool flip_xy) const {
 	return color;
 }
 
+/**
+ * Returns a key for the colors of the biome. The color position and the extra color
+ * values are everything getColor uses, so biomes with the same key have the same
+ * colors in every biome color image.
+ */
+uint64_t Biome::getColorKey() const {
+	int x, y;
+	getColorPosition(x, y);
+	return (uint64_t) (x & 0xffff) | (uint64_t) (y & 0xffff) << 16
+			| (uint64_t) (extra_r & 0xff) << 32 | (uint64_t) (extra_g & 0xff) << 40
+			| (uint64_t) (extra_b & 0xff) << 48;
+}
+
 bool Biome::isBiomeBlock(uint16_t id, uint16_t data) {
 	return id == 2 // grass block
 		|| id == 18 || id == 161 // leaves
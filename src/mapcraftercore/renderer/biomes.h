@@ -43,6 +43,8 @@ private:
 
 	// extra color values, for example for the swampland biome
 	int extra_r, extra_g, extra_b;
+
+	void getColorPosition(int& x, int& y) const;
 public:
 	Biome(uint8_t id = 0, double temperature = 0, double rainfall = 0,
 			uint8_t r = 255, uint8_t g = 255, uint8_t b = 255);
@@ -53,6 +55,7 @@ public:
 
 	uint8_t getID() const;
 	uint32_t getColor(const RGBAImage& colors, bool flip_xy = false) const;
+	uint64_t getColorKey() const;
 
 	static bool isBiomeBlock(uint16_t id, uint16_t data);
 };
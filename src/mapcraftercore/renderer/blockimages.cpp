@@ -22,12 +22,77 @@
 #include "biomes.h"
 #include "../util.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <map>
 #include <vector>
+#include <boost/iostreams/device/mapped_file.hpp>
 
 namespace mapcrafter {
 namespace renderer {
 
+namespace {
+
+const char BLOCK_IMAGES_CACHE_MAGIC[4] = {'M', 'C', 'B', 'I'};
+const int32_t BLOCK_IMAGES_CACHE_VERSION = 2;
+
+// the cache files are read on the machine they were written on, so all values (and
+// the pixels) are just stored in the native byte order, this is checked with a marker
+const uint32_t BLOCK_IMAGES_CACHE_BYTE_ORDER = 0x01020304;
+
+template <typename T>
+void writeValue(std::ostream& out, T value) {
+	out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void writeImage(std::ostream& out, const RGBAImage& image) {
+	writeValue<int32_t>(out, image.getWidth());
+	writeValue<int32_t>(out, image.getHeight());
+	if (image.getWidth() > 0 && image.getHeight() > 0)
+		out.write(reinterpret_cast<const char*>(&image.pixel(0, 0)),
+				image.getWidth() * image.getHeight() * sizeof(RGBAPixel));
+}
+
+/**
+ * Reads values and images from the memory mapped cache file and checks that nothing
+ * is read beyond its end.
+ */
+class CacheReader {
+public:
+	CacheReader(const char* data, size_t size)
+		: ptr(data), end(data + size) {}
+
+	template <typename T>
+	bool read(T& value) {
+		if ((size_t) (end - ptr) < sizeof(T))
+			return false;
+		std::memcpy(&value, ptr, sizeof(T));
+		ptr += sizeof(T);
+		return true;
+	}
+
+	bool readImage(RGBAImage& image) {
+		int32_t width, height;
+		if (!read(width) || !read(height) || width < 0 || height < 0)
+			return false;
+		size_t bytes = (size_t) width * height * sizeof(RGBAPixel);
+		if ((size_t) (end - ptr) < bytes)
+			return false;
+		image.setSize(width, height);
+		if (bytes > 0)
+			std::memcpy(&image.pixel(0, 0), ptr, bytes);
+		ptr += bytes;
+		return true;
+	}
+
+private:
+	const char* ptr;
+	const char* end;
+};
+
+}
+
 bool ChestTextures::load(const std::string& filename, int texture_size) {
 	RGBAImage image;
 	if (!image.readPNG(filename)) {
@@ -257,7 +322,7 @@ bool BedTextures::loadSingle(const std::string& filename, int color_index, int t
 }
 
 TextureResources::TextureResources()
-	: texture_size(12), texture_blur(0) {
+	: texture_size(12), texture_blur(0), water_opacity(1.0), textures_hash(0) {
 }
 
 TextureResources::~TextureResources() {
@@ -271,8 +336,12 @@ int TextureResources::getTextureBlur() const {
 	return texture_blur;
 }
 
+uint64_t TextureResources::getTexturesHash() const {
+	return textures_hash;
+}
+
 bool TextureResources::loadTextures(const std::string& texture_dir,
-		int texture_size, int texture_blur, double water_opacity) {
+		int texture_size, int texture_blur, double water_opacity, int threads) {
 	// set texture size and blur
 	this->texture_size = texture_size;
 	this->texture_blur = texture_blur;
@@ -294,15 +363,46 @@ bool TextureResources::loadTextures(const std::string& texture_dir,
 	if (!loadColors(dir + "colormap/foliage.png",
 			dir + "colormap/grass.png"))
 		ok = false;
-	if (!loadBlocks(dir + "blocks", dir + "endportal.png"))
+	if (!loadBlocks(dir + "blocks", dir + "endportal.png", threads))
 		ok = false;
 	if (!ok) {
 		LOG(ERROR) << "Invalid texture directory '" << dir << "'. See previous log messages.";
 		return false;
 	}
+
+	textures_hash = computeTexturesHash(texture_dir, texture_size, texture_blur,
+			water_opacity);
 	return true;
 }
 
+uint64_t TextureResources::computeTexturesHash(const std::string& texture_dir,
+		int texture_size, int texture_blur, double water_opacity) {
+	std::string dir = texture_dir;
+	if (dir[dir.size() - 1] != '/')
+		dir = dir + '/';
+
+	// the textures are identified by the files of the texture directory
+	// and the options they were loaded with
+	std::vector<fs::path> files;
+	boost::system::error_code ec;
+	for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+		if (fs::is_regular_file(it->path()))
+			files.push_back(it->path());
+	std::sort(files.begin(), files.end());
+
+	uint64_t hash = util::hash64(&texture_size, sizeof(texture_size));
+	hash = util::hash64(&texture_blur, sizeof(texture_blur), hash);
+	hash = util::hash64(&water_opacity, sizeof(water_opacity), hash);
+	for (auto it = files.begin(); it != files.end(); ++it) {
+		std::string filename = it->string();
+		int64_t file_info[2] = {(int64_t) fs::file_size(*it, ec),
+				(int64_t) fs::last_write_time(*it, ec)};
+		hash = util::hash64(filename.data(), filename.size(), hash);
+		hash = util::hash64(file_info, sizeof(file_info), hash);
+	}
+	return hash;
+}
+
 const BlockTextures& TextureResources::getBlockTextures() const {
 	return block_textures;
 }
@@ -377,8 +477,8 @@ bool TextureResources::loadColors(const std::string& foliage_png,
 }
 
 bool TextureResources::loadBlocks(const std::string& block_dir,
-		const std::string& endportal_png) {
-	if (!block_textures.load(block_dir, texture_size, texture_blur, water_opacity))
+		const std::string& endportal_png, int threads) {
+	if (!block_textures.load(block_dir, texture_size, texture_blur, water_opacity, threads))
 		return false;
 	empty_texture.setSize(texture_size, texture_size);
 
@@ -395,9 +495,48 @@ bool TextureResources::loadBlocks(const std::string& block_dir,
 BlockImages::~BlockImages() {
 }
 
+BlockImageTable::BlockImageTable() {
+}
+
+BlockImageTable::~BlockImageTable() {
+}
+
+void BlockImageTable::build(const std::vector<uint32_t>& keys) {
+	ids.clear();
+	slots.clear();
+
+	// find out the size of the table of every id first
+	for (auto it = keys.begin(); it != keys.end(); ++it) {
+		uint16_t id = *it & 0xffff;
+		uint16_t data = *it >> 16;
+		if (id >= ids.size())
+			ids.resize(id + 1);
+		Entry& entry = ids[id];
+		entry.width = std::max(entry.width, (uint16_t) ((data & LOW_MASK) + 1));
+		entry.height = std::max(entry.height, (uint16_t) ((data >> LOW_BITS) + 1));
+	}
+
+	uint32_t offset = 0;
+	for (auto it = ids.begin(); it != ids.end(); ++it) {
+		it->offset = offset;
+		offset += it->width * it->height;
+	}
+
+	slots.resize(offset, -1);
+	for (size_t i = 0; i < keys.size(); i++) {
+		const Entry& entry = ids[keys[i] & 0xffff];
+		uint16_t data = keys[i] >> 16;
+		slots[entry.offset + (data >> LOW_BITS) * entry.width + (data & LOW_MASK)] = i;
+	}
+}
+
 AbstractBlockImages::AbstractBlockImages()
 	: texture_size(12), rotation(0), render_unknown_blocks(false),
-	  render_leaves_transparent(true), max_water_preblit(9042) /* it's over 9000! */ {
+	  render_leaves_transparent(true), max_water_preblit(9042) /* it's over 9000! */,
+	  atlas_built(false) {
+	biome_indexes.fill(-1);
+	for (size_t i = 0; i < BIOMES_SIZE; i++)
+		biome_indexes[BIOMES[i].getID()] = i;
 }
 
 AbstractBlockImages::~AbstractBlockImages() {
@@ -424,8 +563,131 @@ void AbstractBlockImages::generateBlocks(const TextureResources& resources) {
 	if (render_unknown_blocks)
 		unknown_block = createUnknownBlock();
 	createBlocks();
-	createBiomeBlocks();
 	max_water_preblit = createOpaqueWater();
+	buildAtlas();
+	createBiomeBlocks();
+}
+
+uint64_t AbstractBlockImages::getOptionsHash() const {
+	int32_t options[3] = {rotation, render_unknown_blocks, render_leaves_transparent};
+	return util::hash64(options, sizeof(options));
+}
+
+bool AbstractBlockImages::readCache(const fs::path& file, uint64_t key,
+		const TextureResources& resources) {
+	if (!fs::is_regular_file(file) || fs::file_size(file) == 0)
+		return false;
+
+	boost::iostreams::mapped_file_source mapped;
+	try {
+		mapped.open(file.string());
+	} catch (std::exception& e) {
+		LOG(WARNING) << "Unable to map block images cache file '" << file.string()
+				<< "': " << e.what();
+		return false;
+	}
+
+	// everything is read into temporary tables first, the block images must not be
+	// left half-read if the file is invalid
+	CacheReader in(mapped.data(), mapped.size());
+	char magic[4];
+	int32_t version, cache_texture_size, cache_max_water_preblit;
+	uint32_t byte_order, count;
+	uint64_t cache_key;
+	RGBAImage cache_unknown_block;
+	std::unordered_map<uint32_t, RGBAImage> cache_block_images, cache_block_images_bed;
+	std::unordered_map<uint64_t, RGBAImage> cache_biome_images;
+	std::unordered_set<uint32_t> cache_block_transparency;
+
+	bool ok = in.read(magic) && std::memcmp(magic, BLOCK_IMAGES_CACHE_MAGIC, 4) == 0
+			&& in.read(version) && version == BLOCK_IMAGES_CACHE_VERSION
+			&& in.read(byte_order) && byte_order == BLOCK_IMAGES_CACHE_BYTE_ORDER
+			&& in.read(cache_key) && cache_key == key
+			&& in.read(cache_texture_size) && in.read(cache_max_water_preblit)
+			&& in.readImage(cache_unknown_block) && in.read(count);
+	for (uint32_t i = 0; ok && i < count; i++) {
+		uint32_t block_key;
+		uint8_t transparent;
+		ok = in.read(block_key) && in.read(transparent)
+				&& in.readImage(cache_block_images[block_key]);
+		if (ok && transparent)
+			cache_block_transparency.insert(block_key);
+	}
+	ok = ok && in.read(count);
+	for (uint32_t i = 0; ok && i < count; i++) {
+		uint32_t bed_key;
+		ok = in.read(bed_key) && in.readImage(cache_block_images_bed[bed_key]);
+	}
+	ok = ok && in.read(count);
+	for (uint32_t i = 0; ok && i < count; i++) {
+		uint64_t biome_key;
+		ok = in.read(biome_key) && in.readImage(cache_biome_images[biome_key]);
+	}
+	if (!ok) {
+		LOG(WARNING) << "Invalid block images cache file '" << file.string() << "'.";
+		return false;
+	}
+
+	this->resources = resources;
+	texture_size = cache_texture_size;
+	max_water_preblit = cache_max_water_preblit;
+	empty_texture.setSize(texture_size, texture_size);
+	unknown_block = cache_unknown_block;
+	block_images.swap(cache_block_images);
+	block_images_bed.swap(cache_block_images_bed);
+	biome_images.swap(cache_biome_images);
+	block_transparency.swap(cache_block_transparency);
+	buildAtlas();
+	return true;
+}
+
+bool AbstractBlockImages::writeCache(const fs::path& file, uint64_t key) const {
+	// write to a temporary file first, a half-written file must not be used
+	fs::path tmp_file = file.string() + ".tmp";
+	{
+		std::ofstream out(tmp_file.string().c_str(), std::ios::binary);
+		if (!out)
+			return false;
+		out.write(BLOCK_IMAGES_CACHE_MAGIC, 4);
+		writeValue(out, BLOCK_IMAGES_CACHE_VERSION);
+		writeValue(out, BLOCK_IMAGES_CACHE_BYTE_ORDER);
+		writeValue(out, key);
+		writeValue<int32_t>(out, texture_size);
+		writeValue<int32_t>(out, max_water_preblit);
+		writeImage(out, unknown_block);
+
+		writeValue<uint32_t>(out, atlas_blocks.size());
+		for (size_t i = 0; i < atlas_blocks.size(); i++) {
+			writeValue(out, atlas_block_keys[i]);
+			writeValue<uint8_t>(out, atlas_transparency[i]);
+			writeImage(out, atlas_blocks[i]);
+		}
+		writeValue<uint32_t>(out, atlas_beds.size());
+		for (size_t i = 0; i < atlas_beds.size(); i++) {
+			writeValue(out, atlas_bed_keys[i]);
+			writeImage(out, atlas_beds[i]);
+		}
+		uint32_t biome_count = 0;
+		for (size_t i = 0; i < atlas_blocks.size(); i++)
+			if (atlas_biome_offsets[i] != -1)
+				biome_count += BIOMES_SIZE;
+		writeValue(out, biome_count);
+		for (size_t i = 0; i < atlas_blocks.size(); i++) {
+			if (atlas_biome_offsets[i] == -1)
+				continue;
+			for (size_t j = 0; j < BIOMES_SIZE; j++) {
+				uint64_t biome = BIOMES[j].getID();
+				writeValue<uint64_t>(out, atlas_block_keys[i] | (biome << 32));
+				writeImage(out, atlas_biome_blocks[atlas_biome_offsets[i] + j]);
+			}
+		}
+		if (!out)
+			return false;
+	}
+
+	boost::system::error_code ec;
+	fs::rename(tmp_file, file, ec);
+	return !ec;
 }
 
 RGBAImage AbstractBlockImages::exportBlocks() const {
@@ -460,17 +722,28 @@ bool AbstractBlockImages::isBlockTransparent(uint16_t id, uint16_t data) const {
 	// FIXME
 	if (id == 64 || id == 71 || id == 26)
 		return true;
-	if (block_images.count(id | (data << 16)) == 0)
+	// (this is also used while generating the block images)
+	if (!atlas_built) {
+		if (block_images.count(id | (data << 16)) == 0)
+			return !render_unknown_blocks;
+		return block_transparency.count(id | (data << 16)) != 0;
+	}
+	int slot = block_table.get(id, data);
+	if (slot == -1)
 		return !render_unknown_blocks;
-	return block_transparency.count(id | (data << 16)) != 0;
+	return atlas_transparency[slot];
 }
 
 bool AbstractBlockImages::hasBlock(uint16_t id, uint16_t data) const {
-	return block_images.count(id | (data << 16)) != 0;
+	if (!atlas_built)
+		return block_images.count(id | (data << 16)) != 0;
+	return block_table.get(id, data) != -1;
 }
 
 bool AbstractBlockImages::hasBedBlock(uint16_t data, uint16_t extra_data) const {
-	return block_images_bed.count(data | (extra_data << 16)) != 0;
+	if (!atlas_built)
+		return block_images_bed.count(data | (extra_data << 16)) != 0;
+	return bed_table.get(data, extra_data) != -1;
 }
 
 const RGBAImage& AbstractBlockImages::getBlock(uint16_t id, uint16_t data, uint16_t extra_data) const {
@@ -480,26 +753,28 @@ const RGBAImage& AbstractBlockImages::getBlock(uint16_t id, uint16_t data, uint1
 		if (!hasBedBlock(data, extra_data)) {
 			return unknown_block;
 		}
-		return block_images_bed.at(data | (extra_data << 16));
+		if (!atlas_built)
+			return block_images_bed.at(data | (extra_data << 16));
+		return atlas_beds[bed_table.get(data, extra_data)];
 	}
 
-	if (!hasBlock(id, data))
-		return unknown_block;
-	return block_images.at(id | (data << 16));
+	return getBlockImage(id, data);
 }
 
 RGBAImage AbstractBlockImages::getBiomeBlock(uint16_t id, uint16_t data,
 		const Biome& biome, uint16_t extra_data) const {
 	data = filterBlockData(id, data);
-	if (!hasBlock(id, data))
+	int slot = block_table.get(id, data);
+	if (slot == -1)
 		return unknown_block;
 
 	// check if this biome block is precalculated
 	if (biome == getBiome(biome.getID())) {
-		int64_t key = id | (((int64_t) data) << 16) | (((int64_t) biome.getID()) << 32);
-		if (!biome_images.count(key))
+		int32_t offset = atlas_biome_offsets[slot];
+		int16_t index = biome_indexes[biome.getID()];
+		if (offset == -1 || index == -1)
 			return unknown_block;
-		return biome_images.at(key);
+		return atlas_biome_blocks[offset + index];
 	}
 
 	// create the block if not
@@ -546,6 +821,67 @@ uint16_t AbstractBlockImages::filterBlockData(uint16_t id, uint16_t data) const
 	return data;
 }
 
+const RGBAImage& AbstractBlockImages::getBlockImage(uint16_t id, uint16_t data) const {
+	// (this is also used while generating the block images)
+	if (!atlas_built) {
+		auto it = block_images.find(id | (data << 16));
+		if (it == block_images.end())
+			return unknown_block;
+		return it->second;
+	}
+	int slot = block_table.get(id, data);
+	if (slot == -1)
+		return unknown_block;
+	return atlas_blocks[slot];
+}
+
+void AbstractBlockImages::buildAtlas() {
+	// the blocks with the same id are next to each other
+	atlas_block_keys.clear();
+	for (auto it = block_images.begin(); it != block_images.end(); ++it)
+		atlas_block_keys.push_back(it->first);
+	std::sort(atlas_block_keys.begin(), atlas_block_keys.end(), block_images_comparator());
+	atlas_bed_keys.clear();
+	for (auto it = block_images_bed.begin(); it != block_images_bed.end(); ++it)
+		atlas_bed_keys.push_back(it->first);
+	std::sort(atlas_bed_keys.begin(), atlas_bed_keys.end(), block_images_comparator());
+	block_table.build(atlas_block_keys);
+	bed_table.build(atlas_bed_keys);
+
+	// the images are copied (not moved), so the pixels are allocated in slot order
+	// and the images of similar blocks end up next to each other in memory
+	atlas_blocks.resize(atlas_block_keys.size());
+	atlas_transparency.resize(atlas_block_keys.size());
+	for (size_t i = 0; i < atlas_block_keys.size(); i++) {
+		atlas_blocks[i] = block_images[atlas_block_keys[i]];
+		atlas_transparency[i] = block_transparency.count(atlas_block_keys[i]) != 0;
+	}
+	atlas_beds.resize(atlas_bed_keys.size());
+	for (size_t i = 0; i < atlas_bed_keys.size(); i++)
+		atlas_beds[i] = std::move(block_images_bed[atlas_bed_keys[i]]);
+
+	// biome blocks are only in the map if they were read from a cache file
+	atlas_biome_offsets.assign(atlas_block_keys.size(), -1);
+	atlas_biome_blocks.clear();
+	for (auto it = biome_images.begin(); it != biome_images.end(); ++it) {
+		int slot = block_table.get(it->first & 0xffff, (it->first >> 16) & 0xffff);
+		int16_t index = biome_indexes[(it->first >> 32) & 0xff];
+		if (slot == -1 || index == -1)
+			continue;
+		if (atlas_biome_offsets[slot] == -1) {
+			atlas_biome_offsets[slot] = atlas_biome_blocks.size();
+			atlas_biome_blocks.resize(atlas_biome_blocks.size() + BIOMES_SIZE, unknown_block);
+		}
+		atlas_biome_blocks[atlas_biome_offsets[slot] + index] = std::move(it->second);
+	}
+
+	block_images.clear();
+	block_images_bed.clear();
+	biome_images.clear();
+	block_transparency.clear();
+	atlas_built = true;
+}
+
 void AbstractBlockImages::setBlockImage(uint16_t id, uint16_t data,
 		const RGBAImage& block) {
 	block_images[id | (data << 16)] = block;
@@ -561,33 +897,23 @@ void AbstractBlockImages::setBedImage(uint16_t data, uint16_t extra_data,
 }
 
 void AbstractBlockImages::createBiomeBlocks() {
-	for (std::unordered_map<uint32_t, RGBAImage>::iterator it = block_images.begin();
-			it != block_images.end(); ++it) {
-		uint16_t id = it->first & 0xffff;
-		uint16_t data = (it->first & 0xffff0000) >> 16;
+	for (size_t i = 0; i < atlas_blocks.size(); i++) {
+		uint16_t id = atlas_block_keys[i] & 0xffff;
+		uint16_t data = (atlas_block_keys[i] & 0xffff0000) >> 16;
 
 		// check if this is a biome block
 		if (!Biome::isBiomeBlock(id, data))
 			continue;
 
-		for (size_t i = 0; i < BIOMES_SIZE; i++) {
-			Biome biome = BIOMES[i];
-			uint64_t b = biome.getID();
-			biome_images[id | ((uint64_t) data << 16) | (b << 32)] =
-					createBiomeBlock(id, data, biome);
-		}
+		atlas_biome_offsets[i] = atlas_biome_blocks.size();
+		for (size_t j = 0; j < BIOMES_SIZE; j++)
+			atlas_biome_blocks.push_back(createBiomeBlock(id, data, BIOMES[j]));
 	}
 }
 
 std::vector<RGBAImage> AbstractBlockImages::getExportBlocks() const {
-	std::map<uint32_t, RGBAImage, block_images_comparator> blocks_sorted;
-	for (auto it = block_images.begin(); it != block_images.end(); ++it)
-			blocks_sorted[it->first] = it->second;
-
-	std::vector<RGBAImage> blocks;
-	for (auto it = blocks_sorted.begin(); it != blocks_sorted.end(); ++it)
-		blocks.push_back(it->second);
-	return blocks;
+	// the block images are already sorted by id and data
+	return atlas_blocks;
 }
 
 }
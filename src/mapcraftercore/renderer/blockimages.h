@@ -28,7 +28,11 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include <cstdint>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
 
 namespace mapcrafter {
 namespace renderer {
@@ -191,6 +195,20 @@ public:
 	 */
 	int getTextureBlur() const;
 
+	/**
+	 * Returns a hash of the loaded textures. It is computed from the names, sizes and
+	 * modification times of the files in the texture directory and the options the
+	 * textures were loaded with.
+	 */
+	uint64_t getTexturesHash() const;
+
+	/**
+	 * Computes the hash of the textures of a texture directory loaded with some options
+	 * (see getTexturesHash) without loading them.
+	 */
+	static uint64_t computeTexturesHash(const std::string& texture_dir, int texture_size,
+			int texture_blur, double water_opacity);
+
 	/**
 	 * Loads the texture files from a texture directory and returns if it was successful.
 	 * Error/warning messages will be logged with the logging facility if there is
@@ -202,9 +220,11 @@ public:
 	 * range [0; 1] (Default 1) and is a factor which is applied to the opacity of the
 	 * water texture. With 1.0 the alpha channel of the texture is not changed, with 0.0
 	 * the texture will be completely transparent.
+	 *
+	 * The block textures are read and processed with the specified count of threads.
 	 */
 	bool loadTextures(const std::string& texture_dir, int texture_size = 12,
-			int texture_blur = 0, double water_opacity = 1.0);
+			int texture_blur = 0, double water_opacity = 1.0, int threads = 1);
 
 	/**
 	 * Returns the loaded block texture files.
@@ -278,11 +298,13 @@ private:
 	/**
 	 * Loads the block textures and the endportal texture from the supplied directory/file.
 	 */
-	bool loadBlocks(const std::string& block_dir, const std::string& endportal_png);
+	bool loadBlocks(const std::string& block_dir, const std::string& endportal_png,
+			int threads = 1);
 
 	// used texture size, blur
 	int texture_size, texture_blur;
 	double water_opacity;
+	uint64_t textures_hash;
 
 	// all the loaded texture images
 	BlockTextures block_textures;
@@ -323,6 +345,26 @@ public:
 	 */
 	virtual void generateBlocks(const TextureResources& resources) = 0;
 
+	/**
+	 * Returns a hash of the options (rotation, render special blocks, ...) the block
+	 * images are generated with.
+	 */
+	virtual uint64_t getOptionsHash() const = 0;
+
+	/**
+	 * Reads block images which were generated before from a cache file instead of
+	 * generating them. The cache file must have been written with the same key. The
+	 * textures are still required for biome blocks which are created while rendering.
+	 * Returns false if the cache file does not exist or is invalid.
+	 */
+	virtual bool readCache(const fs::path& file, uint64_t key,
+			const TextureResources& resources) = 0;
+
+	/**
+	 * Writes the generated block images to a cache file.
+	 */
+	virtual bool writeCache(const fs::path& file, uint64_t key) const = 0;
+
 	/**
 	 * Exports the block images by just blitting all the generated block images together
 	 * to a big image.
@@ -373,6 +415,53 @@ public:
 	virtual int getBlockSize() const = 0;
 };
 
+/**
+ * Maps the keys of block images (16 bit id, 16 bit data) to consecutive slots with a
+ * dense table per block id, so finding the slot of a block is just an array access.
+ *
+ * The data values of a block are usually small, only the highest three bits are used
+ * for special variants (see EDGE_*). So the table of every id has one row of (highest
+ * data value without these bits + 1) slots for every used combination of these bits.
+ */
+class BlockImageTable {
+public:
+	BlockImageTable();
+	~BlockImageTable();
+
+	/**
+	 * Builds the table, the key at index i of the vector gets slot i.
+	 */
+	void build(const std::vector<uint32_t>& keys);
+
+	/**
+	 * Returns the slot of a block, -1 if the block is not in the table.
+	 */
+	int get(uint16_t id, uint16_t data) const {
+		if (id >= ids.size())
+			return -1;
+		const Entry& entry = ids[id];
+		uint16_t low = data & LOW_MASK, high = data >> LOW_BITS;
+		if (low >= entry.width || high >= entry.height)
+			return -1;
+		return slots[entry.offset + high * entry.width + low];
+	}
+
+private:
+	static const int LOW_BITS = 13;
+	static const uint16_t LOW_MASK = (1 << LOW_BITS) - 1;
+
+	struct Entry {
+		Entry() : offset(0), width(0), height(0) {}
+
+		uint32_t offset;
+		uint16_t width, height;
+	};
+
+	// id -> position and size of its table in the slots
+	std::vector<Entry> ids;
+	std::vector<int32_t> slots;
+};
+
 /**
  * Implements most of the methods of the BlockImages class which are related to managing
  * the generated block images. You just have to implement some methods to generate all
@@ -393,6 +482,11 @@ public:
 	 */
 	virtual void generateBlocks(const TextureResources& resources);
 
+	virtual uint64_t getOptionsHash() const;
+	virtual bool readCache(const fs::path& file, uint64_t key,
+			const TextureResources& resources);
+	virtual bool writeCache(const fs::path& file, uint64_t key) const;
+
 	/**
 	 * Implements the method of the interface. Blits all the block images returned by the
 	 * getExportBlocks-method to a big image with 16 block images per row.
@@ -420,6 +514,19 @@ protected:
 	 */
 	virtual uint16_t filterBlockData(uint16_t id, uint16_t data) const;
 
+	/**
+	 * Returns the block image of a block without filtering the block data, the unknown
+	 * block if there is no such block image.
+	 */
+	const RGBAImage& getBlockImage(uint16_t id, uint16_t data) const;
+
+	/**
+	 * Moves the generated block images (block_images, block_images_bed, biome_images
+	 * and block_transparency) into the atlas which is used for rendering. The maps are
+	 * empty afterwards and the block images can't be changed anymore.
+	 */
+	void buildAtlas();
+
 	/**
 	 * Checks whether a block image contains transparent pixels. This is method is called
 	 * for every block that is stored with the setBlockImage-method.
@@ -463,9 +570,9 @@ protected:
 
 	/**
 	 * Creates the biome block images by iterating the generated blocks (the method is
-	 * called after createBlocks()), checking with the Biome::isBiomeBlock(id, data)
+	 * called after the atlas is built), checking with the Biome::isBiomeBlock(id, data)
 	 * function if this is a biome block and then calling the createBiomeBlock-method
-	 * for every biome. The biome blocks are stored in the biome_images map then.
+	 * for every biome. The biome blocks are stored in the atlas then.
 	 *
 	 * Overwrite this if you need special handling for biome blocks.
 	 */
@@ -490,6 +597,9 @@ protected:
 	TextureResources resources;
 	RGBAImage empty_texture;
 
+	// the following maps are used while generating the block images,
+	// the images are moved to the atlas afterwards (see buildAtlas)
+
 	// map of block images
 	// key is a 32 bit integer, first two bytes id, second two bytes data
 	std::unordered_map<uint32_t, RGBAImage> block_images;
@@ -521,6 +631,19 @@ protected:
 	RGBAImage unknown_block;
 
 	int max_water_preblit;
+
+	// the atlas: block and bed images in slot order (sorted by id and data),
+	// the keys and the transparency of the block slots,
+	// the index of the first biome version of every block slot (-1 if none)
+	// and the biome versions of the blocks in the order of the BIOMES array
+	bool atlas_built;
+	BlockImageTable block_table, bed_table;
+	std::vector<RGBAImage> atlas_blocks, atlas_beds, atlas_biome_blocks;
+	std::vector<uint32_t> atlas_block_keys, atlas_bed_keys;
+	std::vector<bool> atlas_transparency;
+	std::vector<int32_t> atlas_biome_offsets;
+	// biome id -> index in the BIOMES array (-1 if none)
+	std::array<int16_t, 256> biome_indexes;
 };
 
 }
@@ -17,7 +17,12 @@ public:
 	BlockTextures();
 	~BlockTextures();
 
-	bool load(const std::string& block_dir, int size, int blur, double water_opacity);
+	/**
+	 * Loads all block textures from the 'blocks' directory. The textures are read and
+	 * processed with the specified count of threads.
+	 */
+	bool load(const std::string& block_dir, int size, int blur, double water_opacity,
+			int threads = 1);
 
 	TextureImage
 		ANVIL_BASE,
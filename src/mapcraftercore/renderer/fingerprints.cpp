@@ -0,0 +1,364 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fingerprints.h"
+
+#include "image.h"
+#include "tileset.h"
+#include "../mc/chunk.h"
+#include "../mc/region.h"
+#include "../mc/world.h"
+#include "../thread/parallel.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace mapcrafter {
+namespace renderer {
+
+namespace {
+
+const char FINGERPRINTS_MAGIC[4] = {'M', 'C', 'F', 'P'};
+const int32_t FINGERPRINTS_VERSION = 1;
+
+const char TILE_FINGERPRINTS_MAGIC[4] = {'M', 'C', 'T', 'F'};
+const int32_t TILE_FINGERPRINTS_VERSION = 1;
+
+template <typename T>
+bool readValue(std::istream& in, T& value) {
+	in.read(reinterpret_cast<char*>(&value), sizeof(T));
+	return !in.fail();
+}
+
+template <typename T>
+void writeValue(std::ostream& out, T value) {
+	out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+}
+
+ChunkFingerprints::ChunkFingerprints() {
+}
+
+ChunkFingerprints::~ChunkFingerprints() {
+}
+
+bool ChunkFingerprints::readFile(const fs::path& file) {
+	fingerprints.clear();
+
+	std::ifstream in(file.string().c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	// header: magic, version and count of fingerprints,
+	// then the fingerprints as (x, z, fingerprint), everything big endian
+	char magic[4];
+	int32_t version, count;
+	in.read(magic, 4);
+	if (!in || std::memcmp(magic, FINGERPRINTS_MAGIC, 4) != 0
+			|| !readValue(in, version) || util::bigEndian32(version) != FINGERPRINTS_VERSION
+			|| !readValue(in, count)) {
+		LOG(WARNING) << "Invalid chunk fingerprints file '" << file.string() << "'.";
+		return false;
+	}
+
+	count = util::bigEndian32(count);
+	for (int32_t i = 0; i < count; i++) {
+		int32_t x, z;
+		int64_t fingerprint;
+		if (!readValue(in, x) || !readValue(in, z) || !readValue(in, fingerprint)) {
+			LOG(WARNING) << "Invalid chunk fingerprints file '" << file.string() << "'.";
+			fingerprints.clear();
+			return false;
+		}
+		mc::ChunkPos chunk(util::bigEndian32(x), util::bigEndian32(z));
+		fingerprints[chunk] = util::bigEndian64(fingerprint);
+	}
+	return true;
+}
+
+bool ChunkFingerprints::writeFile(const fs::path& file) const {
+	// write to a temporary file first, a half-written file must not be used
+	fs::path tmp_file = file.string() + ".tmp";
+	{
+		std::ofstream out(tmp_file.string().c_str(), std::ios::binary);
+		if (!out)
+			return false;
+		out.write(FINGERPRINTS_MAGIC, 4);
+		writeValue(out, util::bigEndian32(FINGERPRINTS_VERSION));
+		writeValue(out, util::bigEndian32(fingerprints.size()));
+		for (auto it = fingerprints.begin(); it != fingerprints.end(); ++it) {
+			writeValue(out, util::bigEndian32(it->first.x));
+			writeValue(out, util::bigEndian32(it->first.z));
+			writeValue(out, util::bigEndian64(it->second));
+		}
+		if (!out)
+			return false;
+	}
+
+	boost::system::error_code ec;
+	fs::rename(tmp_file, file, ec);
+	return !ec;
+}
+
+void ChunkFingerprints::clear() {
+	fingerprints.clear();
+}
+
+size_t ChunkFingerprints::size() const {
+	return fingerprints.size();
+}
+
+bool ChunkFingerprints::get(const mc::ChunkPos& chunk, uint64_t& fingerprint) const {
+	auto it = fingerprints.find(chunk);
+	if (it == fingerprints.end())
+		return false;
+	fingerprint = it->second;
+	return true;
+}
+
+void ChunkFingerprints::set(const mc::ChunkPos& chunk, uint64_t fingerprint) {
+	fingerprints[chunk] = fingerprint;
+}
+
+void ChunkFingerprints::set(const std::map<mc::ChunkPos, uint64_t>& fingerprints) {
+	for (auto it = fingerprints.begin(); it != fingerprints.end(); ++it)
+		this->fingerprints[it->first] = it->second;
+}
+
+void ChunkFingerprints::erase(const mc::ChunkPos& chunk) {
+	fingerprints.erase(chunk);
+}
+
+std::vector<mc::ChunkPos> ChunkFingerprints::update(const mc::World& world,
+		const ChunkIndex& index, int last_change, ChunkFingerprints& cache, int threads) {
+	const std::vector<ChunkIndex::ChunkTimestamp>& chunks = index.getChunks();
+
+	// only chunks with a new timestamp might have changed,
+	// compute the fingerprints of them which are not computed yet
+	std::vector<mc::ChunkPos> candidates, missing;
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		if ((int) it->second < last_change)
+			continue;
+		candidates.push_back(it->first);
+		if (!cache.fingerprints.count(it->first))
+			missing.push_back(it->first);
+	}
+	if (!missing.empty()) {
+		LOG(INFO) << "Computing fingerprints of " << missing.size() << " chunks...";
+		cache.compute(world, missing, threads);
+	}
+
+	std::vector<mc::ChunkPos> changed;
+	for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+		// chunks that could not be read are always considered changed
+		uint64_t fingerprint, stored;
+		if (!cache.get(*it, fingerprint)) {
+			changed.push_back(*it);
+			fingerprints.erase(*it);
+			continue;
+		}
+		if (!get(*it, stored) || stored != fingerprint)
+			changed.push_back(*it);
+		fingerprints[*it] = fingerprint;
+	}
+
+	// chunks which do not exist anymore have changed too
+	std::vector<mc::ChunkPos> existing(chunks.size());
+	for (size_t i = 0; i < chunks.size(); i++)
+		existing[i] = chunks[i].first;
+	std::sort(existing.begin(), existing.end());
+	for (auto it = fingerprints.begin(); it != fingerprints.end(); ) {
+		if (std::binary_search(existing.begin(), existing.end(), it->first))
+			++it;
+		else {
+			changed.push_back(it->first);
+			it = fingerprints.erase(it);
+		}
+	}
+
+	return changed;
+}
+
+void ChunkFingerprints::compute(const mc::World& world,
+		const std::vector<mc::ChunkPos>& chunks, int threads) {
+	// group the chunks by their regions
+	std::vector<mc::ChunkPos> sorted_chunks = chunks;
+	std::sort(sorted_chunks.begin(), sorted_chunks.end(),
+			[](const mc::ChunkPos& a, const mc::ChunkPos& b) {
+		return a.getRegion() < b.getRegion() || (a.getRegion() == b.getRegion() && a < b);
+	});
+	std::vector<size_t> region_starts;
+	for (size_t i = 0; i < sorted_chunks.size(); i++)
+		if (i == 0 || sorted_chunks[i].getRegion() != sorted_chunks[i - 1].getRegion())
+			region_starts.push_back(i);
+	region_starts.push_back(sorted_chunks.size());
+
+	// every region is read by one thread, the fingerprints are put into the
+	// slots of the chunks and inserted afterwards
+	std::vector<uint64_t> results(sorted_chunks.size());
+	std::vector<char> valid(sorted_chunks.size(), 0);
+	thread::parallelFor(region_starts.size() - 1, threads, [&](size_t i) {
+		mc::RegionFile region;
+		if (!world.getRegion(sorted_chunks[region_starts[i]].getRegion(), region)
+				|| !region.read())
+			return;
+		mc::Chunk chunk;
+		for (size_t j = region_starts[i]; j < region_starts[i + 1]; j++) {
+			if (region.loadChunk(sorted_chunks[j], chunk) != mc::RegionFile::CHUNK_OK)
+				continue;
+			results[j] = chunk.getContentHash();
+			valid[j] = 1;
+		}
+	});
+
+	for (size_t i = 0; i < sorted_chunks.size(); i++)
+		if (valid[i])
+			fingerprints[sorted_chunks[i]] = results[i];
+}
+
+TileFingerprints::TileFingerprints()
+	: depth(-1) {
+}
+
+TileFingerprints::~TileFingerprints() {
+}
+
+bool TileFingerprints::readFile(const fs::path& file) {
+	depth = -1;
+	keys.clear();
+	fingerprints.clear();
+
+	std::ifstream in(file.string().c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	// header: magic, version, depth of the tile set and count of fingerprints,
+	// then the fingerprints as (tile key, fingerprint) sorted by key, everything big endian
+	char magic[4];
+	int32_t version, file_depth, count;
+	in.read(magic, 4);
+	if (!in || std::memcmp(magic, TILE_FINGERPRINTS_MAGIC, 4) != 0
+			|| !readValue(in, version)
+			|| util::bigEndian32(version) != TILE_FINGERPRINTS_VERSION
+			|| !readValue(in, file_depth) || !readValue(in, count)) {
+		LOG(WARNING) << "Invalid tile fingerprints file '" << file.string() << "'.";
+		return false;
+	}
+
+	count = util::bigEndian32(count);
+	for (int32_t i = 0; i < count; i++) {
+		uint64_t key, fingerprint;
+		if (!readValue(in, key) || !readValue(in, fingerprint)
+				|| (!keys.empty() && (uint64_t) util::bigEndian64(key) <= keys.back())) {
+			LOG(WARNING) << "Invalid tile fingerprints file '" << file.string() << "'.";
+			keys.clear();
+			fingerprints.clear();
+			return false;
+		}
+		keys.push_back(util::bigEndian64(key));
+		fingerprints.push_back(util::bigEndian64(fingerprint));
+	}
+	depth = util::bigEndian32(file_depth);
+	return true;
+}
+
+bool TileFingerprints::writeFile(const fs::path& file) const {
+	fs::path tmp_file = file.string() + ".tmp";
+	{
+		std::ofstream out(tmp_file.string().c_str(), std::ios::binary);
+		if (!out)
+			return false;
+		out.write(TILE_FINGERPRINTS_MAGIC, 4);
+		writeValue(out, util::bigEndian32(TILE_FINGERPRINTS_VERSION));
+		writeValue(out, util::bigEndian32(depth));
+		// tiles which were never rendered don't need to be stored
+		int32_t count = 0;
+		for (size_t i = 0; i < keys.size(); i++)
+			if (fingerprints[i] != 0)
+				count++;
+		writeValue(out, util::bigEndian32(count));
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (fingerprints[i] == 0)
+				continue;
+			writeValue(out, util::bigEndian64(keys[i]));
+			writeValue(out, util::bigEndian64(fingerprints[i]));
+		}
+		if (!out)
+			return false;
+	}
+
+	boost::system::error_code ec;
+	fs::rename(tmp_file, file, ec);
+	return !ec;
+}
+
+void TileFingerprints::initialize(const TileSet& tile_set) {
+	std::vector<uint64_t> new_keys;
+	const std::vector<TilePos>& render_tiles = tile_set.getRenderTiles();
+	const std::vector<TilePath>& composite_tiles = tile_set.getCompositeTiles();
+	new_keys.reserve(render_tiles.size() + composite_tiles.size());
+	for (auto it = render_tiles.begin(); it != render_tiles.end(); ++it)
+		new_keys.push_back(TilePath::byTilePos(*it, tile_set.getDepth()).getKey());
+	for (auto it = composite_tiles.begin(); it != composite_tiles.end(); ++it)
+		new_keys.push_back(it->getKey());
+	std::sort(new_keys.begin(), new_keys.end());
+	new_keys.erase(std::unique(new_keys.begin(), new_keys.end()), new_keys.end());
+
+	// take over the fingerprints of the tiles which still exist
+	std::vector<uint64_t> new_fingerprints(new_keys.size(), 0);
+	if (depth == tile_set.getDepth()) {
+		size_t j = 0;
+		for (size_t i = 0; i < new_keys.size() && j < keys.size(); i++) {
+			while (j < keys.size() && keys[j] < new_keys[i])
+				j++;
+			if (j < keys.size() && keys[j] == new_keys[i])
+				new_fingerprints[i] = fingerprints[j];
+		}
+	}
+
+	depth = tile_set.getDepth();
+	keys.swap(new_keys);
+	fingerprints.swap(new_fingerprints);
+}
+
+bool TileFingerprints::update(const TilePath& tile, uint64_t fingerprint) {
+	auto it = std::lower_bound(keys.begin(), keys.end(), tile.getKey());
+	if (it == keys.end() || *it != tile.getKey())
+		return true;
+	uint64_t& stored = fingerprints[it - keys.begin()];
+	bool changed = stored != fingerprint;
+	stored = fingerprint;
+	return changed;
+}
+
+uint64_t TileFingerprints::compute(const RGBAImage& image) {
+	// the size is part of the fingerprint, a fingerprint is never 0
+	uint64_t seed = ((uint64_t) image.getWidth() << 32) | (uint32_t) image.getHeight();
+	size_t size = (size_t) image.getWidth() * image.getHeight();
+	uint64_t fingerprint = seed;
+	if (size > 0)
+		fingerprint = util::hash64(&image.pixel(0, 0), size * sizeof(RGBAPixel), seed);
+	return fingerprint != 0 ? fingerprint : 1;
+}
+
+}
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FINGERPRINTS_H_
+#define FINGERPRINTS_H_
+
+#include "../mc/pos.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+
+namespace mc {
+class World;
+}
+
+namespace renderer {
+
+class ChunkIndex;
+class RGBAImage;
+class TilePath;
+class TileSet;
+
+/**
+ * Stores the content fingerprints (see mc::Chunk::getContentHash) of the chunks of a
+ * world when they were rendered the last time.
+ *
+ * Minecraft updates the timestamp of a chunk every time the chunk is saved, even if
+ * nothing visible has changed. With the fingerprints only the chunks with a newer
+ * timestamp need to be decoded to find out whether they actually changed.
+ */
+class ChunkFingerprints {
+public:
+	ChunkFingerprints();
+	~ChunkFingerprints();
+
+	/**
+	 * Reads the fingerprints from a file. Returns false if the file does not exist or
+	 * is invalid, the store is empty then.
+	 */
+	bool readFile(const fs::path& file);
+
+	/**
+	 * Writes the fingerprints to a file.
+	 */
+	bool writeFile(const fs::path& file) const;
+
+	void clear();
+	size_t size() const;
+
+	/**
+	 * Returns the fingerprint of a chunk, false if there is no fingerprint of it.
+	 */
+	bool get(const mc::ChunkPos& chunk, uint64_t& fingerprint) const;
+	void set(const mc::ChunkPos& chunk, uint64_t fingerprint);
+	void erase(const mc::ChunkPos& chunk);
+
+	/**
+	 * Sets the fingerprints of some chunks, for example the ones the render threads
+	 * computed of the chunks they loaded.
+	 */
+	void set(const std::map<mc::ChunkPos, uint64_t>& fingerprints);
+
+	/**
+	 * Computes the fingerprints of the chunks with a timestamp >= last_change in the
+	 * chunk index and compares them to the stored ones. Returns the chunks which have
+	 * a different or no fingerprint and the chunks which do not exist anymore. The
+	 * store is updated with the new fingerprints.
+	 *
+	 * The world should be the not rotated world the chunk index was read from.
+	 * Computed fingerprints are also put into the cache and taken from there if
+	 * already computed (for example for another rotation of the same world).
+	 */
+	std::vector<mc::ChunkPos> update(const mc::World& world, const ChunkIndex& index,
+			int last_change, ChunkFingerprints& cache, int threads = 1);
+
+	/**
+	 * Computes the fingerprints of some chunks of a world, the chunks are read region
+	 * by region with the specified count of threads. Chunks that can not be read do
+	 * not get a fingerprint.
+	 */
+	void compute(const mc::World& world, const std::vector<mc::ChunkPos>& chunks,
+			int threads = 1);
+
+private:
+	std::map<mc::ChunkPos, uint64_t> fingerprints;
+};
+
+/**
+ * Stores the fingerprints of the pixels of the rendered tiles of a map rotation.
+ *
+ * If a tile is rendered again and the fingerprint of the new image is the same, the
+ * image does not need to be written again and the parent tile does not need to be
+ * composed again (if none of its other children changed either).
+ */
+class TileFingerprints {
+public:
+	TileFingerprints();
+	~TileFingerprints();
+
+	/**
+	 * Reads the fingerprints from a file. Returns false if the file does not exist or
+	 * is invalid, the store is empty then.
+	 */
+	bool readFile(const fs::path& file);
+
+	/**
+	 * Writes the fingerprints to a file.
+	 */
+	bool writeFile(const fs::path& file) const;
+
+	/**
+	 * Prepares the store for rendering the tiles of a tile set. Fingerprints of tiles
+	 * not in the tile set are dropped. The fingerprints of a different zoom level are
+	 * useless because the tiles were moved around, all of them are dropped then.
+	 */
+	void initialize(const TileSet& tile_set);
+
+	/**
+	 * Updates the fingerprint of a tile and returns whether it changed. The store must
+	 * be initialized with a tile set containing this tile. Different tiles can be
+	 * updated by different threads at the same time.
+	 */
+	bool update(const TilePath& tile, uint64_t fingerprint);
+
+	/**
+	 * Computes the fingerprint of an image.
+	 */
+	static uint64_t compute(const RGBAImage& image);
+
+private:
+	int depth;
+	// tile keys (see TilePath::getKey) and their fingerprints (0 if unknown),
+	// both sorted by key
+	std::vector<uint64_t> keys, fingerprints;
+};
+
+}
+}
+
+#endif /* FINGERPRINTS_H_ */
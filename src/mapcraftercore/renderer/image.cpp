@@ -429,31 +429,49 @@ RGBAImage& RGBAImage::rotateByShear(double degrees) {
 	return *this;
 }
 
-RGBAPixel blurKernel(const RGBAImage& image, int x, int y, int radius) {
-	int r = 0, g = 0, b = 0, a = 0;
-	int count = 0;
-	for (int dx = -radius; dx <= radius; dx++)
-		for (int dy = -radius; dy <= radius; dy++) {
-			int x2 = x + dx;
-			int y2 = y + dy;
-			if (x2 < 0 || y2 < 0 || x2 >= image.getWidth() || y2 >= image.getHeight())
-				continue;
-			RGBAPixel pixel = image.getPixel(x2, y2);
-			r += rgba_red(pixel);
-			g += rgba_green(pixel);
-			b += rgba_blue(pixel);
-			a += rgba_alpha(pixel);
-			count++;
-		}
-	return rgba(r / count, g / count, b / count, a / count);
-}
-
 void RGBAImage::blur(RGBAImage& dest, int radius) const {
 	dest.setSize(width, height);
+	if (width == 0 || height == 0)
+		return;
+
+	// every pixel is the average of the pixels in the square around it (clipped to
+	// the image), the sums of the squares are computed from the prefix sums of the
+	// sums of the rows of the squares, every channel independently
+	// the four channels of a pixel are stored next to each other, so the loops over
+	// them can be vectorized by the compiler
+	int row_size = (width + 1) * 4;
+	std::vector<uint32_t> row_prefix(row_size);
+	// prefix sums of the row sums of every column, index ((y + 1) * width + x) * 4
+	std::vector<uint32_t> column_prefix((height + 1) * width * 4, 0);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			RGBAPixel pixel = data[y * width + x];
+			for (int c = 0; c < 4; c++)
+				row_prefix[(x + 1) * 4 + c] = row_prefix[x * 4 + c] + ((pixel >> (c * 8)) & 0xff);
+		}
+		uint32_t* previous = &column_prefix[y * width * 4];
+		uint32_t* current = &column_prefix[(y + 1) * width * 4];
+		for (int x = 0; x < width; x++) {
+			const uint32_t* right = &row_prefix[(std::min(x + radius, width - 1) + 1) * 4];
+			const uint32_t* left = &row_prefix[std::max(x - radius, 0) * 4];
+			for (int c = 0; c < 4; c++)
+				current[x * 4 + c] = previous[x * 4 + c] + right[c] - left[c];
+		}
+	}
 
-	for (int x = 0; x < width; x++)
-		for (int y = 0; y < height; y++)
-			dest.pixel(x, y) = blurKernel(*this, x, y, radius);
+	for (int y = 0; y < height; y++) {
+		int y1 = std::max(y - radius, 0), y2 = std::min(y + radius, height - 1);
+		const uint32_t* bottom = &column_prefix[(y2 + 1) * width * 4];
+		const uint32_t* top = &column_prefix[y1 * width * 4];
+		for (int x = 0; x < width; x++) {
+			int x1 = std::max(x - radius, 0), x2 = std::min(x + radius, width - 1);
+			uint32_t count = (x2 - x1 + 1) * (y2 - y1 + 1);
+			RGBAPixel pixel = 0;
+			for (int c = 0; c < 4; c++)
+				pixel |= ((bottom[x * 4 + c] - top[x * 4 + c]) / count) << (c * 8);
+			dest.data[y * width + x] = pixel;
+		}
+	}
 }
 
 bool RGBAImage::readPNG(const std::string& filename) {
@@ -534,10 +552,13 @@ bool RGBAImage::readPNG(const std::string& filename) {
 
 bool RGBAImage::writePNG(const std::string& filename) const {
 	std::ofstream file(filename.c_str(), std::ios::binary);
-	if (!file) {
+	if (!file || !writePNG(file))
 		return false;
-	}
+	file.close();
+	return !file.fail();
+}
 
+bool RGBAImage::writePNG(std::ostream& out) const {
 	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (png == NULL)
 		return false;
@@ -553,7 +574,7 @@ bool RGBAImage::writePNG(const std::string& filename) const {
 		return false;
 	}
 
-	png_set_write_fn(png, (png_voidp) &file, pngWriteData, NULL);
+	png_set_write_fn(png, (png_voidp) &out, pngWriteData, NULL);
 	png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA,
 	        PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
@@ -569,10 +590,9 @@ bool RGBAImage::writePNG(const std::string& filename) const {
 	else
 		png_write_png(png, info, PNG_TRANSFORM_IDENTITY, NULL);
 
-	file.close();
 	png_free(png, rows);
 	png_destroy_write_struct(&png, &info);
-	return true;
+	return !out.fail();
 }
 
 namespace {
@@ -602,10 +622,13 @@ void setRowPixel(png_byte* line, int bit_depth, int x, uint8_t index) {
 
 bool RGBAImage::writeIndexedPNG(const std::string& filename, int palette_bits, bool dithered) const {
 	std::ofstream file(filename.c_str(), std::ios::binary);
-	if (!file) {
+	if (!file || !writeIndexedPNG(file, palette_bits, dithered))
 		return false;
-	}
+	file.close();
+	return !file.fail();
+}
 
+bool RGBAImage::writeIndexedPNG(std::ostream& out, int palette_bits, bool dithered) const {
 	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (png == NULL)
 		return false;
@@ -622,7 +645,7 @@ bool RGBAImage::writeIndexedPNG(const std::string& filename, int palette_bits, b
 	}
 
 	int palette_size = 1 << palette_bits;
-	png_set_write_fn(png, (png_voidp) &file, pngWriteData, NULL);
+	png_set_write_fn(png, (png_voidp) &out, pngWriteData, NULL);
 	png_set_IHDR(png, info, width, height, palette_bits, PNG_COLOR_TYPE_PALETTE,
 			PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
@@ -686,7 +709,6 @@ bool RGBAImage::writeIndexedPNG(const std::string& filename, int palette_bits, b
 	//else
 		png_write_png(png, info, PNG_TRANSFORM_IDENTITY, NULL);
 
-	file.close();
 	for (int y = 0; y < height; y++)
 		png_free(png, rows[y]);
 	png_free(png, rows);
@@ -694,7 +716,7 @@ bool RGBAImage::writeIndexedPNG(const std::string& filename, int palette_bits, b
 	png_free(png, palette_alpha);
 	delete octree;
 	png_destroy_write_struct(&png, &info);
-	return true;
+	return !out.fail();
 }
 
 /*
@@ -881,8 +903,52 @@ bool RGBAImage::readJPEG(const std::string& filename) {
 	return true;
 }
 
+namespace {
+
+/**
+ * A destination manager of the JPEG library which writes the compressed data to a
+ * stream, through a buffer.
+ */
+struct JPEGStreamDestination {
+	// must be the first member, the JPEG library knows only this one
+	struct jpeg_destination_mgr manager;
+	std::ostream* out;
+	JOCTET buffer[4096];
+};
+
+void jpegInitDestination(j_compress_ptr cinfo) {
+	JPEGStreamDestination* dest = (JPEGStreamDestination*) cinfo->dest;
+	dest->manager.next_output_byte = dest->buffer;
+	dest->manager.free_in_buffer = sizeof(dest->buffer);
+}
+
+boolean jpegEmptyOutputBuffer(j_compress_ptr cinfo) {
+	// the whole buffer is written here, no matter what free_in_buffer says
+	JPEGStreamDestination* dest = (JPEGStreamDestination*) cinfo->dest;
+	dest->out->write((const char*) dest->buffer, sizeof(dest->buffer));
+	jpegInitDestination(cinfo);
+	return TRUE;
+}
+
+void jpegTermDestination(j_compress_ptr cinfo) {
+	JPEGStreamDestination* dest = (JPEGStreamDestination*) cinfo->dest;
+	dest->out->write((const char*) dest->buffer,
+			sizeof(dest->buffer) - dest->manager.free_in_buffer);
+}
+
+}
+
 bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 		RGBAPixel background) const {
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if (!file || !writeJPEG(file, quality, background))
+		return false;
+	file.close();
+	return !file.fail();
+}
+
+bool RGBAImage::writeJPEG(std::ostream& out, int quality,
+		RGBAPixel background) const {
 
 	/* This struct contains the JPEG compression parameters and pointers to
 	 * working space (which is allocated as needed by the JPEG library).
@@ -901,7 +967,7 @@ bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 	 */
 	struct jpeg_error_mgr jerr;
 	/* More stuff */
-	FILE * outfile;		/* target file */
+	JPEGStreamDestination dest;	/* target stream */
 
 	/* Step 1: allocate and initialize JPEG compression object */
 
@@ -917,17 +983,14 @@ bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 	/* Step 2: specify data destination (eg, a file) */
 	/* Note: steps 2 and 3 can be done in either order. */
 
-	/* Here we use the library-supplied code to send compressed data to a
-	 * stdio stream.	You can also write your own code to do something else.
-	 * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-	 * requires it in order to write binary files.
+	/* Here we use our own destination manager (see above) to send compressed data
+	 * to a C++ stream instead of the library-supplied code for stdio streams.
 	 */
-	if ((outfile = fopen(filename.c_str(), "wb")) == NULL) {
-		//fprintf(stderr, "can't open %s\n", filename.c_str());
-		//exit(1);
-		return false;
-	}
-	jpeg_stdio_dest(&cinfo, outfile);
+	dest.manager.init_destination = jpegInitDestination;
+	dest.manager.empty_output_buffer = jpegEmptyOutputBuffer;
+	dest.manager.term_destination = jpegTermDestination;
+	dest.out = &out;
+	cinfo.dest = &dest.manager;
 
 	/* Step 3: set parameters for compression */
 
@@ -991,8 +1054,6 @@ bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 	/* Step 6: Finish compression */
 
 	jpeg_finish_compress(&cinfo);
-	/* After finish_compress, we can close the output file. */
-	fclose(outfile);
 
 	/* Step 7: release JPEG compression object */
 
@@ -1000,7 +1061,7 @@ bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 	jpeg_destroy_compress(&cinfo);
 
 	/* And we're done! */
-	return true;
+	return !out.fail();
 }
 
 }
@@ -26,6 +26,7 @@
 
 #include <png.h>
 #include <cstdint>
+#include <iosfwd>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -155,13 +156,21 @@ public:
 	 */
 	void blur(RGBAImage& dest, int radius) const;
 
+	/**
+	 * The images can be written to files or encoded to streams (for example to write
+	 * them to a file separately).
+	 */
 	bool readPNG(const std::string& filename);
 	bool writePNG(const std::string& filename) const;
+	bool writePNG(std::ostream& out) const;
 	bool writeIndexedPNG(const std::string& filename, int palette_bits = 8, bool dithered = true) const;
+	bool writeIndexedPNG(std::ostream& out, int palette_bits = 8, bool dithered = true) const;
 
 	bool readJPEG(const std::string& filename);
 	bool writeJPEG(const std::string& filename, int quality,
 			RGBAPixel background = rgba(255, 255, 255, 255)) const;
+	bool writeJPEG(std::ostream& out, int quality,
+			RGBAPixel background = rgba(255, 255, 255, 255)) const;
 };
 
 template <typename Pixel>
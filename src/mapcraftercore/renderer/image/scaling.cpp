@@ -2,6 +2,8 @@
 
 #include "../image.h"
 
+#include <vector>
+
 namespace mapcrafter {
 namespace renderer {
 
@@ -17,19 +19,6 @@ void imageResizeSimple(const RGBAImage& image, RGBAImage& dest, int width, int h
 	}
 }
 
-namespace {
-
-uint8_t interpolate(uint8_t a, uint8_t b, uint8_t c, uint8_t d, double w, double h) {
-	double aa = (double) a / 255.0;
-	double bb = (double) b / 255.0;
-	double cc = (double) c / 255.0;
-	double dd = (double) d / 255.0;
-	double result = aa * (1 - w) * (1 - h) + bb * w * (1 - h) + cc * h * (1 - w) + dd * (w * h);
-	return result * 255;
-}
-
-}
-
 void imageResizeBilinear(const RGBAImage& image, RGBAImage& dest, int width, int height) {
 	dest.setSize(width, height);
 
@@ -40,21 +29,42 @@ void imageResizeBilinear(const RGBAImage& image, RGBAImage& dest, int width, int
 	if(image.getHeight() < height)
 		y_ratio = (double) (image.getWidth() - 1) / height;
 
+	// the source positions and weights are the same for every row/column
+	std::vector<int> source_x(width), source_y(height);
+	std::vector<double> x_diffs(width), y_diffs(height);
 	for (int x = 0; x < width; x++) {
-		for (int y = 0; y < height; y++) {
-			int sx = x_ratio * x;
-			int sy = y_ratio * y;
-			double x_diff = (x_ratio * x) - sx;
-			double y_diff = (y_ratio * y) - sy;
+		source_x[x] = x_ratio * x;
+		x_diffs[x] = (x_ratio * x) - source_x[x];
+	}
+	for (int y = 0; y < height; y++) {
+		source_y[y] = y_ratio * y;
+		y_diffs[y] = (y_ratio * y) - source_y[y];
+	}
+
+	for (int y = 0; y < height; y++) {
+		int sy = source_y[y];
+		double h = y_diffs[y];
+		for (int x = 0; x < width; x++) {
+			int sx = source_x[x];
+			double w = x_diffs[x];
+			// pixels outside of the image are transparent
 			RGBAPixel a = image.getPixel(sx, sy);
 			RGBAPixel b = image.getPixel(sx + 1, sy);
 			RGBAPixel c = image.getPixel(sx, sy + 1);
 			RGBAPixel d = image.getPixel(sx + 1, sy + 1);
 
-			uint8_t red = interpolate(rgba_red(a), rgba_red(b), rgba_red(c), rgba_red(d), x_diff, y_diff);
-			uint8_t green = interpolate(rgba_green(a), rgba_green(b), rgba_green(c), rgba_green(d), x_diff, y_diff);
-			uint8_t blue = interpolate(rgba_blue(a), rgba_blue(b), rgba_blue(c), rgba_blue(d), x_diff, y_diff);
-			uint8_t alpha = interpolate(rgba_alpha(a), rgba_alpha(b), rgba_alpha(c), rgba_alpha(d), x_diff, y_diff);
+			// interpolate the four channels the same way,
+			// the channel i of a pixel is (pixel >> (i * 8)) & 0xff
+			RGBAPixel pixel = 0;
+			for (int i = 0; i < 4; i++) {
+				double aa = (double) ((a >> (i * 8)) & 0xff) / 255.0;
+				double bb = (double) ((b >> (i * 8)) & 0xff) / 255.0;
+				double cc = (double) ((c >> (i * 8)) & 0xff) / 255.0;
+				double dd = (double) ((d >> (i * 8)) & 0xff) / 255.0;
+				double result = aa * (1 - w) * (1 - h) + bb * w * (1 - h)
+						+ cc * h * (1 - w) + dd * (w * h);
+				pixel |= (RGBAPixel) (uint8_t) (result * 255) << (i * 8);
+			}
 
 			// make sure that that no transparency (aka alpha=254) sneaks into images
 			// caused by weird interpolation bugses, otherwise shit hits the fan
@@ -62,10 +72,10 @@ void imageResizeBilinear(const RGBAImage& image, RGBAImage& dest, int width, int
 			
 			// do this by just clamping alpha >= threshold to 255, 245 or 255 won't be
 			// a big visual difference
-			if (alpha >= 245)
-				alpha = 255;
+			if (rgba_alpha(pixel) >= 245)
+				pixel |= rgba(0, 0, 0, 255);
 		
-			dest.setPixel(x, y, rgba(red, green, blue, alpha));
+			dest.pixel(x, y) = pixel;
 		}
 	}
 }
@@ -26,13 +26,17 @@
 #include "../thread/impl/singlethread.h"
 #include "../thread/impl/multithreading.h"
 #include "../thread/dispatcher.h"
+#include "../thread/parallel.h"
 #include "../util.h"
 #include "../version.h"
 
 #include <cstring>
 #include <array>
+#include <chrono>
 #include <fstream>
+#include <iomanip>
 #include <memory>
+#include <sstream>
 #include <thread>
 
 namespace mapcrafter {
@@ -140,13 +144,27 @@ RenderBehaviors RenderBehaviors::fromRenderOpts(
 }
 
 RenderManager::RenderManager(const config::MapcrafterConfig& config)
-	: config(config), web_config(config), time_started_scanning(0) {
+	: config(config), web_config(config), thread_pinning(thread::ThreadPinning::NONE),
+	  time_started_scanning(0), keep_block_images(false) {
 }
 
 void RenderManager::setRenderBehaviors(const RenderBehaviors& render_behaviors) {
 	this->render_behaviors = render_behaviors;
 }
 
+void RenderManager::setThreadPinning(thread::ThreadPinning pinning) {
+	this->thread_pinning = pinning;
+}
+
+void RenderManager::setProfiling(bool enabled, const fs::path& json_file) {
+	util::Profiler::setEnabled(enabled);
+	profile_file = json_file;
+}
+
+void RenderManager::setMetrics(const fs::path& file, util::MetricsFormat format) {
+	metrics_sink.reset(new util::MetricsSink(file, format));
+}
+
 bool RenderManager::initialize() {
 	// an output directory would be nice -- create one if it does not exist
 	if (!fs::is_directory(config.getOutputDir()) && !fs::create_directories(config.getOutputDir())) {
@@ -158,7 +176,7 @@ bool RenderManager::initialize() {
 	return web_config.readConfigJS();
 }
 
-bool RenderManager::scanWorlds() {
+bool RenderManager::scanWorlds(int threads) {
 	auto config_worlds = config.getWorlds();
 	auto config_maps = config.getMaps();
 
@@ -192,63 +210,141 @@ bool RenderManager::scanWorlds() {
 		required_maps.push_back(std::make_pair(map, required_rotations));
 	}
 
-	// store the maximum max zoom level of every tile set with its rotations
-	std::map<config::TileSetGroupID, int> tile_sets_max_zoom;
-
-	// iterate through all tile sets that are needed
-	for (auto tile_set_it = needed_tile_sets.begin();
-			tile_set_it != needed_tile_sets.end(); ++tile_set_it) {
-		config::WorldSection world_config = config.getWorld(tile_set_it->world_name);
-		RenderView* render_view = createRenderView(tile_set_it->render_view);
+	// load the worlds of all needed tile sets
+	std::vector<config::TileSetID> scan_tile_sets(needed_tile_sets.begin(),
+			needed_tile_sets.end());
+	for (size_t i = 0; i < scan_tile_sets.size(); i++) {
+		const config::TileSetID& tile_set_id = scan_tile_sets[i];
+		config::WorldSection world_config = config.getWorld(tile_set_id.world_name);
 
-		// load the world
 		mc::World world(world_config.getInputDir().string(),
 				world_config.getDimension());
-		world.setRotation(tile_set_it->rotation);
+		world.setRotation(tile_set_id.rotation);
 		world.setWorldCrop(world_config.getWorldCrop());
 		if (!world.load()) {
-			LOG(FATAL) << "Unable to load world " << tile_set_it->world_name << "!";
+			LOG(FATAL) << "Unable to load world " << tile_set_id.world_name << "!";
+			return false;
+		}
+		worlds[tile_set_id.world_name][tile_set_id.rotation] = world;
+
+		// the region headers of every world are read just once (without rotation),
+		// the tile sets of all rotations and tile widths are derived from them
+		if (world_chunks.count(tile_set_id.world_name))
+			continue;
+		mc::World unrotated_world(world_config.getInputDir().string(),
+				world_config.getDimension());
+		unrotated_world.setWorldCrop(world_config.getWorldCrop());
+		if (!unrotated_world.load()) {
+			LOG(FATAL) << "Unable to load world " << tile_set_id.world_name << "!";
 			return false;
 		}
+		// only the headers of changed region files are read if there is an index
+		// from the last run
+		ChunkIndex& chunks = world_chunks[tile_set_id.world_name];
+		fs::path index_file = config.getOutputPath(tile_set_id.world_name + ".chunkindex");
+		chunks.readFile(index_file);
+		chunks.read(unrotated_world, threads);
+		LOG(INFO) << "Read " << chunks.getRegionsRead() << " of "
+				<< unrotated_world.getAvailableRegionCount() << " region headers of world "
+				<< tile_set_id.world_name << ".";
+		if (!chunks.writeFile(index_file))
+			LOG(WARNING) << "Unable to write chunk index file '" << index_file.string() << "'.";
+		unrotated_worlds[tile_set_id.world_name] = unrotated_world;
+	}
+
+	scanTileSets(scan_tile_sets, threads);
+	writeTemplates();
+	return true;
+}
+
+void RenderManager::scanTileSets(const std::vector<config::TileSetID>& scan_tile_sets,
+		int threads) {
+	// scan the tiles of all tile sets in parallel
+	std::vector<std::shared_ptr<TileSet> > scan_results(scan_tile_sets.size());
+	std::vector<TilePos> tile_offsets(scan_tile_sets.size());
+	thread::parallelFor(scan_tile_sets.size(), threads, [&](size_t i) {
+		const config::TileSetID& tile_set_id = scan_tile_sets[i];
+		config::WorldSection world_config = config.getWorld(tile_set_id.world_name);
+		std::unique_ptr<RenderView> render_view(createRenderView(tile_set_id.render_view));
 
 		// create a tile set for this world
-		std::shared_ptr<TileSet> tile_set(render_view->createTileSet(tile_set_it->tile_width));
+		std::shared_ptr<TileSet> tile_set(render_view->createTileSet(tile_set_id.tile_width));
 		// and scan the tiles of this world,
 		// we automatically center the tiles for cropped worlds, but only...
 		//  - the circular cropped ones and
 		//  - the ones with completely specified x- AND z-bounds
-		if (world_config.needsWorldCentering()) {
-			TilePos tile_offset;
-			tile_set->scan(world, true, tile_offset);
-			web_config.setTileSetTileOffset(*tile_set_it, tile_offset);
-		} else {
-			tile_set->scan(world);
-		}
+		tile_set->scan(world_chunks.at(tile_set_id.world_name), tile_set_id.rotation,
+				world_config.needsWorldCentering(), tile_offsets[i]);
+		scan_results[i] = tile_set;
+	});
+
+	// store the maximum max zoom level of every tile set with its rotations
+	std::map<config::TileSetGroupID, int> tile_sets_max_zoom;
+
+	for (size_t i = 0; i < scan_tile_sets.size(); i++) {
+		const config::TileSetID& tile_set_id = scan_tile_sets[i];
+		if (config.getWorld(tile_set_id.world_name).needsWorldCentering())
+			web_config.setTileSetTileOffset(tile_set_id, tile_offsets[i]);
 
 		// key of this tile_sets_max_zoom map is a TileSetGroupID, not TileSetID as we access it
 		// since TileSetID is a subclass of TileSetGroupID, only the TileSetGroupID-'functionality' is used
 		// TADA C++ magic! (object slicing)
-		int& max_zoom = tile_sets_max_zoom[*tile_set_it];
-		max_zoom = std::max(max_zoom, tile_set->getDepth());
-
-		// set world- and tileset object in the map
-		worlds[tile_set_it->world_name][tile_set_it->rotation] = world;
-		tile_sets[*tile_set_it] = tile_set;
+		int& max_zoom = tile_sets_max_zoom[tile_set_id];
+		max_zoom = std::max(max_zoom, scan_results[i]->getDepth());
 
-		// clean up render view
-		delete render_view;
+		// set tileset object in the map
+		tile_sets[tile_set_id] = scan_results[i];
 	}
 
 	// set calculated max zoom of tile sets
-	for (auto tile_set_it = needed_tile_sets.begin();
-			tile_set_it != needed_tile_sets.end(); ++tile_set_it) {
+	for (auto tile_set_it = scan_tile_sets.begin();
+			tile_set_it != scan_tile_sets.end(); ++tile_set_it) {
 		// same here like above, C++ magic
 		int max_zoom = tile_sets_max_zoom[*tile_set_it];
 		tile_sets[*tile_set_it]->setDepth(max_zoom);
 		web_config.setTileSetsMaxZoom(*tile_set_it, max_zoom);
 	}
+}
+
+bool RenderManager::rescanWorlds(int threads, std::set<std::string>& changed_worlds) {
+	time_started_scanning = std::time(nullptr);
+	// the fingerprints of this run are not valid anymore
+	world_fingerprints.clear();
+
+	// find new region files and read the headers of the changed ones
+	for (auto world_it = world_chunks.begin(); world_it != world_chunks.end(); ++world_it) {
+		const std::string& world_name = world_it->first;
+		mc::World& unrotated_world = unrotated_worlds[world_name];
+		if (!unrotated_world.load()) {
+			LOG(ERROR) << "Unable to load world " << world_name << "!";
+			return false;
+		}
+		for (int rotation = 0; rotation < 4; rotation++)
+			if (!worlds[world_name][rotation].getWorldDir().empty())
+				worlds[world_name][rotation].load();
+
+		ChunkIndex& chunks = world_it->second;
+		chunks.read(unrotated_world, threads);
+		if (chunks.getRegionsRead() == 0)
+			continue;
+		LOG(INFO) << "Read " << chunks.getRegionsRead() << " of "
+				<< unrotated_world.getAvailableRegionCount() << " region headers of world "
+				<< world_name << ".";
+		fs::path index_file = config.getOutputPath(world_name + ".chunkindex");
+		if (!chunks.writeFile(index_file))
+			LOG(WARNING) << "Unable to write chunk index file '" << index_file.string() << "'.";
+		changed_worlds.insert(world_name);
+	}
 
-	writeTemplates();
+	// the tile sets of the changed worlds are scanned again from the chunk indexes,
+	// the maps are initialized again in case the zoom level increased
+	std::vector<config::TileSetID> scan_tile_sets;
+	for (auto it = tile_sets.begin(); it != tile_sets.end(); ++it)
+		if (changed_worlds.count(it->first.world_name))
+			scan_tile_sets.push_back(it->first);
+	scanTileSets(scan_tile_sets, threads);
+	map_initialized.clear();
+	web_config.writeConfigJS();
 	return true;
 }
 
@@ -279,15 +375,44 @@ void RenderManager::renderMap(const std::string& map, int rotation, int threads,
 	}
 
 	fs::path output_dir = config.getOutputPath(map + "/" + config::ROTATION_NAMES_SHORT[rotation]);
+	fs::path fingerprints_file = output_dir / "chunks.fingerprints";
+	ChunkFingerprints fingerprints;
+	// the fingerprints can be used only if there is a last rendering they belong to,
+	// but they are written after every rendering so the next one can use them
+	bool use_fingerprints = map_config.useChunkFingerprints() && last_rendered != 0
+			&& render_behaviors.getRenderBehavior(map, rotation) == RenderBehavior::AUTO;
+	if (!map_config.useChunkFingerprints() && fs::exists(fingerprints_file))
+		fs::remove(fingerprints_file);
 	// get the tile set
 	TileSet* tile_set = tile_sets[map_config.getTileSet(rotation)].get();
 	if (render_behaviors.getRenderBehavior(map, rotation) == RenderBehavior::AUTO) {
 		// if incremental render, scan which tiles might have changed
 		LOG(INFO) << "Scanning required tiles...";
 		// use the incremental check method specified in the config
-		if (map_config.useImageModificationTimes())
+		if (use_fingerprints) {
+			if (map_config.useImageModificationTimes())
+				LOG(INFO) << "Using the chunk fingerprints instead of the tile modification "
+						<< "times ('use_chunk_fingerprints' takes precedence over "
+						<< "'use_image_mtimes').";
+			// only tiles with chunks with a changed content are required
+			const std::string& world_name = map_config.getWorld();
+			fingerprints.readFile(fingerprints_file);
+			std::vector<mc::ChunkPos> changed = fingerprints.update(
+					unrotated_worlds[world_name], world_chunks[world_name], last_rendered,
+					world_fingerprints[world_name], threads);
+			tile_set->scanRequiredByChunks(changed, rotation);
+		} else if (map_config.useImageModificationTimes())
 			tile_set->scanRequiredByFiletimes(output_dir, map_config.getImageFormatSuffix());
-		else
+		else if (map_config.usePartialRendering()) {
+			// same as scanning by timestamp, but the tile set knows the changed
+			// chunks of every tile then
+			const auto& chunks = world_chunks[map_config.getWorld()].getChunks();
+			std::vector<mc::ChunkPos> changed;
+			for (auto it = chunks.begin(); it != chunks.end(); ++it)
+				if ((int) it->second >= last_rendered)
+					changed.push_back(it->first);
+			tile_set->scanRequiredByChunks(changed, rotation);
+		} else
 			//tile_set->scanRequiredByTimestamp(settings.last_render[rotation]);
 			tile_set->scanRequiredByTimestamp(web_config.getMapLastRendered(map, rotation));
 	} else {
@@ -298,25 +423,70 @@ void RenderManager::renderMap(const std::string& map, int rotation, int threads,
 	// maybe we don't have to render anything at all
 	if (tile_set->getRequiredRenderTilesCount() == 0) {
 		LOG(INFO) << "No tiles need to get rendered.";
+		// nothing changed since the last rendering according to the fingerprints,
+		// so the chunks with new timestamps don't need to be checked again next time
+		if (use_fingerprints) {
+			web_config.setMapLastRendered(map, rotation, time_started_scanning);
+			web_config.writeConfigJS();
+			fingerprints.writeFile(fingerprints_file);
+		}
 		return;
 	}
 
-	// create block images
-	TextureResources resources;
+	// figure out where the render threads are running
+	thread::ThreadPlacement placement(threads > 1 ? thread_pinning : thread::ThreadPinning::NONE);
+	placement.assign(threads);
+	if (placement.getPinning() != thread::ThreadPinning::NONE)
+		LOG(INFO) << "Pinning render threads (" << placement.getPinning() << ") to "
+				<< placement.getNodeCount() << " NUMA node(s).";
+
+	// create other stuff for the render dispatcher,
+	// the block images are generated once for every NUMA node used by the render threads
+	// (while this thread is pinned to the node, so the memory is allocated there)
+	// (maps with the same render view, textures and block image options share their
+	// block images, they are kept until all of them are rendered)
 	// if textures do not work, it does not make much sense
 	// to try the other rotations with the same broken textures
-	if (!resources.loadTextures(map_config.getTextureDir().string(),
-			map_config.getTextureSize(), map_config.getTextureBlur(),
-			map_config.getWaterOpacity())) {
+	std::shared_ptr<TextureResources> resources = getTextureResources(map_config, threads);
+	if (!resources) {
 		LOG(ERROR) << "Skipping remaining rotations.";
 		return;
 	}
-
-	// create other stuff for the render dispatcher
-	std::shared_ptr<BlockImages> block_images(render_view->createBlockImages());
-	render_view->configureBlockImages(block_images.get(), world_config, map_config);
-	block_images->setRotation(rotation);
-	block_images->generateBlocks(resources);
+	uint64_t block_images_key = getBlockImagesKey(map_config, rotation,
+			resources->getTexturesHash());
+	std::vector<std::shared_ptr<BlockImages> >& node_block_images =
+			block_images_cache[block_images_key];
+	if (node_block_images.empty()) {
+		// the generated block images are cached in the output directory, the cache
+		// files are identified by the same key
+		bool use_cache = map_config.useBlockImagesCache();
+		fs::path cache_file = getBlockImagesCacheFile(block_images_key);
+		std::vector<int> cpus = thread::getAvailableCPUs();
+		for (int node = 0; node < placement.getNodeCount(); node++) {
+			thread::pinCurrentThread(placement.getNodeCPUs(node));
+			std::shared_ptr<BlockImages> block_images(render_view->createBlockImages());
+			render_view->configureBlockImages(block_images.get(), world_config, map_config);
+			block_images->setRotation(rotation);
+			if (!use_cache || !block_images->readCache(cache_file, block_images_key, *resources)) {
+				block_images->generateBlocks(*resources);
+				// the block images of the other nodes are read from the written file
+				if (use_cache) {
+					boost::system::error_code ec;
+					fs::create_directories(cache_file.parent_path(), ec);
+					if (!block_images->writeCache(cache_file, block_images_key)) {
+						LOG(WARNING) << "Unable to write block images cache file '"
+								<< cache_file.string() << "'.";
+						use_cache = false;
+					}
+				}
+			} else if (node == 0)
+				LOG(INFO) << "Read block images from cache file '" << cache_file.string() << "'.";
+			node_block_images.push_back(block_images);
+		}
+		if (placement.getPinning() != thread::ThreadPinning::NONE)
+			thread::pinCurrentThread(cpus);
+	} else
+		LOG(INFO) << "Using the block images of a previously rendered map.";
 
 	RenderContext context;
 	context.output_dir = output_dir;
@@ -324,8 +494,20 @@ void RenderManager::renderMap(const std::string& map, int rotation, int threads,
 	context.world_config = config.getWorld(map_config.getWorld());
 	context.map_config = map_config;
 	context.render_view = render_view.get();
-	context.block_images = block_images.get();
+	context.block_images = node_block_images[0].get();
+	if (node_block_images.size() > 1)
+		for (size_t i = 0; i < node_block_images.size(); i++)
+			context.node_block_images.push_back(node_block_images[i].get());
 	context.tile_set = tile_set;
+	context.tile_fingerprints = nullptr;
+	// first or forced rendering, the render threads compute the fingerprints of the
+	// chunks they load anyway for the next incremental rendering (chunks which are not
+	// loaded don't get one, they are considered changed when their timestamp changes)
+	context.chunk_fingerprints = nullptr;
+	if (map_config.useChunkFingerprints() && !use_fingerprints)
+		context.chunk_fingerprints = &fingerprints;
+	context.profile = nullptr;
+	context.metrics = metrics_sink ? &metrics : nullptr;
 	context.world = worlds[map_config.getWorld()][rotation];
 	context.initializeTileRenderer();
 
@@ -334,18 +516,62 @@ void RenderManager::renderMap(const std::string& map, int rotation, int threads,
 	web_config.setMapTileSize(map, context.tile_renderer->getTileSize());
 	web_config.writeConfigJS();
 
+	// the fingerprints of the tile pixels, when force-rendering all tiles are written
+	// anyway and the old fingerprints are not needed
+	fs::path tile_fingerprints_file = output_dir / "tiles.fingerprints";
+	TileFingerprints tile_fingerprints;
+	if (map_config.useTileFingerprints()) {
+		if (render_behaviors.getRenderBehavior(map, rotation) == RenderBehavior::AUTO)
+			tile_fingerprints.readFile(tile_fingerprints_file);
+		tile_fingerprints.initialize(*tile_set);
+		context.tile_fingerprints = &tile_fingerprints;
+	} else if (fs::exists(tile_fingerprints_file))
+		fs::remove(tile_fingerprints_file);
+
 	std::shared_ptr<thread::Dispatcher> dispatcher;
 	if (threads == 1 || tile_set->getRequiredRenderTilesCount() == 1)
 		dispatcher = std::make_shared<thread::SingleThreadDispatcher>();
 	else
-		dispatcher = std::make_shared<thread::MultiThreadingDispatcher>(threads);
+		dispatcher = std::make_shared<thread::MultiThreadingDispatcher>(threads, placement);
+
+	util::ProfileCounters profile;
+	if (util::Profiler::isEnabled())
+		context.profile = &profile;
 
 	// do the dance
+	auto time_start = std::chrono::steady_clock::now();
 	dispatcher->dispatch(context, progress);
+	double took = std::chrono::duration<double>(std::chrono::steady_clock::now()
+			- time_start).count();
+
+	if (context.profile != nullptr) {
+		std::string rotation_name = config::ROTATION_NAMES_SHORT[rotation];
+		profile.log("Profile of map " + map + " (" + rotation_name + ")");
+
+		picojson::object profile_json;
+		profile_json["map"] = picojson::value(map);
+		profile_json["rotation"] = picojson::value(rotation_name);
+		profile_json["threads"] = picojson::value((double) threads);
+		profile_json["render_tiles"] = picojson::value(
+				(double) tile_set->getRequiredRenderTilesCount());
+		profile_json["seconds"] = picojson::value(took);
+		profile_json["stages"] = profile.toJSON();
+		profiles.push_back(picojson::value(profile_json));
+	}
+
+	if (map_config.useTileFingerprints()
+			&& !tile_fingerprints.writeFile(tile_fingerprints_file))
+		LOG(WARNING) << "Unable to write tile fingerprints file '"
+				<< tile_fingerprints_file.string() << "'.";
 
 	// update the map settings with last render time
 	web_config.setMapLastRendered(map, rotation, time_started_scanning);
 	web_config.writeConfigJS();
+
+	// the fingerprints belong to that last render time
+	if (map_config.useChunkFingerprints() && !fingerprints.writeFile(fingerprints_file))
+		LOG(WARNING) << "Unable to write chunk fingerprints file '"
+				<< fingerprints_file.string() << "'.";
 }
 
 bool RenderManager::run(int threads, bool batch) {
@@ -353,17 +579,102 @@ bool RenderManager::run(int threads, bool batch) {
 		return false;
 
 	LOG(INFO) << "Scanning worlds...";
-	if (!scanWorlds())
+	if (!scanWorlds(threads))
+		return false;
+
+	renderRequiredMaps(threads, batch, nullptr);
+	LOG(INFO) << "Finished.....aaand it's gone!";
+	return true;
+}
+
+bool RenderManager::watch(int threads, bool batch, int delay) {
+	// the block images of every map/rotation are generated only once
+	keep_block_images = true;
+	if (!initialize())
+		return false;
+
+	LOG(INFO) << "Scanning worlds...";
+	if (!scanWorlds(threads))
 		return false;
 
+	// watch the region directories before rendering, so changes made while rendering
+	// are not missed
+	util::FileWatcher watcher(".mca");
+	for (auto it = unrotated_worlds.begin(); it != unrotated_worlds.end(); ++it) {
+		if (!watcher.addDirectory(it->second.getRegionDir())) {
+			LOG(FATAL) << "Unable to watch region directory '"
+					<< it->second.getRegionDir().string() << "'!";
+			return false;
+		}
+	}
+
+	renderRequiredMaps(threads, batch, nullptr);
+
+	// from now on the maps are rendered incremental
+	for (auto map_it = required_maps.begin(); map_it != required_maps.end(); ++map_it)
+		for (auto it = map_it->second.begin(); it != map_it->second.end(); ++it)
+			render_behaviors.setRenderBehavior(map_it->first, *it, RenderBehavior::AUTO);
+
+	while (true) {
+		LOG(INFO) << "Watching " << unrotated_worlds.size() << " world(s) for changes...";
+
+		// wait for changed region files, then collect more changes until no region file
+		// changed for the specified delay, but don't wait longer than ten times the delay
+		// (waiting without timeout fails only if the directories can't be watched anymore)
+		std::set<fs::path> changed;
+		if (!watcher.wait(changed)) {
+			LOG(FATAL) << "Unable to watch the region directories for changes!";
+			return false;
+		}
+		std::time_t first_change = std::time(nullptr);
+		while (watcher.wait(changed, delay * 1000)
+				&& std::time(nullptr) - first_change < delay * 10)
+			;
+
+		std::set<std::string> changed_worlds;
+		if (!rescanWorlds(threads, changed_worlds))
+			return false;
+		if (changed_worlds.empty())
+			continue;
+		renderRequiredMaps(threads, batch, &changed_worlds);
+	}
+	return true;
+}
+
+void RenderManager::renderRequiredMaps(int threads, bool batch,
+		const std::set<std::string>* worlds) {
 	int progress_maps = 0;
 	int progress_maps_all = required_maps.size();
 	int time_start_all = std::time(nullptr);
 
+	// the cache files of the block images are checked only when all maps are rendered
+	if (worlds == nullptr)
+		removeUnusedBlockImagesCaches();
+
+	// count how many of the map rotations use the same block images,
+	// so the block images can be released after the last one of them
+	std::map<std::pair<std::string, int>, uint64_t> map_block_images;
+	std::map<uint64_t, int> block_images_uses;
+	for (auto map_it = required_maps.begin(); map_it != required_maps.end(); ++map_it) {
+		config::MapSection map_config = config.getMap(map_it->first);
+		if (worlds != nullptr && !worlds->count(map_config.getWorld()))
+			continue;
+		std::shared_ptr<TextureResources> resources = getTextureResources(map_config, threads);
+		if (!resources)
+			continue;
+		for (auto it = map_it->second.begin(); it != map_it->second.end(); ++it) {
+			uint64_t key = getBlockImagesKey(map_config, *it, resources->getTexturesHash());
+			map_block_images[std::make_pair(map_it->first, *it)] = key;
+			block_images_uses[key]++;
+		}
+	}
+
 	// go through all required maps
 	for (auto map_it = required_maps.begin(); map_it != required_maps.end(); ++map_it) {
 		progress_maps++;
 		config::MapSection map_config = config.getMap(map_it->first);
+		if (worlds != nullptr && !worlds->count(map_config.getWorld()))
+			continue;
 
 		LOG(INFO) << "[" << progress_maps << "/" << progress_maps_all << "] "
 			<< "Rendering map " << map_config.getShortName() << " (\""
@@ -394,15 +705,34 @@ bool RenderManager::run(int threads, bool batch) {
 			util::LogOutputProgressHandler* log_output = new util::LogOutputProgressHandler;
 			progress->addHandler(log_output);
 
+			util::MetricsProgressHandler* metrics_output = nullptr;
+			if (metrics_sink) {
+				metrics.reset();
+				metrics_output = new util::MetricsProgressHandler(metrics_sink.get(),
+						map_config.getShortName(), config::ROTATION_NAMES_SHORT[*rotation_it],
+						&metrics);
+				progress->addHandler(metrics_output);
+			}
+
 			std::time_t time_start = std::time(nullptr);
 			renderMap(map_config.getShortName(), *rotation_it, threads, progress.get());
 			std::time_t took = std::time(nullptr) - time_start;
 
+			// the block images are kept when watching the worlds for changes
+			auto key_it = map_block_images.find(std::make_pair(map_it->first, *rotation_it));
+			if (key_it != map_block_images.end() && --block_images_uses[key_it->second] == 0
+					&& !keep_block_images)
+				block_images_cache.erase(key_it->second);
+
 			if (progress_bar != nullptr) {
 				progress_bar->finish();
 				delete progress_bar;
 			}
 			delete log_output;
+			if (metrics_output != nullptr) {
+				metrics_output->finish();
+				delete metrics_output;
+			}
 
 			LOG(INFO) << "[" << progress_maps << "." << progress_rotations << "/"
 				<< progress_maps << "." << progress_rotations_all << "] "
@@ -413,8 +743,18 @@ bool RenderManager::run(int threads, bool batch) {
 
 	std::time_t took_all = std::time(nullptr) - time_start_all;
 	LOG(INFO) << "Rendering all worlds took " << took_all << " seconds.";
-	LOG(INFO) << "Finished.....aaand it's gone!";
-	return true;
+
+	if (util::Profiler::isEnabled() && !profile_file.empty()) {
+		picojson::object report;
+		report["maps"] = picojson::value(profiles);
+		std::ofstream out(profile_file.string().c_str());
+		if (!out || !(out << picojson::value(report).serialize()))
+			LOG(WARNING) << "Unable to write profile file '" << profile_file.string() << "'.";
+		else
+			LOG(INFO) << "Wrote profile to '" << profile_file.string() << "'.";
+	}
+	if (!keep_block_images)
+		texture_resources.clear();
 }
 
 const std::vector<std::pair<std::string, std::set<int> > >& RenderManager::getRequiredMaps() const {
@@ -499,6 +839,81 @@ void RenderManager::writeTemplates() const {
 	}
 }
 
+std::shared_ptr<TextureResources> RenderManager::getTextureResources(
+		const config::MapSection& map_config, int threads) {
+	std::string key = map_config.getTextureDir().string() + "|"
+			+ util::str(map_config.getTextureSize()) + "|"
+			+ util::str(map_config.getTextureBlur()) + "|"
+			+ util::str(map_config.getWaterOpacity());
+	// textures that can't be loaded are remembered as well
+	if (texture_resources.count(key))
+		return texture_resources[key];
+
+	std::shared_ptr<TextureResources> resources(new TextureResources);
+	if (!resources->loadTextures(map_config.getTextureDir().string(),
+			map_config.getTextureSize(), map_config.getTextureBlur(),
+			map_config.getWaterOpacity(), threads))
+		resources.reset();
+	texture_resources[key] = resources;
+	return resources;
+}
+
+uint64_t RenderManager::getBlockImagesKey(const config::MapSection& map_config,
+		int rotation, uint64_t textures_hash) const {
+	// the options of the block images are set by the render view
+	std::unique_ptr<RenderView> render_view(createRenderView(map_config.getRenderView()));
+	std::unique_ptr<BlockImages> block_images(render_view->createBlockImages());
+	render_view->configureBlockImages(block_images.get(),
+			config.getWorld(map_config.getWorld()), map_config);
+	block_images->setRotation(rotation);
+
+	std::string version = std::string(MAPCRAFTER_VERSION) + MAPCRAFTER_GITVERSION
+			+ util::str(map_config.getRenderView());
+	uint64_t key = util::hash64(version.data(), version.size(), textures_hash);
+	return util::hash64(&key, sizeof(key), block_images->getOptionsHash());
+}
+
+fs::path RenderManager::getBlockImagesCacheFile(uint64_t key) const {
+	std::ostringstream filename;
+	filename << std::hex << std::setw(16) << std::setfill('0') << key;
+	return config.getOutputPath("blockimages/" + filename.str() + ".cache");
+}
+
+void RenderManager::removeUnusedBlockImagesCaches() {
+	fs::path cache_dir = config.getOutputPath("blockimages");
+	if (!fs::is_directory(cache_dir))
+		return;
+
+	// the cache files of all maps, also of the ones which are skipped this time
+	// (maps without texture directory don't have any)
+	std::set<fs::path> used_files;
+	auto config_maps = config.getMaps();
+	for (auto map_it = config_maps.begin(); map_it != config_maps.end(); ++map_it) {
+		if (!map_it->useBlockImagesCache() || !fs::is_directory(map_it->getTextureDir()))
+			continue;
+		uint64_t textures_hash = TextureResources::computeTexturesHash(
+				map_it->getTextureDir().string(), map_it->getTextureSize(),
+				map_it->getTextureBlur(), map_it->getWaterOpacity());
+		auto rotations = map_it->getRotations();
+		for (auto it = rotations.begin(); it != rotations.end(); ++it)
+			used_files.insert(getBlockImagesCacheFile(
+					getBlockImagesKey(*map_it, *it, textures_hash)).filename());
+	}
+
+	std::vector<fs::path> unused_files;
+	boost::system::error_code ec;
+	for (fs::directory_iterator it(cache_dir, ec), end; !ec && it != end; it.increment(ec))
+		if (it->path().extension() == ".cache" && !used_files.count(it->path().filename()))
+			unused_files.push_back(it->path());
+	for (auto it = unused_files.begin(); it != unused_files.end(); ++it) {
+		if (fs::remove(*it, ec))
+			LOG(INFO) << "Removed unused block images cache file '" << it->string() << "'.";
+		else
+			LOG(WARNING) << "Unable to remove unused block images cache file '"
+					<< it->string() << "'.";
+	}
+}
+
 void RenderManager::initializeMap(const std::string& map) {
 	config::MapSection map_config = config.getMap(map);
 
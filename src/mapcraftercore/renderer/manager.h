@@ -20,15 +20,18 @@
 #ifndef MANAGER_H_
 #define MANAGER_H_
 
+#include "fingerprints.h"
 #include "tilerenderer.h"
 #include "tileset.h"
 #include "../config/mapcrafterconfig.h"
 #include "../config/webconfig.h"
 #include "../mc/world.h"
 #include "../mc/worldcache.h"
+#include "../thread/affinity.h"
 
 #include <ctime>
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 #include <boost/filesystem.hpp>
@@ -43,6 +46,8 @@ class IProgressHandler;
 
 namespace renderer {
 
+class TextureResources;
+
 /**
  * This are the render options from the command line.
  */
@@ -54,6 +59,13 @@ struct RenderOpts {
 	std::vector<std::string> render_skip, render_auto, render_force;
 	bool skip_all, force_all;
 	int jobs;
+	thread::ThreadPinning pin_threads;
+	bool watch;
+	int watch_delay;
+	bool profile;
+	fs::path profile_json;
+	fs::path metrics_file;
+	util::MetricsFormat metrics_format;
 };
 
 /**
@@ -123,6 +135,25 @@ public:
 	 */
 	void setRenderBehaviors(const RenderBehaviors& render_behaviors);
 
+	/**
+	 * Sets whether/how render threads are pinned to CPUs/NUMA nodes. If render threads
+	 * are pinned, every used NUMA node gets its own copy of the block images.
+	 */
+	void setThreadPinning(thread::ThreadPinning pinning);
+
+	/**
+	 * Enables measuring how much time the render stages take. The profile of every
+	 * rendered map rotation is logged, and all of them are written to a JSON file after
+	 * rendering if a filename is specified.
+	 */
+	void setProfiling(bool enabled, const fs::path& json_file = fs::path());
+
+	/**
+	 * Enables writing metrics of the rendering (rendered tiles per second, decoded
+	 * chunks, written bytes, ...) of the map rotations to a file while rendering.
+	 */
+	void setMetrics(const fs::path& file, util::MetricsFormat format);
+
 	/**
 	 * Some basic initialization things. blah.
 	 * 
@@ -132,12 +163,13 @@ public:
 	bool initialize();
 
 	/**
-	 * Scans the worlds and create the tile sets.
+	 * Scans the worlds and create the tile sets. The region headers are read and the
+	 * tile sets are scanned with the specified count of threads.
 	 * 
 	 * Returns false if a fatal error occured (for example unable to read a world)
 	 * and rendering the maps won't work.
 	 */
-	bool scanWorlds();
+	bool scanWorlds(int threads = 1);
 
 	/**
 	 * Renders a map/rotation with a specified count of threads and logs the progress to
@@ -156,12 +188,71 @@ public:
 	 */
 	bool run(int threads, bool batch);
 
+	/**
+	 * Renders all maps like the run method and then watches the region directories of
+	 * the worlds. Whenever region files change, the maps of the changed worlds are
+	 * rendered incremental again. The block images, chunk indexes and tile sets are
+	 * kept in memory and only the headers of the changed region files are read again.
+	 *
+	 * Changes are collected until no region file changed for delay seconds. This
+	 * method returns only if an error occurs.
+	 */
+	bool watch(int threads, bool batch, int delay);
+
 	/**
 	 * Returns which maps with which rotations need to get rendered.
 	 */
 	const std::vector<std::pair<std::string, std::set<int> > >& getRequiredMaps() const;
 
 private:
+	/**
+	 * Scans the tile sets of some (world, render view, rotation) combinations from
+	 * the chunk indexes of the worlds and sets their zoom levels.
+	 */
+	void scanTileSets(const std::vector<config::TileSetID>& tile_sets, int threads);
+
+	/**
+	 * Reads the headers of changed region files again and scans the tile sets of the
+	 * worlds with changed regions again. The names of those worlds are added to the
+	 * set. Returns false if a world can not be loaded anymore.
+	 */
+	bool rescanWorlds(int threads, std::set<std::string>& changed_worlds);
+
+	/**
+	 * Renders all required maps/rotations, or only the ones of some worlds.
+	 */
+	void renderRequiredMaps(int threads, bool batch, const std::set<std::string>* worlds);
+
+	/**
+	 * Returns the textures of a map. The textures are loaded just once for all maps
+	 * with the same texture settings. Returns nullptr if they can't be loaded.
+	 * The block textures are loaded with the specified count of threads.
+	 */
+	std::shared_ptr<TextureResources> getTextureResources(
+			const config::MapSection& map_config, int threads);
+
+	/**
+	 * Returns the key of the block images of a map rotation. It identifies the render
+	 * view, the textures (by their hash, see TextureResources::getTexturesHash) and the
+	 * options of the block images, so maps with the same key can use the same block
+	 * images.
+	 */
+	uint64_t getBlockImagesKey(const config::MapSection& map_config, int rotation,
+			uint64_t textures_hash) const;
+
+	/**
+	 * Returns the file the block images with a key are cached in.
+	 */
+	fs::path getBlockImagesCacheFile(uint64_t key) const;
+
+	/**
+	 * Removes the block images cache files whose key isn't used by any map rotation of
+	 * the configuration anymore (for example because textures or options changed).
+	 * The textures are not loaded for that, only the files of the texture directories
+	 * are checked.
+	 */
+	void removeUnusedBlockImagesCaches();
+
 	/**
 	 * Copies a file from the template directory to the output directory and replaces the
 	 * variables from the map (every "{key}" in the file becomes "value").
@@ -201,6 +292,17 @@ private:
 	config::WebConfig web_config;
 
 	RenderBehaviors render_behaviors;
+	thread::ThreadPinning thread_pinning;
+
+	// file the profiles are written to (if profiling and not empty), and the profiles
+	// of the rendered map rotations (as json objects)
+	fs::path profile_file;
+	picojson::array profiles;
+
+	// sink the metrics are written to (if enabled), and the metrics of the map rotation
+	// which is currently rendered
+	std::unique_ptr<util::MetricsSink> metrics_sink;
+	util::RenderMetrics metrics;
 
 	// time when we started scanning the worlds, used as last last render time of the maps
 	std::time_t time_started_scanning;
@@ -210,9 +312,21 @@ private:
 
 	// maps for world- and tile set objects
 	std::map<std::string, std::array<mc::World, 4> > worlds;
+	// not rotated worlds and the chunks they contain
+	std::map<std::string, mc::World> unrotated_worlds;
+	std::map<std::string, ChunkIndex> world_chunks;
+	// chunk fingerprints of every world computed during this run
+	std::map<std::string, ChunkFingerprints> world_fingerprints;
 	// (world, render view, rotation) -> tile set
 	std::map<config::TileSetID, std::shared_ptr<TileSet> > tile_sets;
 
+	// texture settings -> loaded textures (or nullptr if they can't be loaded)
+	std::map<std::string, std::shared_ptr<TextureResources> > texture_resources;
+	// block images key (see getBlockImagesKey) -> block images of every used NUMA node,
+	// and whether they are kept for the next rendering
+	std::map<uint64_t, std::vector<std::shared_ptr<BlockImages> > > block_images_cache;
+	bool keep_block_images;
+
 	// all required (= not skipped) maps and rotations
 	// as pair (map name, required rotations)
 	std::vector<std::pair<std::string, std::set<int> > > required_maps;
@@ -56,6 +56,36 @@ DummyRenderer::~DummyRenderer() {
 
 const RenderModeRendererType DummyRenderer::TYPE = RenderModeRendererType::DUMMY;
 
+namespace {
+
+// a chunk and the blocks around it
+const int GRID_BLOCKS = 16 + 2;
+const int GRID_HEIGHT = mc::CHUNK_HEIGHT * 16 + 2;
+const int GRID_SECTION_SIZE = GRID_BLOCKS * GRID_BLOCKS * 16;
+
+}
+
+ChunkBlockGrid::ChunkBlockGrid(const mc::ChunkPos& chunk)
+	: chunk(chunk), sections((GRID_HEIGHT + 15) / 16) {
+}
+
+ChunkBlockGrid::~ChunkBlockGrid() {
+}
+
+uint8_t* ChunkBlockGrid::get(const mc::BlockPos& pos) {
+	int x = pos.x - chunk.x * 16 + 1;
+	int z = pos.z - chunk.z * 16 + 1;
+	int y = pos.y + 1;
+	if (x < 0 || x >= GRID_BLOCKS || z < 0 || z >= GRID_BLOCKS
+			|| y < 0 || y >= GRID_HEIGHT)
+		return nullptr;
+
+	std::unique_ptr<uint8_t[]>& section = sections[y / 16];
+	if (!section)
+		section.reset(new uint8_t[GRID_SECTION_SIZE]());
+	return &section[((y % 16) * GRID_BLOCKS + z) * GRID_BLOCKS + x];
+}
+
 MultiplexingRenderMode::~MultiplexingRenderMode() {
 	for (auto it = render_modes.begin(); it != render_modes.end(); ++it)
 		delete *it;
@@ -109,55 +139,89 @@ RenderMode* createRenderMode(const config::WorldSection& world_config,
 		const config::MapSection& map_config, int rotation) {
 	RenderModeType type = map_config.getRenderMode();
 	OverlayType overlay = map_config.getOverlay();
-	MultiplexingRenderMode* render_mode = new MultiplexingRenderMode();
-	
+
 	// create render mode
+	std::unique_ptr<CaveRenderMode> cave;
+	std::unique_ptr<LightingRenderMode> lighting;
+	std::unique_ptr<HeightOverlay> height;
 	if (type == RenderModeType::PLAIN) {
 		// nothing
 	} else if (type == RenderModeType::CAVE || type == RenderModeType::CAVELIGHT) {
 		// hide some walls of caves which would cover the view into the caves
 		if (map_config.getRenderView() == RenderViewType::ISOMETRIC)
-			render_mode->addRenderMode(new CaveRenderMode({mc::DIR_SOUTH, mc::DIR_WEST, mc::DIR_TOP}));
+			cave.reset(new CaveRenderMode({mc::DIR_SOUTH, mc::DIR_WEST, mc::DIR_TOP}));
 		else
-			render_mode->addRenderMode(new CaveRenderMode({mc::DIR_TOP}));
+			cave.reset(new CaveRenderMode({mc::DIR_TOP}));
 		// if we want some shadows, then simulate the sun light because it's dark in caves
 		if (type == RenderModeType::CAVELIGHT)
-			render_mode->addRenderMode(new LightingRenderMode(true, map_config.getLightingIntensity(),
+			lighting.reset(new LightingRenderMode(true, map_config.getLightingIntensity(),
 						map_config.getLightingWaterIntensity(), true));
-		render_mode->addRenderMode(new HeightOverlay());
+		height.reset(new HeightOverlay());
 	}
 	else if (type == RenderModeType::DAYLIGHT) {
-		render_mode->addRenderMode(new LightingRenderMode(true,
+		lighting.reset(new LightingRenderMode(true,
 					map_config.getLightingIntensity(), map_config.getLightingWaterIntensity(),
 					world_config.getDimension() == mc::Dimension::END));
 	} else if (type == RenderModeType::NIGHTLIGHT) {
-		render_mode->addRenderMode(new LightingRenderMode(false,
+		lighting.reset(new LightingRenderMode(false,
 					map_config.getLightingIntensity(), map_config.getLightingWaterIntensity(),
 					world_config.getDimension() == mc::Dimension::END));
 	} else {
 		// this shouldn't happen
-		delete render_mode;
 		assert(false);
 		return nullptr;
 	}
 	
 	// create overlay
+	std::unique_ptr<SlimeOverlay> slime;
+	std::unique_ptr<SpawnOverlay> spawn;
 	if (overlay == OverlayType::NONE) {
 		// nothing
 	} else if (overlay == OverlayType::SLIME) {
 		mc::World world(world_config.getInputDir().string(), world_config.getDimension());
-		render_mode->addRenderMode(new SlimeOverlay(world.getWorldDir(), rotation));
+		slime.reset(new SlimeOverlay(world.getWorldDir(), rotation));
 	} else if (overlay == OverlayType::SPAWNDAY) {
-		render_mode->addRenderMode(new SpawnOverlay(true));
+		spawn.reset(new SpawnOverlay(true));
 	} else if (overlay == OverlayType::SPAWNNIGHT) {
-		render_mode->addRenderMode(new SpawnOverlay(false));
+		spawn.reset(new SpawnOverlay(false));
 	} else {
 		// this shouldn't happen
-		delete render_mode;
 		assert(false);
 		return nullptr;
 	}
 
+	// compose the common combinations at compile time
+	if (overlay == OverlayType::NONE) {
+		if (cave && lighting)
+			return new RenderModeChain<CaveRenderMode, LightingRenderMode, HeightOverlay>(
+					cave.release(), lighting.release(), height.release());
+		if (cave)
+			return new RenderModeChain<CaveRenderMode, HeightOverlay>(
+					cave.release(), height.release());
+		if (lighting)
+			return new RenderModeChain<LightingRenderMode>(lighting.release());
+		return new RenderModeChain<>();
+	}
+	if (lighting && !cave) {
+		if (slime)
+			return new RenderModeChain<LightingRenderMode, SlimeOverlay>(
+					lighting.release(), slime.release());
+		return new RenderModeChain<LightingRenderMode, SpawnOverlay>(
+				lighting.release(), spawn.release());
+	}
+
+	// and use the multiplexing render mode for the others
+	MultiplexingRenderMode* render_mode = new MultiplexingRenderMode();
+	if (cave)
+		render_mode->addRenderMode(cave.release());
+	if (lighting)
+		render_mode->addRenderMode(lighting.release());
+	if (height)
+		render_mode->addRenderMode(height.release());
+	if (slime)
+		render_mode->addRenderMode(slime.release());
+	if (spawn)
+		render_mode->addRenderMode(spawn.release());
 	return render_mode;
 }
 
@@ -138,6 +138,27 @@ public:
 	static const RenderModeRendererType TYPE;
 };
 
+/**
+ * One byte for every block of a chunk and the blocks around it (a border of one block),
+ * for render modes that remember values derived from the world (see
+ * BaseRenderMode::createChunkData). The values are 0 initially, the memory is allocated
+ * in sections of 16 blocks height when a section is used first.
+ */
+class ChunkBlockGrid : public mc::ChunkData {
+public:
+	ChunkBlockGrid(const mc::ChunkPos& chunk);
+	virtual ~ChunkBlockGrid();
+
+	/**
+	 * Returns the value of a block, nullptr if the block is not in the grid.
+	 */
+	uint8_t* get(const mc::BlockPos& pos);
+
+private:
+	mc::ChunkPos chunk;
+	std::vector<std::unique_ptr<uint8_t[]> > sections;
+};
+
 /**
  * The base render mode class already implements handling of the initialize-method and
  * some other stuff (a comfortable getBlock-method that takes the current_chunk into
@@ -178,12 +199,28 @@ public:
 protected:
 	mc::Block getBlock(const mc::BlockPos& pos, int get = mc::GET_ID | mc::GET_DATA);
 
+	/**
+	 * Creates the data of the render mode for a chunk. The data is stored with the chunk
+	 * in the world cache, so a render mode can remember values derived from a chunk and
+	 * the blocks around it while the chunk is rendered (the data of only a few chunks is
+	 * kept, see mc::WorldCache). Returns nullptr as default.
+	 */
+	virtual mc::ChunkData* createChunkData(const mc::Chunk& chunk);
+
+	/**
+	 * Returns the data of the render mode for the current chunk, it is created with
+	 * createChunkData if there is none yet. Returns nullptr if there is no current chunk.
+	 */
+	mc::ChunkData* getChunkData();
+
 	RenderModeRenderer* renderer_ptr;
 	Renderer* renderer;
 
 	BlockImages* images;
 	mc::WorldCache* world;
 	mc::Chunk** current_chunk;
+
+	int chunk_data_slot;
 };
 
 /**
@@ -220,6 +257,66 @@ protected:
 	std::vector<RenderMode*> render_modes;
 };
 
+/**
+ * Combines render modes into one like the multiplexing render mode, but with the types
+ * of the render modes known at compile time. The render modes are called directly,
+ * without virtual calls, so their methods can be inlined (the default isHidden/draw
+ * methods of the base render mode for example). The render modes are called in the
+ * order of the template arguments.
+ *
+ * The chain is used for the common combinations of render modes, the multiplexing
+ * render mode for all others.
+ */
+template <typename... RenderModes>
+class RenderModeChain;
+
+template <>
+class RenderModeChain<> : public RenderMode {
+public:
+	virtual ~RenderModeChain() {}
+
+	virtual void initialize(const RenderView* render_view, BlockImages* images,
+			mc::WorldCache* world, mc::Chunk** current_chunk) {}
+
+	virtual bool isHidden(const mc::BlockPos& pos, uint16_t id, uint16_t data) {
+		return false;
+	}
+
+	virtual void draw(RGBAImage& image, const mc::BlockPos& pos, uint16_t id,
+			uint16_t data) {}
+};
+
+template <typename First, typename... Rest>
+class RenderModeChain<First, Rest...> : public RenderModeChain<Rest...> {
+public:
+	/**
+	 * The supplied render modes are destroyed when the chain is destroyed.
+	 */
+	RenderModeChain(First* first, Rest*... rest)
+		: RenderModeChain<Rest...>(rest...), first(first) {}
+	virtual ~RenderModeChain() {}
+
+	virtual void initialize(const RenderView* render_view, BlockImages* images,
+			mc::WorldCache* world, mc::Chunk** current_chunk) {
+		first->First::initialize(render_view, images, world, current_chunk);
+		RenderModeChain<Rest...>::initialize(render_view, images, world, current_chunk);
+	}
+
+	virtual bool isHidden(const mc::BlockPos& pos, uint16_t id, uint16_t data) {
+		return first->First::isHidden(pos, id, data)
+				|| RenderModeChain<Rest...>::isHidden(pos, id, data);
+	}
+
+	virtual void draw(RGBAImage& image, const mc::BlockPos& pos, uint16_t id,
+			uint16_t data) {
+		first->First::draw(image, pos, id, data);
+		RenderModeChain<Rest...>::draw(image, pos, id, data);
+	}
+
+private:
+	std::unique_ptr<First> first;
+};
+
 /**
  * Types of (of other base render modes composed) render modes that are available for
  * the user.
@@ -250,7 +347,8 @@ RenderMode* createRenderMode(const config::WorldSection& world_config,
 
 template <typename Renderer>
 BaseRenderMode<Renderer>::BaseRenderMode()
-	: renderer_ptr(nullptr), images(nullptr), world(nullptr), current_chunk(nullptr) {
+	: renderer_ptr(nullptr), images(nullptr), world(nullptr), current_chunk(nullptr),
+	  chunk_data_slot(-1) {
 }
 
 template <typename Renderer>
@@ -272,6 +370,7 @@ void BaseRenderMode<Renderer>::initialize(const RenderView* render_view,
 	this->images = images;
 	this->world = world;
 	this->current_chunk = current_chunk;
+	this->chunk_data_slot = world->addChunkDataSlot();
 }
 
 template <typename Renderer>
@@ -290,6 +389,25 @@ mc::Block BaseRenderMode<Renderer>::getBlock(const mc::BlockPos& pos, int get) {
 	return world->getBlock(pos, *current_chunk, get);
 }
 
+template <typename Renderer>
+mc::ChunkData* BaseRenderMode<Renderer>::createChunkData(const mc::Chunk& chunk) {
+	return nullptr;
+}
+
+template <typename Renderer>
+mc::ChunkData* BaseRenderMode<Renderer>::getChunkData() {
+	const mc::Chunk* chunk = *current_chunk;
+	if (chunk == nullptr)
+		return nullptr;
+	mc::ChunkData* data = world->getChunkData(chunk, chunk_data_slot);
+	if (data == nullptr) {
+		data = createChunkData(*chunk);
+		if (data == nullptr || !world->setChunkData(chunk, chunk_data_slot, data))
+			return nullptr;
+	}
+	return data;
+}
+
 } /* namespace render */
 } /* namespace mapcrafter */
 
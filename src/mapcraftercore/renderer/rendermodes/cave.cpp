@@ -26,6 +26,23 @@
 namespace mapcrafter {
 namespace renderer {
 
+namespace {
+
+// the block was looked up
+const uint8_t BLOCK_KNOWN = 1;
+// the block touches sky light
+const uint8_t BLOCK_LIGHT = 2;
+// the block is transparent (or air)
+const uint8_t BLOCK_TRANSPARENT = 4;
+// the block is water
+const uint8_t BLOCK_WATER = 8;
+// it is known whether the first non-water block at or above this block is lit
+const uint8_t SURFACE_KNOWN = 16;
+// the first non-water block at or above this block is lit
+const uint8_t SURFACE_LIGHT = 32;
+
+}
+
 CaveRenderMode::CaveRenderMode(const std::vector<mc::BlockPos>& hidden_dirs)
 	: hidden_dirs(hidden_dirs) {
 }
@@ -33,14 +50,69 @@ CaveRenderMode::CaveRenderMode(const std::vector<mc::BlockPos>& hidden_dirs)
 CaveRenderMode::~CaveRenderMode() {
 }
 
+mc::ChunkData* CaveRenderMode::createChunkData(const mc::Chunk& chunk) {
+	return new ChunkBlockGrid(chunk.getPos());
+}
+
 bool CaveRenderMode::isLight(const mc::BlockPos& pos) {
-	return getBlock(pos, mc::GET_SKY_LIGHT).sky_light > 0;
+	return getBlockFlags(pos) & BLOCK_LIGHT;
 }
 
 bool CaveRenderMode::isTransparentBlock(const mc::Block& block) const {
 	return block.id == 0 || images->isBlockTransparent(block.id, block.data);
 }
 
+uint8_t CaveRenderMode::getBlockFlags(const mc::BlockPos& pos) {
+	uint8_t* cached = getCachedFlags(pos);
+	if (cached != nullptr && (*cached & BLOCK_KNOWN))
+		return *cached;
+
+	mc::Block block = getBlock(pos, mc::GET_ID | mc::GET_DATA | mc::GET_SKY_LIGHT);
+	uint8_t flags = BLOCK_KNOWN;
+	if (block.sky_light > 0)
+		flags |= BLOCK_LIGHT;
+	if (isTransparentBlock(block))
+		flags |= BLOCK_TRANSPARENT;
+	if (block.id == 8 || block.id == 9)
+		flags |= BLOCK_WATER;
+	if (cached != nullptr)
+		*cached = flags;
+	return flags;
+}
+
+bool CaveRenderMode::isWaterSurfaceLight(const mc::BlockPos& pos) {
+	// go up to the first block that isn't water
+	// (or to a block where we already know the result)
+	mc::BlockPos p = pos;
+	bool light;
+	while (true) {
+		uint8_t flags = getBlockFlags(p);
+		if (!(flags & BLOCK_WATER)) {
+			light = flags & BLOCK_LIGHT;
+			break;
+		}
+		uint8_t* cached = getCachedFlags(p);
+		if (cached != nullptr && (*cached & SURFACE_KNOWN)) {
+			light = *cached & SURFACE_LIGHT;
+			break;
+		}
+		p.y++;
+	}
+
+	// remember the result for the water blocks below
+	for (mc::BlockPos q = pos; q.y < p.y; q.y++) {
+		uint8_t* cached = getCachedFlags(q);
+		if (cached != nullptr)
+			*cached |= SURFACE_KNOWN | (light ? SURFACE_LIGHT : 0);
+	}
+	return light;
+}
+
+uint8_t* CaveRenderMode::getCachedFlags(const mc::BlockPos& pos) {
+	ChunkBlockGrid* grid = static_cast<ChunkBlockGrid*>(getChunkData());
+	return grid != nullptr ? grid->get(pos) : nullptr;
+}
+
 bool CaveRenderMode::isHidden(const mc::BlockPos& pos, uint16_t id, uint16_t data) {
 	mc::BlockPos directions[6] = {
 		mc::DIR_NORTH, mc::DIR_SOUTH, mc::DIR_EAST, mc::DIR_WEST,
@@ -57,27 +129,16 @@ bool CaveRenderMode::isHidden(const mc::BlockPos& pos, uint16_t id, uint16_t dat
 	// we need to check if there is sunlight on the surface of the water
 	// if yes => no cave, hide block
 	// if no  => lake in a cave, show it
-	mc::Block top = getBlock(pos + mc::DIR_TOP,
-			mc::GET_ID | mc::GET_DATA | mc::GET_SKY_LIGHT);
-	if (id == 8 || id == 9 || top.id == 8 || top.id == 9) {
-		mc::BlockPos p = pos + mc::DIR_TOP;
-		mc::Block block(pos + mc::DIR_TOP, top.id, top.data);
-		block.sky_light = top.sky_light;
-
-		while (block.id == 8 || block.id == 9) {
-			block = getBlock(p, mc::GET_ID | mc::GET_DATA | mc::GET_SKY_LIGHT);
-			p.y++;
-		}
-
-		if (block.sky_light > 0)
-			return true;
-	}
+	bool water = id == 8 || id == 9;
+	if ((water || (getBlockFlags(pos + mc::DIR_TOP) & BLOCK_WATER))
+			&& isWaterSurfaceLight(pos + mc::DIR_TOP))
+		return true;
 
 	// so we show all block which aren't touched by sunlight...
 	// and also only the ones that have a transparent block (or air)
 	// on at least one of specific sides
 	for (auto it = hidden_dirs.begin(); it != hidden_dirs.end(); ++it)
-		if (isTransparentBlock(getBlock(pos + *it)))
+		if (getBlockFlags(pos + *it) & BLOCK_TRANSPARENT)
 			return false;
 	return true;
 }
@@ -37,9 +37,24 @@ public:
 			uint16_t id, uint16_t data);
 
 protected:
+	virtual mc::ChunkData* createChunkData(const mc::Chunk& chunk);
+
 	bool isLight(const mc::BlockPos& pos);
 	bool isTransparentBlock(const mc::Block& block) const;
 
+	/**
+	 * Returns the flags of a block (whether it's lit by the sun, transparent or water).
+	 * The flags of the current chunk (and of the blocks around it) are stored with the
+	 * chunk.
+	 */
+	uint8_t getBlockFlags(const mc::BlockPos& pos);
+
+	/**
+	 * Returns whether the first block at or above this block that isn't water is lit
+	 * by the sun.
+	 */
+	bool isWaterSurfaceLight(const mc::BlockPos& pos);
+
 	// we want to hide some additional cave blocks to be able to look "inside" the caves,
 	// so it's possible to specify directions where cave blocks must touch transparent
 	// blocks (or air), there must be a transparent block in at least one directions
@@ -47,6 +62,13 @@ protected:
 	// (because you are looking from the south-west-top at the map and don't want your
 	// view into the cave covered by the southern, western, and top walls)
 	std::vector<mc::BlockPos> hidden_dirs;
+
+private:
+	/**
+	 * Returns the stored flags of a block, nullptr if the block is not in the grid of
+	 * the current chunk.
+	 */
+	uint8_t* getCachedFlags(const mc::BlockPos& pos);
 };
 
 } /* namespace render */
@@ -261,14 +261,15 @@ LightingRenderMode::LightingRenderMode(bool day, double lighting_intensity,
 	: day(day), lighting_intensity(lighting_intensity),
 	  lighting_water_intensity(lighting_water_intensity),
 	  simulate_sun_light(simulate_sun_light) {
+	for (int i = 0; i < 16; i++)
+		lighting_colors[i] = pow(0.8, 15 - i);
 }
 
 LightingRenderMode::~LightingRenderMode() {
 }
 
-bool LightingRenderMode::isHidden(const mc::BlockPos& pos,
-		uint16_t id, uint16_t data) {
-	return false;
+mc::ChunkData* LightingRenderMode::createChunkData(const mc::Chunk& chunk) {
+	return new ChunkBlockGrid(chunk.getPos());
 }
 
 void LightingRenderMode::draw(RGBAImage& image, const mc::BlockPos& pos,
@@ -302,10 +303,6 @@ void LightingRenderMode::draw(RGBAImage& image, const mc::BlockPos& pos,
 	}
 }
 
-LightingColor LightingRenderMode::calculateLightingColor(const LightingData& light) const {
-	return pow(0.8, 15 - light.getLightLevel(day));
-}
-
 LightingData LightingRenderMode::getBlockLight(const mc::BlockPos& pos) {
 	mc::Block block = getBlock(pos, mc::GET_ID | mc::GET_DATA | mc::GET_LIGHT);
 	LightingData light = LightingData::estimate(block, images, world, *current_chunk);
@@ -323,9 +320,19 @@ LightingData LightingRenderMode::getBlockLight(const mc::BlockPos& pos) {
 	return light;
 }
 
+uint8_t LightingRenderMode::getLightLevel(const mc::BlockPos& pos) {
+	ChunkBlockGrid* grid = static_cast<ChunkBlockGrid*>(getChunkData());
+	uint8_t* cached = grid != nullptr ? grid->get(pos) : nullptr;
+	if (cached == nullptr)
+		return getBlockLight(pos).getLightLevel(day);
+	// the grid stores the light level + 1, 0 means not calculated yet
+	if (*cached == 0)
+		*cached = getBlockLight(pos).getLightLevel(day) + 1;
+	return *cached - 1;
+}
+
 LightingColor LightingRenderMode::getLightingColor(const mc::BlockPos& pos, double intensity) {
-	LightingData lighting = getBlockLight(pos);
-	LightingColor color = calculateLightingColor(lighting);
+	LightingColor color = lighting_colors[getLightLevel(pos)];
 	return color + (1-color)*(1-intensity);
 }
 
@@ -156,28 +156,29 @@ public:
 			double lighting_water_intensity, bool simulate_sun_light);
 	virtual ~LightingRenderMode();
 
-	virtual bool isHidden(const mc::BlockPos& pos, uint16_t id, uint16_t data);
 	virtual void draw(RGBAImage& image, const mc::BlockPos& pos, uint16_t id, uint16_t data);
 
+protected:
+	virtual mc::ChunkData* createChunkData(const mc::Chunk& chunk);
+
 private:
 	bool day;
 	double lighting_intensity, lighting_water_intensity;
 	bool simulate_sun_light;
 
-	/**
-	 * Calculates the color of the light of a block.
-	 *
-	 * This uses the formula 0.8**(15 - max(block_light, sky_light))
-	 * When calculating nightlight, the skylight is reduced by 11.
-	 */
-	LightingColor calculateLightingColor(const LightingData& light) const;
-
 	/**
 	 * Returns the light of a block (sky/block light). This also means that the light is
 	 * estimated if the block is a special transparent block.
 	 */
 	LightingData getBlockLight(const mc::BlockPos& pos);
 
+	/**
+	 * Returns the light level of a block. The light levels of the current chunk (and
+	 * of the blocks around it) are stored with the chunk because every block is a
+	 * neighbor of many face corners.
+	 */
+	uint8_t getLightLevel(const mc::BlockPos& pos);
+
 	/**
 	 * Returns the lighting color of a block.
 	 */
@@ -213,6 +214,10 @@ private:
 	 * color of the block.
 	 */
 	void doSimpleLight(RGBAImage& image, const mc::BlockPos& pos, uint16_t id, uint16_t data);
+
+	// lighting colors of the light levels, this uses the formula 0.8**(15 - light level)
+	// (at night the sky light is reduced by 11, see LightingData::getLightLevel)
+	std::array<LightingColor, 16> lighting_colors;
 };
 
 } /* namespace render */
@@ -327,6 +327,11 @@ void IsometricBlockImages::setBlockSideDarkening(double left, double right) {
 	this->dright = right;
 }
 
+uint64_t IsometricBlockImages::getOptionsHash() const {
+	double darkening[2] = {dleft, dright};
+	return util::hash64(darkening, sizeof(darkening), AbstractBlockImages::getOptionsHash());
+}
+
 bool IsometricBlockImages::isBlockTransparent(uint16_t id, uint16_t data) const {
 	return AbstractBlockImages::isBlockTransparent(id, data & ~(EDGE_NORTH | EDGE_EAST | EDGE_BOTTOM));
 }
@@ -1954,7 +1959,7 @@ RGBAImage IsometricBlockImages::createUnknownBlock() const {
 
 RGBAImage IsometricBlockImages::createBiomeBlock(uint16_t id, uint16_t data,
         const Biome& biome) const {
-	if (!block_images.count(id | (data << 16)))
+	if (!hasBlock(id, data))
 		return unknown_block;
 
 	uint32_t color;
@@ -1971,7 +1976,7 @@ RGBAImage IsometricBlockImages::createBiomeBlock(uint16_t id, uint16_t data,
 
 	// grass block needs something special
 	if (id == 2) {
-		RGBAImage block = block_images.at(id | (data << 16));
+		RGBAImage block = getBlockImage(id, data);
 		RGBAImage side = resources.getBlockTextures().GRASS_SIDE_OVERLAY.colorize(r, g, b);
 
 		// blit the side overlay over the block
@@ -1987,7 +1992,7 @@ RGBAImage IsometricBlockImages::createBiomeBlock(uint16_t id, uint16_t data,
 		return block;
 	}
 
-	return block_images.at(id | (data << 16)).colorize(r, g, b);
+	return getBlockImage(id, data).colorize(r, g, b);
 }
 
 void IsometricBlockImages::createBlocks() {
@@ -2612,17 +2617,14 @@ int IsometricBlockImages::createOpaqueWater() {
 }
 
 std::vector<RGBAImage> IsometricBlockImages::getExportBlocks() const {
-	std::map<uint32_t, RGBAImage, block_images_comparator> blocks_sorted;
-	for (auto it = block_images.begin(); it != block_images.end(); ++it) {
-		uint16_t data = (it->first & 0xffff0000) >> 16;
+	// the block images are already sorted by id and data
+	std::vector<RGBAImage> blocks;
+	for (size_t i = 0; i < atlas_blocks.size(); i++) {
+		uint16_t data = (atlas_block_keys[i] & 0xffff0000) >> 16;
 		// ignore special variants of the blocks
 		if ((data & (EDGE_NORTH | EDGE_EAST | EDGE_BOTTOM)) == 0)
-			blocks_sorted[it->first] = it->second;
+			blocks.push_back(atlas_blocks[i]);
 	}
-
-	std::vector<RGBAImage> blocks;
-	for (auto it = blocks_sorted.begin(); it != blocks_sorted.end(); ++it)
-		blocks.push_back(it->second);
 	return blocks;
 }
 
@@ -196,6 +196,8 @@ public:
 
 	void setBlockSideDarkening(double left, double right);
 
+	virtual uint64_t getOptionsHash() const;
+
 	virtual bool isBlockTransparent(uint16_t id, uint16_t data) const;
 
 	/**
@@ -22,27 +22,90 @@
 #include "blockimages.h"
 #include "../../image.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace mapcrafter {
 namespace renderer {
 
+namespace {
+
+// the corner weights of the face pixels add up to 1 << SHADE_BITS
+const int SHADE_BITS = 12;
+// the corner colors are multiplied with 255 << COLOR_BITS
+const int COLOR_BITS = 8;
+
+/**
+ * Calculates the weights of the corner colors (top left / top right / bottom left /
+ * bottom right) of every pixel of a shade image, in the same way as
+ * LightingRenderer::createShade draws the two triangles.
+ */
+std::vector<std::array<double, 4> > createShadeWeights(int size) {
+	std::vector<std::array<double, 4> > weights(size * size);
+	double fyStep = (double) 1 / (size-1);
+
+	// bottom triangle with corners top left, bottom left and bottom right
+	double fy = 0;
+	for (int y = 0; y < size; y++, fy+=fyStep) {
+		double fx = 0;
+		double fxStep = 0;
+		if (y != 0)
+			fxStep = (double) 1 / y;
+		else
+			fx = 1;
+		for (int x = 0; x <= y; x++, fx+=fxStep) {
+			std::array<double, 4> weight = {{1 - fy, 0, fy * (1 - fx), fy * fx}};
+			weights[y * size + x] = weight;
+		}
+	}
+
+	// top triangle with corners bottom right, top right and top left
+	fy = 0;
+	for (int y = 0; y < size; y++, fy+=fyStep) {
+		double fx = 0;
+		double fxStep = 0;
+		if (y != 0)
+			fxStep = (double) 1 / y;
+		else
+			fx = 1;
+		for (int x = 0; x <= y; x++, fx+=fxStep) {
+			std::array<double, 4> weight = {{fy * fx, fy * (1 - fx), 0, 1 - fy}};
+			weights[(size-1-y) * size + (size-1-x)] = weight;
+		}
+	}
+	return weights;
+}
+
+/**
+ * Converts the corner weights of a pixel to fixed point, the rounded weights still add
+ * up to 1 << SHADE_BITS.
+ */
+std::array<uint16_t, 4> toFixedWeights(const std::array<double, 4>& weights) {
+	std::array<uint16_t, 4> fixed;
+	int sum = 0, largest = 0;
+	for (int i = 0; i < 4; i++) {
+		fixed[i] = std::round(weights[i] * (1 << SHADE_BITS));
+		sum += fixed[i];
+		if (fixed[i] > fixed[largest])
+			largest = i;
+	}
+	fixed[largest] += (1 << SHADE_BITS) - sum;
+	return fixed;
+}
+
+}
+
+IsometricLightingRenderer::IsometricLightingRenderer()
+	: face_pixels_size(-1) {
+}
+
 IsometricLightingRenderer::~IsometricLightingRenderer() {
 }
 
 void IsometricLightingRenderer::lightLeft(RGBAImage& image, const CornerColors& colors,
 		int y_start, int y_end) const {
-	int size = image.getWidth() / 2;
-	RGBAImage shade(size, size);
-	createShade(shade, colors);
-
-	for (SideFaceIterator it(size, SideFaceIterator::LEFT); !it.end(); it.next()) {
-		if (it.src_y < y_start || it.src_y > y_end)
-			continue;
-		uint32_t& pixel = image.pixel(it.dest_x, it.dest_y + size/2);
-		if (pixel != 0) {
-			uint8_t d = rgba_alpha(shade.pixel(it.src_x, it.src_y));
-			pixel = rgba_multiply(pixel, d, d, d);
-		}
-	}
+	createFacePixels(image.getWidth() / 2);
+	lightFace(image, left_pixels, colors, 0, y_start, y_end);
 }
 
 void IsometricLightingRenderer::lightLeft(RGBAImage& image, const CornerColors& colors) const {
@@ -51,19 +114,8 @@ void IsometricLightingRenderer::lightLeft(RGBAImage& image, const CornerColors&
 
 void IsometricLightingRenderer::lightRight(RGBAImage& image, const CornerColors& colors,
 		int y_start, int y_end) const {
-	int size = image.getWidth() / 2;
-	RGBAImage shade(size, size);
-	createShade(shade, colors);
-
-	for (SideFaceIterator it(size, SideFaceIterator::RIGHT); !it.end(); it.next()) {
-		if (it.src_y < y_start || it.src_y > y_end)
-			continue;
-		uint32_t& pixel = image.pixel(it.dest_x + size, it.dest_y + size/2);
-		if (pixel != 0) {
-			uint8_t d = rgba_alpha(shade.pixel(it.src_x, it.src_y));
-			pixel = rgba_multiply(pixel, d, d, d);
-		}
-	}
+	createFacePixels(image.getWidth() / 2);
+	lightFace(image, right_pixels, colors, 0, y_start, y_end);
 }
 
 void IsometricLightingRenderer::lightRight(RGBAImage& image, const CornerColors& colors) const {
@@ -72,16 +124,70 @@ void IsometricLightingRenderer::lightRight(RGBAImage& image, const CornerColors&
 
 void IsometricLightingRenderer::lightTop(RGBAImage& image, const CornerColors& colors,
 		int yoff) const {
-		int size = image.getWidth() / 2;
-	RGBAImage shade(size, size);
-	// we need to rotate the corners a bit to make them suitable for the TopFaceIterator
-	CornerColors rotated = {{colors[1], colors[3], colors[0], colors[2]}};
-	createShade(shade, rotated);
+	int size = image.getWidth() / 2;
+	createFacePixels(size);
+	lightFace(image, top_pixels, colors, yoff, 0, size);
+}
+
+void IsometricLightingRenderer::createFacePixels(int size) const {
+	if (size == face_pixels_size)
+		return;
+	face_pixels_size = size;
+
+	std::vector<std::array<double, 4> > weights = createShadeWeights(size);
+	FacePixel pixel;
 
+	left_pixels.clear();
+	for (SideFaceIterator it(size, SideFaceIterator::LEFT); !it.end(); it.next()) {
+		pixel.x = it.dest_x;
+		pixel.y = it.dest_y + size/2;
+		pixel.src_y = it.src_y;
+		pixel.weights = toFixedWeights(weights[it.src_y * size + it.src_x]);
+		left_pixels.push_back(pixel);
+	}
+
+	right_pixels.clear();
+	for (SideFaceIterator it(size, SideFaceIterator::RIGHT); !it.end(); it.next()) {
+		pixel.x = it.dest_x + size;
+		pixel.y = it.dest_y + size/2;
+		pixel.src_y = it.src_y;
+		pixel.weights = toFixedWeights(weights[it.src_y * size + it.src_x]);
+		right_pixels.push_back(pixel);
+	}
+
+	// we need to rotate the corners a bit to make them suitable for the TopFaceIterator
+	const int rotated[4] = {1, 3, 0, 2};
+	top_pixels.clear();
 	for (TopFaceIterator it(size); !it.end(); it.next()) {
-		uint32_t& pixel = image.pixel(it.dest_x, it.dest_y + yoff);
+		const std::array<double, 4>& weight = weights[it.src_y * size + it.src_x];
+		std::array<double, 4> weight_rotated;
+		for (int i = 0; i < 4; i++)
+			weight_rotated[rotated[i]] = weight[i];
+		pixel.x = it.dest_x;
+		pixel.y = it.dest_y;
+		pixel.src_y = it.src_y;
+		pixel.weights = toFixedWeights(weight_rotated);
+		top_pixels.push_back(pixel);
+	}
+}
+
+void IsometricLightingRenderer::lightFace(RGBAImage& image,
+		const std::vector<FacePixel>& pixels, const CornerColors& colors,
+		int yoff, int y_start, int y_end) const {
+	uint32_t corners[4];
+	for (int i = 0; i < 4; i++) {
+		double color = std::min(std::max(colors[i], 0.0), 1.0);
+		corners[i] = color * (255 << COLOR_BITS);
+	}
+
+	for (auto it = pixels.begin(); it != pixels.end(); ++it) {
+		if (it->src_y < y_start || it->src_y > y_end)
+			continue;
+		uint32_t& pixel = image.pixel(it->x, it->y + yoff);
 		if (pixel != 0) {
-			uint8_t d = rgba_alpha(shade.pixel(it.src_x, it.src_y));
+			uint8_t d = (it->weights[0] * corners[0] + it->weights[1] * corners[1]
+					+ it->weights[2] * corners[2] + it->weights[3] * corners[3])
+					>> (SHADE_BITS + COLOR_BITS);
 			pixel = rgba_multiply(pixel, d, d, d);
 		}
 	}
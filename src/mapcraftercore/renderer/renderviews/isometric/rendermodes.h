@@ -23,11 +23,16 @@
 #ifndef ISOMETRIC_RENDERMODES_H_
 #define ISOMETRIC_RENDERMODES_H_
 
+#include <array>
+#include <cstdint>
+#include <vector>
+
 namespace mapcrafter {
 namespace renderer {
 
 class IsometricLightingRenderer : public LightingRenderer {
 public:
+	IsometricLightingRenderer();
 	virtual ~IsometricLightingRenderer();
 
 	virtual void lightLeft(RGBAImage& image, const CornerColors& colors,
@@ -39,6 +44,34 @@ public:
 	virtual void lightRight(RGBAImage& image, const CornerColors& colors) const;
 
 	virtual void lightTop(RGBAImage& image, const CornerColors& colors, int yoff) const;
+
+private:
+	/**
+	 * A pixel of a block face: The position in the block image, the row in the face
+	 * texture (to light only a part of side faces) and the fixed point weights of the
+	 * four corner colors.
+	 */
+	struct FacePixel {
+		int16_t x, y, src_y;
+		std::array<uint16_t, 4> weights;
+	};
+
+	/**
+	 * Creates the pixel tables of the faces for a texture size if they were created
+	 * for a different size.
+	 */
+	void createFacePixels(int size) const;
+
+	/**
+	 * Multiplies the pixels of a face with the interpolated corner colors.
+	 */
+	void lightFace(RGBAImage& image, const std::vector<FacePixel>& pixels,
+			const CornerColors& colors, int yoff, int y_start, int y_end) const;
+
+	// the pixel tables are created when they are needed first,
+	// every render mode has its own renderer, so this is not shared between threads
+	mutable int face_pixels_size;
+	mutable std::vector<FacePixel> left_pixels, right_pixels, top_pixels;
 };
 
 class IsometricOverlayRenderer : public OverlayRenderer {
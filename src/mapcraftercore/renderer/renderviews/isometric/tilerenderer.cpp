@@ -61,13 +61,8 @@ TileTopBlockIterator::TileTopBlockIterator(const TilePos& tile, int block_size,
 	max_col = top.getCol() + 2;
 	min_col = max_col - (32 * tile_width);
 
-	// calculate position of the first block, relative row/col in this tile are needed
-	int row = current.getRow() - min_row;
-	int col = current.getCol() - min_col;
-	// every column is a 1/2 block and every row is a 1/4 block
-	draw_x = col * block_size / 2;
-	// -1/2 blocksize, because we would see the top side of the blocks in the tile if not
-	draw_y = row * block_size / 4 - block_size / 2; // -16
+	// calculate position of the first block
+	getDrawPosition(current, draw_x, draw_y);
 }
 
 TileTopBlockIterator::~TileTopBlockIterator() {
@@ -98,8 +93,7 @@ void TileTopBlockIterator::next() {
 	// now calculate the block position like in the constructor
 	int row = current.getRow();
 	int col = current.getCol();
-	draw_x = (col - min_col) * block_size / 2;
-	draw_y = (row - min_row) * block_size / 4 - block_size / 2; // -16
+	getDrawPosition(current, draw_x, draw_y);
 
 	// and set end if reached
 	if (row == max_row && col == min_col)
@@ -112,6 +106,17 @@ bool TileTopBlockIterator::end() const {
 	return is_end;
 }
 
+void TileTopBlockIterator::getDrawPosition(const mc::BlockPos& block,
+		int& draw_x, int& draw_y) const {
+	// relative row/col in this tile are needed
+	int row = block.getRow() - min_row;
+	int col = block.getCol() - min_col;
+	// every column is a 1/2 block and every row is a 1/4 block
+	draw_x = col * block_size / 2;
+	// -1/2 blocksize, because we would see the top side of the blocks in the tile if not
+	draw_y = row * block_size / 4 - block_size / 2; // -16
+}
+
 BlockRowIterator::BlockRowIterator(const mc::BlockPos& block) {
 	current = block;
 }
@@ -145,9 +150,41 @@ IsometricTileRenderer::~IsometricTileRenderer() {
 }
 
 void IsometricTileRenderer::renderTile(const TilePos& tile_pos, RGBAImage& tile) {
-	// some vars, set correct image size
-	int block_size = images->getBlockSize();
 	tile.setSize(getTileSize(), getTileSize());
+	renderTileBlocks(tile_pos, tile, nullptr);
+}
+
+void IsometricTileRenderer::renderTileRegions(const TilePos& tile_pos,
+		const std::vector<TileRegion>& regions, RGBAImage& tile) {
+	renderTileBlocks(tile_pos, tile, &regions);
+}
+
+int IsometricTileRenderer::getTileSize() const {
+	return images->getBlockSize() * 16 * tile_width;
+}
+
+bool IsometricTileRenderer::getChunkRegion(const TilePos& tile_pos,
+		const mc::ChunkPos& chunk, TileRegion& region) const {
+	int block_size = images->getBlockSize();
+	TileTopBlockIterator it(tile_pos, block_size, tile_width);
+
+	// the blocks of the chunk and the blocks around it, the leftmost block is the one
+	// with the lowest x and z, the topmost one the highest block with the lowest z
+	// and highest x and so on
+	int x1 = chunk.x * 16 - 1, x2 = chunk.x * 16 + 16;
+	int z1 = chunk.z * 16 - 1, z2 = chunk.z * 16 + 16;
+	int left, right, top, bottom, unused;
+	it.getDrawPosition(mc::BlockPos(x1, z1, 0), left, unused);
+	it.getDrawPosition(mc::BlockPos(x2, z2, 0), right, unused);
+	it.getDrawPosition(mc::BlockPos(x2, z1, mc::CHUNK_HEIGHT * 16 - 1), unused, top);
+	it.getDrawPosition(mc::BlockPos(x1, z2, 0), unused, bottom);
+	region = TileRegion(left, top, right - left + block_size, bottom - top + block_size);
+	return true;
+}
+
+void IsometricTileRenderer::renderTileBlocks(const TilePos& tile_pos, RGBAImage& tile,
+		const std::vector<TileRegion>* regions) {
+	int block_size = images->getBlockSize();
 
 	// get the maximum count of water blocks
 	// blitted about each over, until they are nearly opaque
@@ -161,6 +198,12 @@ void IsometricTileRenderer::renderTile(const TilePos& tile_pos, RGBAImage& tile)
 	// we treat the tile position as tile_pos, but it's actually tile_pos+tile_offset
 	for (TileTopBlockIterator it(tile_pos, block_size, tile_width);
 			!it.end(); it.next()) {
+		// all blocks of this row are drawn to the same position,
+		// skip the rows which are not drawn to the regions to render
+		if (regions != nullptr && !intersectsRegions(*regions, it.draw_x, it.draw_y,
+				block_size, block_size))
+			continue;
+
 		// water render behavior n1:
 		// are we already in a row of water?
 		bool in_water = false;
@@ -273,7 +316,10 @@ void IsometricTileRenderer::renderTile(const TilePos& tile_pos, RGBAImage& tile)
 								top.image = images->getBlock(id, data, extra_data);
 
 								// don't forget the render mode
-								render_mode->draw(top.image, top.pos, id, data);
+								{
+									util::ProfileTimer timer(util::ProfileStage::RENDER_MODE_DRAW);
+									render_mode->draw(top.image, top.pos, id, data);
+								}
 
 								row_nodes.insert(top);
 								break;
@@ -299,7 +345,7 @@ void IsometricTileRenderer::renderTile(const TilePos& tile_pos, RGBAImage& tile)
 
 			// check for biome data
 			if (Biome::isBiomeBlock(id, data))
-				image = images->getBiomeBlock(id, data, getBiomeOfBlock(block.current, current_chunk), extra_data);
+				image = getBiomeBlock(id, data, getBiomeOfBlock(block.current, current_chunk), extra_data);
 			else
 				image = images->getBlock(id, data, extra_data);
 
@@ -312,7 +358,10 @@ void IsometricTileRenderer::renderTile(const TilePos& tile_pos, RGBAImage& tile)
 			node.data = data;
 
 			// let the render mode do their magic with the block image
-			render_mode->draw(node.image, node.pos, id, data);
+			{
+				util::ProfileTimer timer(util::ProfileStage::RENDER_MODE_DRAW);
+				render_mode->draw(node.image, node.pos, id, data);
+			}
 
 			// insert into current row
 			row_nodes.insert(node);
@@ -340,14 +389,25 @@ void IsometricTileRenderer::renderTile(const TilePos& tile_pos, RGBAImage& tile)
 	}
 
 	// now blit all blocks
-	for (std::set<RenderBlock>::const_iterator it = blocks.begin(); it != blocks.end();
-			++it) {
-		tile.alphaBlit(it->image, it->x, it->y);
+	util::ProfileTimer timer(util::ProfileStage::BLIT);
+	if (regions == nullptr) {
+		for (std::set<RenderBlock>::const_iterator it = blocks.begin(); it != blocks.end();
+				++it) {
+			tile.alphaBlit(it->image, it->x, it->y);
+		}
+		return;
 	}
-}
 
-int IsometricTileRenderer::getTileSize() const {
-	return images->getBlockSize() * 16 * tile_width;
+	// or draw every region again from scratch with the blocks drawn to it
+	for (auto region = regions->begin(); region != regions->end(); ++region) {
+		RGBAImage part(region->width, region->height);
+		for (std::set<RenderBlock>::const_iterator it = blocks.begin(); it != blocks.end();
+				++it) {
+			if (region->intersects(it->x, it->y, it->image.getWidth(), it->image.getHeight()))
+				part.alphaBlit(it->image, it->x - region->x, it->y - region->y);
+		}
+		tile.simpleBlit(part, region->x, region->y);
+	}
 }
 
 }
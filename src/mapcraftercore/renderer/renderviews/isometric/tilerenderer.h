@@ -48,6 +48,11 @@ public:
 	void next();
 	bool end() const;
 
+	/**
+	 * Calculates the position a block is drawn to on the tile.
+	 */
+	void getDrawPosition(const mc::BlockPos& block, int& draw_x, int& draw_y) const;
+
 	mc::BlockPos current;
 	int draw_x, draw_y;
 };
@@ -92,8 +97,21 @@ public:
 	virtual ~IsometricTileRenderer();
 
 	virtual void renderTile(const TilePos& tile_pos, RGBAImage& tile);
+	virtual void renderTileRegions(const TilePos& tile_pos,
+			const std::vector<TileRegion>& regions, RGBAImage& tile);
 
 	virtual int getTileSize() const;
+
+protected:
+	virtual bool getChunkRegion(const TilePos& tile_pos, const mc::ChunkPos& chunk,
+			TileRegion& region) const;
+
+	/**
+	 * Renders the blocks of a tile. If regions are specified, only the blocks drawn to
+	 * these regions are rendered and only the regions of the tile are updated.
+	 */
+	void renderTileBlocks(const TilePos& tile_pos, RGBAImage& tile,
+			const std::vector<TileRegion>* regions);
 };
 
 }
@@ -1033,8 +1033,9 @@ RGBAImage TopdownBlockImages::createUnknownBlock() const {
 }
 
 RGBAImage TopdownBlockImages::createBiomeBlock(uint16_t id, uint16_t data,
-		const Biome& biome) const {if (!block_images.count(id | (data << 16)))
-			return unknown_block;
+		const Biome& biome) const {
+	if (!hasBlock(id, data))
+		return unknown_block;
 	uint32_t color;
 	// leaves have the foliage colors
 	// for birches, the color x/y coordinate is flipped
@@ -1067,7 +1068,7 @@ RGBAImage TopdownBlockImages::createBiomeBlock(uint16_t id, uint16_t data,
 	}
 	*/
 
-	return block_images.at(id | (data << 16)).colorize(r, g, b);
+	return getBlockImage(id, data).colorize(r, g, b);
 }
 
 void TopdownBlockImages::createBlocks() {
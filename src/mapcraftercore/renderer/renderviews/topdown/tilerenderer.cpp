@@ -28,7 +28,6 @@
 #include "../../../mc/worldcache.h"
 #include "../../../util.h"
 
-#include <deque>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -48,43 +47,38 @@ TopdownTileRenderer::TopdownTileRenderer(const RenderView* render_view,
 TopdownTileRenderer::~TopdownTileRenderer() {
 }
 
-namespace {
-
-struct RenderBlock {
-	RGBAImage block;
-	uint16_t id, data;
-	mc::BlockPos pos;
-};
-
-}
-
-void TopdownTileRenderer::renderChunk(const mc::Chunk& chunk, RGBAImage& tile, int dx, int dy) {
+void TopdownTileRenderer::renderChunk(const mc::Chunk& chunk, RGBAImage& tile, int dx, int dy,
+		const std::vector<TileRegion>* regions) {
 	// TODO implement preblit water render behavior
 
 	int texture_size = images->getTextureSize();
 
 	for (int x = 0; x < 16; x++) {
 		for (int z = 0; z < 16; z++) {
-			std::deque<RenderBlock> blocks;
+			if (regions != nullptr && !intersectsRegions(*regions,
+					dx + x*texture_size, dy + z*texture_size, texture_size, texture_size))
+				continue;
+
+			// the blocks of this column are the first count elements of column_blocks,
+			// starting with the element first
+			size_t first = 0, count = 0;
 
 			// TODO make this water thing a bit nicer
 			bool in_water = false;
 			int water = 0;
 
+			// start at the highest block of the column, there might be only
+			// hidden blocks though
 			mc::LocalBlockPos localpos(x, z, 0);
-			//int height = chunk.getHeightAt(localpos);
-			//localpos.y = height;
-			localpos.y = -1;
-			if (localpos.y >= mc::CHUNK_HEIGHT*16 || localpos.y < 0)
-				localpos.y = mc::CHUNK_HEIGHT*16 - 1;
+			localpos.y = chunk.getHeightAt(localpos);
+			if (localpos.y < 0)
+				continue;
 
 			uint16_t id = chunk.getBlockID(localpos);
 			while (id == 0 && localpos.y > 0) {
 				localpos.y--;
 				id = chunk.getBlockID(localpos);
 			}
-			if (localpos.y < 0)
-				continue;
 
 			while (localpos.y >= 0) {
 				mc::BlockPos globalpos = localpos.toGlobalPos(chunk.getPos());
@@ -121,22 +115,18 @@ void TopdownTileRenderer::renderChunk(const mc::Chunk& chunk, RGBAImage& tile, i
 					else {
 						water++;
 						if (water > images->getMaxWaterPreblit()) {
-							auto it = blocks.begin();
-							while (it != blocks.end()) {
-								auto current = it++;
-								if (it == blocks.end() || (it->id != 8 && it->id != 9)) {
-									RenderBlock& top = *current;
-									// blocks.erase(current);
-
-									top.id = 8;
-									top.data = OPAQUE_WATER;
-									top.block = images->getBlock(top.id, top.data);
-									render_mode->draw(top.block, top.pos, top.id, top.data);
-									// blocks.insert(current, top);
-									break;
-								} else {
-									blocks.erase(current);
-								}
+							// drop the blocks above the last block followed by water,
+							// and draw that one as opaque water
+							while (first + 1 < count && (column_blocks[first + 1].id == 8
+									|| column_blocks[first + 1].id == 9))
+								first++;
+							if (first < count) {
+								RenderBlock& top = column_blocks[first];
+								top.id = 8;
+								top.data = OPAQUE_WATER;
+								top.block = images->getBlock(top.id, top.data);
+								util::ProfileTimer timer(util::ProfileStage::RENDER_MODE_DRAW);
+								render_mode->draw(top.block, top.pos, top.id, top.data);
 							}
 							break;
 						}
@@ -145,31 +135,34 @@ void TopdownTileRenderer::renderChunk(const mc::Chunk& chunk, RGBAImage& tile, i
 
 				data = checkNeighbors(globalpos, id, data);
 
-				RGBAImage block;
+				if (count == column_blocks.size())
+					column_blocks.resize(count + 1);
+				RenderBlock& render_block = column_blocks[count++];
+				// assigning the block image to the image of the reused element copies
+				// only the pixels, its memory is already allocated
 				if (Biome::isBiomeBlock(id, data)) {
-					block = images->getBiomeBlock(id, data, getBiomeOfBlock(globalpos, &chunk), extra_data);
+					render_block.block = getBiomeBlock(id, data,
+							getBiomeOfBlock(globalpos, &chunk), extra_data);
 				} else {
-					block = images->getBlock(id, data, extra_data);
+					render_block.block = images->getBlock(id, data, extra_data);
 				}
 
-				render_mode->draw(block, globalpos, id, data);
-				RenderBlock render_block;
-				render_block.block = block;
+				{
+					util::ProfileTimer timer(util::ProfileStage::RENDER_MODE_DRAW);
+					render_mode->draw(render_block.block, globalpos, id, data);
+				}
 				render_block.id = id;
 				render_block.data = data;
 				render_block.pos = globalpos;
-				blocks.push_back(render_block);
 
 				if (!images->isBlockTransparent(id, data))
 					break;
 				localpos.y--;
 			}
 
-			while (blocks.size() > 0) {
-				RenderBlock render_block = blocks.back();
-				tile.alphaBlit(render_block.block, dx + x*texture_size, dy + z*texture_size);
-				blocks.pop_back();
-			}
+			util::ProfileTimer timer(util::ProfileStage::BLIT);
+			for (size_t i = count; i > first; i--)
+				tile.alphaBlit(column_blocks[i - 1].block, dx + x*texture_size, dy + z*texture_size);
 		}
 	}
 }
@@ -188,6 +181,39 @@ void TopdownTileRenderer::renderTile(const TilePos& tile_pos, RGBAImage& tile) {
 	}
 }
 
+void TopdownTileRenderer::renderTileRegions(const TilePos& tile_pos,
+		const std::vector<TileRegion>& regions, RGBAImage& tile) {
+	int texture_size = images->getTextureSize();
+	int chunk_size = texture_size * 16;
+
+	// every block is drawn only to its own square of the tile, and the regions
+	// contain only whole blocks, so the blocks in the regions can just be drawn again
+	for (auto it = regions.begin(); it != regions.end(); ++it)
+		tile.fill(0, it->x, it->y, it->width, it->height);
+
+	for (int x = 0; x < tile_width; x++) {
+		for (int z = 0; z < tile_width; z++) {
+			if (!intersectsRegions(regions, chunk_size*x, chunk_size*z, chunk_size, chunk_size))
+				continue;
+			mc::ChunkPos chunkpos(tile_pos.getX() * tile_width + x, tile_pos.getY() * tile_width + z);
+			current_chunk = world->getChunk(chunkpos);
+			if (current_chunk != nullptr)
+				renderChunk(*current_chunk, tile, chunk_size*x, chunk_size*z, &regions);
+		}
+	}
+}
+
+bool TopdownTileRenderer::getChunkRegion(const TilePos& tile_pos,
+		const mc::ChunkPos& chunk, TileRegion& region) const {
+	// the blocks of the chunk and the blocks around it
+	int texture_size = images->getTextureSize();
+	int block_x = (chunk.x - tile_pos.getX() * tile_width) * 16 - 1;
+	int block_z = (chunk.z - tile_pos.getY() * tile_width) * 16 - 1;
+	region = TileRegion(block_x * texture_size, block_z * texture_size,
+			18 * texture_size, 18 * texture_size);
+	return true;
+}
+
 int TopdownTileRenderer::getTileSize() const {
 	return images->getBlockSize() * 16 * tile_width;
 }
@@ -20,8 +20,10 @@
 #ifndef TOPDOWN_TILERENDERER_H_
 #define TOPDOWN_TILERENDERER_H_
 
+#include "../../image.h"
 #include "../../tilerenderer.h"
 
+#include <vector>
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
@@ -35,10 +37,32 @@ public:
 			int tile_width, mc::WorldCache* world, RenderMode* render_mode);
 	~TopdownTileRenderer();
 
-	void renderChunk(const mc::Chunk& chunk, RGBAImage& tile, int dx, int dy);
+	/**
+	 * Renders the blocks of a chunk to the tile. If regions are specified, only the
+	 * blocks drawn to these regions of the tile are rendered.
+	 */
+	void renderChunk(const mc::Chunk& chunk, RGBAImage& tile, int dx, int dy,
+			const std::vector<TileRegion>* regions = nullptr);
 	virtual void renderTile(const TilePos& tile_pos, RGBAImage& tile);
+	virtual void renderTileRegions(const TilePos& tile_pos,
+			const std::vector<TileRegion>& regions, RGBAImage& tile);
 
 	virtual int getTileSize() const;
+
+protected:
+	virtual bool getChunkRegion(const TilePos& tile_pos, const mc::ChunkPos& chunk,
+			TileRegion& region) const;
+
+private:
+	struct RenderBlock {
+		RGBAImage block;
+		uint16_t id, data;
+		mc::BlockPos pos;
+	};
+
+	// the blocks of the column which is currently rendered, from top to bottom,
+	// the elements (and their images) are reused for every column
+	std::vector<RenderBlock> column_blocks;
 };
 
 }
@@ -27,14 +27,107 @@
 #include "../mc/pos.h"
 #include "../util.h"
 
+#include <algorithm>
+
 namespace mapcrafter {
 namespace renderer {
 
+namespace {
+
+// the biome grids are cached for 8x8 chunks
+const int BIOME_GRID_BITS = 3;
+const int BIOME_GRID_WIDTH = 1 << BIOME_GRID_BITS;
+const int BIOME_GRID_SIZE = BIOME_GRID_WIDTH * BIOME_GRID_WIDTH;
+const int BIOME_GRID_MASK = BIOME_GRID_SIZE - 1;
+
+// maximum count of cached biome block images
+const size_t MAX_BIOME_BLOCKS = 1024;
+
+// biome color key for the biome blocks of not averaged biomes,
+// they are precalculated by the block images
+const uint64_t PRESET_BIOME_KEY = (uint64_t) 1 << 63;
+
+}
+
+TileRegion::TileRegion(int x, int y, int width, int height)
+	: x(x), y(y), width(width), height(height) {
+}
+
+bool TileRegion::empty() const {
+	return width <= 0 || height <= 0;
+}
+
+bool TileRegion::intersects(int x, int y, int width, int height) const {
+	return x < this->x + this->width && this->x < x + width
+			&& y < this->y + this->height && this->y < y + height;
+}
+
+bool intersectsRegions(const std::vector<TileRegion>& regions, int x, int y,
+		int width, int height) {
+	for (auto it = regions.begin(); it != regions.end(); ++it)
+		if (it->intersects(x, y, width, height))
+			return true;
+	return false;
+}
+
+BlockNeighborhood::BlockNeighborhood(mc::WorldCache* world, const mc::Chunk* chunk,
+		const mc::BlockPos& pos)
+	: world(world), pos(pos), local(pos), chunks_loaded(0), blocks_loaded(0) {
+	inner = local.x > 0 && local.x < 15 && local.z > 0 && local.z < 15;
+	// the chunk of the center block is usually the current chunk of the tile renderer
+	if (chunk != nullptr && chunk->getPos() == mc::ChunkPos(pos)) {
+		chunks[1][1] = chunk;
+		chunks_loaded |= 1 << 4;
+	}
+}
+
+mc::Block BlockNeighborhood::get(int dx, int dz, int dy) {
+	int index = ((dy + 1) * 3 + (dz + 1)) * 3 + (dx + 1);
+	if (!(blocks_loaded & (1 << index))) {
+		blocks_loaded |= 1 << index;
+		ids[index] = datas[index] = 0;
+
+		// like the world cache, return air below the world
+		int y = pos.y + dy;
+		const mc::Chunk* chunk = nullptr;
+		if (y >= 0)
+			chunk = inner ? getChunk(0, 0) : getChunk(dx, dz);
+		if (chunk != nullptr) {
+			mc::LocalBlockPos other = local;
+			other.x = (other.x + dx + 16) % 16;
+			other.z = (other.z + dz + 16) % 16;
+			other.y = y;
+			ids[index] = chunk->getBlockID(other);
+			datas[index] = chunk->getBlockData(other);
+		}
+	}
+	return mc::Block(pos + mc::BlockPos(dx, dz, dy), ids[index], datas[index]);
+}
+
+mc::Block BlockNeighborhood::get(const mc::BlockPos& dir) {
+	return get(dir.x, dir.z, dir.y);
+}
+
+const mc::Chunk* BlockNeighborhood::getChunk(int dx, int dz) {
+	// offset of the chunk of the block
+	int cx = local.x + dx < 0 ? 0 : (local.x + dx > 15 ? 2 : 1);
+	int cz = local.z + dz < 0 ? 0 : (local.z + dz > 15 ? 2 : 1);
+	int index = cz * 3 + cx;
+	if (!(chunks_loaded & (1 << index))) {
+		chunks_loaded |= 1 << index;
+		mc::ChunkPos chunk_pos(pos);
+		chunk_pos.x += cx - 1;
+		chunk_pos.z += cz - 1;
+		chunks[cz][cx] = world->getChunk(chunk_pos);
+	}
+	return chunks[cz][cx];
+}
+
 TileRenderer::TileRenderer(const RenderView* render_view, BlockImages* images,
 		int tile_width, mc::WorldCache* world, RenderMode* render_mode)
 	: images(images), tile_width(tile_width), world(world), current_chunk(nullptr),
 	  render_mode(render_mode),
-	  render_biomes(true), use_preblit_water(false) {
+	  render_biomes(true), use_preblit_water(false), biome_grids(BIOME_GRID_SIZE) {
 	render_mode->initialize(render_view, images, world, &current_chunk);
 }
 
@@ -49,6 +142,48 @@ void TileRenderer::setUsePreblitWater(bool use_preblit_water) {
 	this->use_preblit_water = use_preblit_water;
 }
 
+bool TileRenderer::getChangedRegions(const TilePos& tile_pos,
+		const std::vector<mc::ChunkPos>& chunks, std::vector<TileRegion>& regions) {
+	regions.clear();
+	int size = getTileSize();
+	int64_t area = 0;
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		TileRegion region;
+		if (!getChunkRegion(tile_pos, *it, region))
+			return false;
+
+		// clip the region to the tile
+		int x1 = std::min(region.x + region.width, size);
+		int y1 = std::min(region.y + region.height, size);
+		region.x = std::max(region.x, 0);
+		region.y = std::max(region.y, 0);
+		region.width = x1 - region.x;
+		region.height = y1 - region.y;
+		if (region.empty())
+			continue;
+
+		regions.push_back(region);
+		area += (int64_t) region.width * region.height;
+	}
+
+	// reading the previous image and rendering the regions separately isn't worth it
+	// if they cover more than half of the tile (overlapping regions are counted twice)
+	return area * 2 <= (int64_t) size * size;
+}
+
+void TileRenderer::renderTileRegions(const TilePos& tile_pos,
+		const std::vector<TileRegion>& regions, RGBAImage& tile) {
+	RGBAImage rendered;
+	renderTile(tile_pos, rendered);
+	for (auto it = regions.begin(); it != regions.end(); ++it)
+		tile.simpleBlit(rendered.clip(it->x, it->y, it->width, it->height), it->x, it->y);
+}
+
+bool TileRenderer::getChunkRegion(const TilePos& tile_pos, const mc::ChunkPos& chunk,
+		TileRegion& region) const {
+	return false;
+}
+
 mc::Block TileRenderer::getBlock(const mc::BlockPos& pos, int get) {
 	return world->getBlock(pos, current_chunk, get);
 }
@@ -57,33 +192,79 @@ Biome TileRenderer::getBiomeOfBlock(const mc::BlockPos& pos, const mc::Chunk* ch
 	// return default biome if we don't want to render different biomes
 	if (!render_biomes)
 		return getBiome(DEFAULT_BIOME);
-	uint8_t biome_id = chunk->getBiomeAt(mc::LocalBlockPos(pos));
-	Biome biome = getBiome(biome_id);
-	int count = 1;
-
-	// get average biome data to make smooth edges between
-	// different biomes
-	for (int dx = -1; dx <= 1; dx++)
-		for (int dz = -1; dz <= 1; dz++) {
-			if (dx == 0 && dz == 0)
-				continue;
-
-			mc::BlockPos other = pos + mc::BlockPos(dx, dz, 0);
-			mc::ChunkPos chunk_pos(other);
-			uint8_t other_id = chunk->getBiomeAt(mc::LocalBlockPos(other));
-			if (chunk_pos != chunk->getPos()) {
-				mc::Chunk* other_chunk = world->getChunk(chunk_pos);
-				if (other_chunk == nullptr)
-					continue;
-				other_id = other_chunk->getBiomeAt(mc::LocalBlockPos(other));
-			}
+	mc::LocalBlockPos local(pos);
+	return getBiomeGrid(chunk)[local.z * 16 + local.x];
+}
+
+const RGBAImage& TileRenderer::getBiomeBlock(uint16_t id, uint16_t data,
+		const Biome& biome, uint16_t extra_data) {
+	// the precalculated biome blocks might have a slightly different color than
+	// averaged biomes with the same color key, so they get their own key
+	uint64_t color_key = biome.getColorKey();
+	if (biome == getBiome(biome.getID()))
+		color_key = PRESET_BIOME_KEY | biome.getID();
+	BiomeBlockKey key(id | (uint32_t) data << 16, color_key);
+
+	auto it = biome_blocks.find(key);
+	if (it != biome_blocks.end())
+		return it->second;
+	if (biome_blocks.size() >= MAX_BIOME_BLOCKS)
+		biome_blocks.clear();
+	RGBAImage& image = biome_blocks[key];
+	image = images->getBiomeBlock(id, data, biome, extra_data);
+	return image;
+}
 
-			biome += getBiome(other_id);
-			count++;
+const TileRenderer::BiomeGrid& TileRenderer::getBiomeGrid(const mc::Chunk* chunk) {
+	const mc::ChunkPos& chunk_pos = chunk->getPos();
+	int index = (((chunk_pos.x + 131072) & BIOME_GRID_MASK) * BIOME_GRID_WIDTH
+			+ (chunk_pos.z + 131072)) & BIOME_GRID_MASK;
+	mc::CacheEntry<mc::ChunkPos, BiomeGrid>& entry = biome_grids[index];
+	if (entry.used && entry.key == chunk_pos)
+		return entry.value;
+
+	// the neighbor chunks, only loaded if needed
+	const mc::Chunk* chunks[3][3];
+	bool loaded[3][3] = {};
+	chunks[1][1] = chunk;
+	loaded[1][1] = true;
+
+	for (int z = 0; z < 16; z++)
+		for (int x = 0; x < 16; x++) {
+			mc::BlockPos pos = mc::LocalBlockPos(x, z, 0).toGlobalPos(chunk_pos);
+			uint8_t biome_id = chunk->getBiomeAt(mc::LocalBlockPos(x, z, 0));
+			Biome biome = getBiome(biome_id);
+			int count = 1;
+
+			// get average biome data to make smooth edges between
+			// different biomes
+			for (int dx = -1; dx <= 1; dx++)
+				for (int dz = -1; dz <= 1; dz++) {
+					if (dx == 0 && dz == 0)
+						continue;
+
+					mc::BlockPos other = pos + mc::BlockPos(dx, dz, 0);
+					mc::ChunkPos other_pos(other);
+					int cx = other_pos.x - chunk_pos.x + 1;
+					int cz = other_pos.z - chunk_pos.z + 1;
+					if (!loaded[cx][cz]) {
+						chunks[cx][cz] = world->getChunk(other_pos);
+						loaded[cx][cz] = true;
+					}
+					if (chunks[cx][cz] == nullptr)
+						continue;
+
+					biome += getBiome(chunks[cx][cz]->getBiomeAt(mc::LocalBlockPos(other)));
+					count++;
+				}
+
+			biome /= count;
+			entry.value[z * 16 + x] = biome;
 		}
 
-	biome /= count;
-	return biome;
+	entry.key = chunk_pos;
+	entry.used = true;
+	return entry.value;
 }
 
 /**
@@ -123,19 +304,21 @@ uint16_t getDoorDirectionClosed(uint16_t direction, bool flip) {
  * Checks for a specific block the neighbors and sets extra block data if necessary.
  */
 uint16_t TileRenderer::checkNeighbors(const mc::BlockPos& pos, uint16_t id, uint16_t data) {
+	util::ProfileTimer timer(util::ProfileStage::CHECK_NEIGHBORS);
 	mc::Block block(pos, id, data);
 	mc::Block north, south, east, west, top, bottom;
+	BlockNeighborhood neighbors(world, current_chunk, pos);
 
 	if (id == 2) { // grass blocks
 		// check if snow is on top to use the snowy sides instead of grass
-		top = getBlock(pos + mc::DIR_TOP);
+		top = neighbors.get(mc::DIR_TOP);
 		if (top.id == 78 || top.id == 80)
 			data |= GRASS_SNOW;
 
 	} else if (block.isFullWater()) { // full water blocks
-		west = getBlock(pos + mc::DIR_WEST);
-		south = getBlock(pos + mc::DIR_SOUTH);
-		top = getBlock(pos + mc::DIR_TOP);
+		west = neighbors.get(mc::DIR_WEST);
+		south = neighbors.get(mc::DIR_SOUTH);
+		top = neighbors.get(mc::DIR_TOP);
 
 		// check if the neighbors on visible faces (top, west, south) are also full water blocks
 		// show water textures on these sides only if there is no water as neighbor too
@@ -220,15 +403,14 @@ uint16_t TileRenderer::checkNeighbors(const mc::BlockPos& pos, uint16_t id, uint
 		neigh[2] = neigh[6] = FIX_ROT(get_data(state, DATA, x-1, y, z));
 		neigh[3] = neigh[7] = FIX_ROT(get_data(state, DATA, x, y, z+1));
 		*/
-		int x = pos.x, y = pos.y, z = pos.z;
-		stairs[0] = stairs[4] = getBlock(mc::BlockPos(x+1, z, y)).isStairs();
-		stairs[1] = stairs[5] = getBlock(mc::BlockPos(x, z-1, y)).isStairs();
-		stairs[2] = stairs[6] = getBlock(mc::BlockPos(x-1, z, y)).isStairs();
-		stairs[3] = stairs[7] = getBlock(mc::BlockPos(x, z+1, y)).isStairs();
-		neigh[0] = neigh[4] = FIX_ROT(getBlock(mc::BlockPos(x+1, z, y)).data);
-		neigh[1] = neigh[5] = FIX_ROT(getBlock(mc::BlockPos(x, z-1, y)).data);
-		neigh[2] = neigh[6] = FIX_ROT(getBlock(mc::BlockPos(x-1, z, y)).data);
-		neigh[3] = neigh[7] = FIX_ROT(getBlock(mc::BlockPos(x, z+1, y)).data);
+		stairs[0] = stairs[4] = neighbors.get(1, 0, 0).isStairs();
+		stairs[1] = stairs[5] = neighbors.get(0, -1, 0).isStairs();
+		stairs[2] = stairs[6] = neighbors.get(-1, 0, 0).isStairs();
+		stairs[3] = stairs[7] = neighbors.get(0, 1, 0).isStairs();
+		neigh[0] = neigh[4] = FIX_ROT(neighbors.get(1, 0, 0).data);
+		neigh[1] = neigh[5] = FIX_ROT(neighbors.get(0, -1, 0).data);
+		neigh[2] = neigh[6] = FIX_ROT(neighbors.get(-1, 0, 0).data);
+		neigh[3] = neigh[7] = FIX_ROT(neighbors.get(0, 1, 0).data);
 
 		#undef FIX_ROT
 
@@ -272,10 +454,10 @@ uint16_t TileRenderer::checkNeighbors(const mc::BlockPos& pos, uint16_t id, uint
 		data = ancilData;
 	} else if (id == 54 || id == 130 || id == 146) { // chests
 		// at first get all neighbor blocks
-		north = getBlock(pos + mc::DIR_NORTH);
-		south = getBlock(pos + mc::DIR_SOUTH);
-		east = getBlock(pos + mc::DIR_EAST);
-		west = getBlock(pos + mc::DIR_WEST);
+		north = neighbors.get(mc::DIR_NORTH);
+		south = neighbors.get(mc::DIR_SOUTH);
+		east = neighbors.get(mc::DIR_EAST);
+		west = neighbors.get(mc::DIR_WEST);
 
 		// determine the direction of the chest
 		if (data == 2)
@@ -300,53 +482,53 @@ uint16_t TileRenderer::checkNeighbors(const mc::BlockPos& pos, uint16_t id, uint
 		}
 	} else if (id == 55 || id == 132) { // redstone wire, tripwire
 		// check if the redstone wire is connected to other redstone wires
-		if (getBlock(pos + mc::DIR_NORTH).id == id
-				|| getBlock(pos + mc::DIR_NORTH + mc::DIR_BOTTOM).id == id)
+		if (neighbors.get(mc::DIR_NORTH).id == id
+				|| neighbors.get(mc::DIR_NORTH + mc::DIR_BOTTOM).id == id)
 			data |= REDSTONE_NORTH;
-		else if (getBlock(pos + mc::DIR_TOP + mc::DIR_NORTH).id == id)
+		else if (neighbors.get(mc::DIR_TOP + mc::DIR_NORTH).id == id)
 			data |= REDSTONE_NORTH | REDSTONE_TOPNORTH;
 
-		if (getBlock(pos + mc::DIR_SOUTH).id == id
-				|| getBlock(pos + mc::DIR_SOUTH + mc::DIR_BOTTOM).id == id)
+		if (neighbors.get(mc::DIR_SOUTH).id == id
+				|| neighbors.get(mc::DIR_SOUTH + mc::DIR_BOTTOM).id == id)
 			data |= REDSTONE_SOUTH;
-		else if (getBlock(pos + mc::DIR_TOP + mc::DIR_SOUTH).id == id)
+		else if (neighbors.get(mc::DIR_TOP + mc::DIR_SOUTH).id == id)
 			data |= REDSTONE_SOUTH | REDSTONE_TOPSOUTH;
 
-		if (getBlock(pos + mc::DIR_EAST).id == id
-				|| getBlock(pos + mc::DIR_EAST + mc::DIR_BOTTOM).id == id)
+		if (neighbors.get(mc::DIR_EAST).id == id
+				|| neighbors.get(mc::DIR_EAST + mc::DIR_BOTTOM).id == id)
 			data |= REDSTONE_EAST;
-		else if (getBlock(pos + mc::DIR_TOP + mc::DIR_EAST).id == id)
+		else if (neighbors.get(mc::DIR_TOP + mc::DIR_EAST).id == id)
 			data |= REDSTONE_EAST | REDSTONE_TOPEAST;
 
-		if (getBlock(pos + mc::DIR_WEST).id == id
-				|| getBlock(pos + mc::DIR_WEST + mc::DIR_BOTTOM).id == id)
+		if (neighbors.get(mc::DIR_WEST).id == id
+				|| neighbors.get(mc::DIR_WEST + mc::DIR_BOTTOM).id == id)
 			data |= REDSTONE_WEST;
-		else if (getBlock(pos + mc::DIR_TOP + mc::DIR_WEST).id == id)
+		else if (neighbors.get(mc::DIR_TOP + mc::DIR_WEST).id == id)
 			data |= REDSTONE_WEST | REDSTONE_TOPWEST;
 
 		if (id == 132) {
-			if (getBlock(pos + mc::DIR_NORTH).id == 131
-					|| getBlock(pos + mc::DIR_NORTH + mc::DIR_BOTTOM).id == 131)
+			if (neighbors.get(mc::DIR_NORTH).id == 131
+					|| neighbors.get(mc::DIR_NORTH + mc::DIR_BOTTOM).id == 131)
 				data |= REDSTONE_NORTH;
-			else if (getBlock(pos + mc::DIR_TOP + mc::DIR_NORTH).id == 131)
+			else if (neighbors.get(mc::DIR_TOP + mc::DIR_NORTH).id == 131)
 				data |= REDSTONE_NORTH | REDSTONE_TOPNORTH;
 
-			if (getBlock(pos + mc::DIR_SOUTH).id == 131
-					|| getBlock(pos + mc::DIR_SOUTH + mc::DIR_BOTTOM).id == 131)
+			if (neighbors.get(mc::DIR_SOUTH).id == 131
+					|| neighbors.get(mc::DIR_SOUTH + mc::DIR_BOTTOM).id == 131)
 				data |= REDSTONE_SOUTH;
-			else if (getBlock(pos + mc::DIR_TOP + mc::DIR_SOUTH).id == 131)
+			else if (neighbors.get(mc::DIR_TOP + mc::DIR_SOUTH).id == 131)
 				data |= REDSTONE_SOUTH | REDSTONE_TOPSOUTH;
 
-			if (getBlock(pos + mc::DIR_EAST).id == 131
-					|| getBlock(pos + mc::DIR_EAST + mc::DIR_BOTTOM).id == 131)
+			if (neighbors.get(mc::DIR_EAST).id == 131
+					|| neighbors.get(mc::DIR_EAST + mc::DIR_BOTTOM).id == 131)
 				data |= REDSTONE_EAST;
-			else if (getBlock(pos + mc::DIR_TOP + mc::DIR_EAST).id == 131)
+			else if (neighbors.get(mc::DIR_TOP + mc::DIR_EAST).id == 131)
 				data |= REDSTONE_EAST | REDSTONE_TOPEAST;
 
-			if (getBlock(pos + mc::DIR_WEST).id == 131
-					|| getBlock(pos + mc::DIR_WEST + mc::DIR_BOTTOM).id == 131)
+			if (neighbors.get(mc::DIR_WEST).id == 131
+					|| neighbors.get(mc::DIR_WEST + mc::DIR_BOTTOM).id == 131)
 				data |= REDSTONE_WEST;
-			else if (getBlock(pos + mc::DIR_TOP + mc::DIR_WEST).id == 131)
+			else if (neighbors.get(mc::DIR_TOP + mc::DIR_WEST).id == 131)
 				data |= REDSTONE_WEST | REDSTONE_TOPWEST;
 		}
 	} else if (id == 64 || id == 71 || (id >= 193 && id <= 197)) {
@@ -356,11 +538,11 @@ uint16_t TileRenderer::checkNeighbors(const mc::BlockPos& pos, uint16_t id, uint
 		// at first get the data of both parts of the door, top and bottom
 		if (top) {
 			top_data = data;
-			bottom_data = getBlock(pos + mc::DIR_BOTTOM).data;
+			bottom_data = neighbors.get(mc::DIR_BOTTOM).data;
 
 			data |= DOOR_TOP;
 		} else {
-			top_data = getBlock(pos + mc::DIR_TOP).data;
+			top_data = neighbors.get(mc::DIR_TOP).data;
 			bottom_data = data;
 		}
 
@@ -392,8 +574,8 @@ uint16_t TileRenderer::checkNeighbors(const mc::BlockPos& pos, uint16_t id, uint
 
 	} else if (id == 79 || id == 212) {
 		// ice blocks
-		west = getBlock(pos + mc::DIR_WEST);
-		south = getBlock(pos + mc::DIR_SOUTH);
+		west = neighbors.get(mc::DIR_WEST);
+		south = neighbors.get(mc::DIR_SOUTH);
 
 		// check if west and south neighbors are also ice blocks
 		if (west.id == 79 || west.id == 212)
@@ -405,10 +587,10 @@ uint16_t TileRenderer::checkNeighbors(const mc::BlockPos& pos, uint16_t id, uint
 			|| (id >= 188 && id <= 192)) {
 		// fence, iron bars, glass panes, cobblestone walls, nether fence,
 		// stained glass pane, special wood type fences
-		north = getBlock(pos + mc::DIR_NORTH);
-		south = getBlock(pos + mc::DIR_SOUTH);
-		east = getBlock(pos + mc::DIR_EAST);
-		west = getBlock(pos + mc::DIR_WEST);
+		north = neighbors.get(mc::DIR_NORTH);
+		south = neighbors.get(mc::DIR_SOUTH);
+		east = neighbors.get(mc::DIR_EAST);
+		west = neighbors.get(mc::DIR_WEST);
 
 		// check for same neighbors
 		if (north.id != 0 && (north.id == id
@@ -449,15 +631,15 @@ uint16_t TileRenderer::checkNeighbors(const mc::BlockPos& pos, uint16_t id, uint
 			// if this is the top part of a plant,
 			// get the flower type from the block below
 			// and add the special 'flower-top-part' bit
-			return getBlock(pos + mc::DIR_BOTTOM).data | LARGEPLANT_TOP;
+			return neighbors.get(mc::DIR_BOTTOM).data | LARGEPLANT_TOP;
 		}
 	}
 
 	if (!images->isBlockTransparent(id, data)) {
 		// add shadow edges on opaque blockes
-		north = getBlock(pos + mc::DIR_NORTH);
-		east = getBlock(pos + mc::DIR_EAST);
-		bottom = getBlock(pos + mc::DIR_BOTTOM);
+		north = neighbors.get(mc::DIR_NORTH);
+		east = neighbors.get(mc::DIR_EAST);
+		bottom = neighbors.get(mc::DIR_BOTTOM);
 
 		// check if neighbors are opaque
 		if (north.id == 0 || (images->isBlockTransparent(north.id, north.data) && !north.isStairs()))
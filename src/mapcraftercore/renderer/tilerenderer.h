@@ -21,8 +21,12 @@
 #define TILERENDERER_H_
 
 #include "biomes.h"
+#include "image.h"
 #include "../mc/worldcache.h" // mc::DIR_*
 
+#include <array>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <boost/filesystem.hpp>
 
@@ -34,6 +38,7 @@ namespace mapcrafter {
 namespace mc {
 class BlockPos;
 class Chunk;
+class ChunkPos;
 }
 
 namespace renderer {
@@ -44,6 +49,60 @@ class RenderMode;
 class RenderView;
 class RGBAImage;
 
+/**
+ * A rectangular region of pixels of a tile.
+ */
+struct TileRegion {
+	TileRegion(int x = 0, int y = 0, int width = 0, int height = 0);
+
+	bool empty() const;
+	bool intersects(int x, int y, int width, int height) const;
+
+	int x, y, width, height;
+};
+
+/**
+ * Returns whether a rectangle intersects at least one of some regions.
+ */
+bool intersectsRegions(const std::vector<TileRegion>& regions, int x, int y,
+		int width, int height);
+
+/**
+ * The blocks around a block (3x3x3, including the block itself) with id and data. The
+ * chunks of the blocks are looked up only once and the blocks are read when they are
+ * needed first. If the block is not on the border of its chunk, all blocks are read
+ * directly from the chunk of the block.
+ */
+class BlockNeighborhood {
+public:
+	BlockNeighborhood(mc::WorldCache* world, const mc::Chunk* chunk,
+			const mc::BlockPos& pos);
+
+	/**
+	 * Returns a block relative to the center block (-1 <= dx, dz, dy <= 1).
+	 */
+	mc::Block get(int dx, int dz, int dy);
+	mc::Block get(const mc::BlockPos& dir);
+
+private:
+	const mc::Chunk* getChunk(int dx, int dz);
+
+	mc::WorldCache* world;
+	mc::BlockPos pos;
+	mc::LocalBlockPos local;
+	// whether all blocks are in the chunk of the center block
+	bool inner;
+
+	// the chunks around the chunk of the center block, only valid if loaded
+	const mc::Chunk* chunks[3][3];
+	uint16_t chunks_loaded;
+
+	// the blocks, only valid if loaded
+	uint16_t ids[27];
+	uint8_t datas[27];
+	uint32_t blocks_loaded;
+};
+
 class TileRenderer {
 public:
 	TileRenderer(const RenderView* render_view, BlockImages* images, int tile_width,
@@ -55,11 +114,46 @@ public:
 
 	virtual void renderTile(const TilePos& tile_pos, RGBAImage& tile) = 0;
 
+	/**
+	 * Calculates the regions of a tile which might look different because some chunks
+	 * changed. Returns false if that is not supported by the render view or if the
+	 * regions would cover so much of the tile that it's better to render the whole
+	 * tile again.
+	 */
+	bool getChangedRegions(const TilePos& tile_pos, const std::vector<mc::ChunkPos>& chunks,
+			std::vector<TileRegion>& regions);
+
+	/**
+	 * Renders only some regions of a tile, the tile image must contain the previous
+	 * image of the tile. The pixels outside of the regions are not touched.
+	 *
+	 * The default implementation renders the whole tile and copies the regions.
+	 */
+	virtual void renderTileRegions(const TilePos& tile_pos,
+			const std::vector<TileRegion>& regions, RGBAImage& tile);
+
 	virtual int getTileSize() const = 0;
 
 protected:
+	/**
+	 * Calculates the region of a tile the blocks of a chunk (and the blocks next to the
+	 * chunk, because blocks may look different depending on their neighbors) are drawn
+	 * to. The region is empty if the chunk is not drawn to the tile. Returns false if
+	 * this is not supported.
+	 */
+	virtual bool getChunkRegion(const TilePos& tile_pos, const mc::ChunkPos& chunk,
+			TileRegion& region) const;
+
 	mc::Block getBlock(const mc::BlockPos& pos, int get = mc::GET_ID | mc::GET_DATA);
 	Biome getBiomeOfBlock(const mc::BlockPos& pos, const mc::Chunk* chunk);
+
+	/**
+	 * Returns the image of a biome-dependent block. Blocks with the same biome colors
+	 * are created only once, the cache is cleared when it gets too big.
+	 */
+	const RGBAImage& getBiomeBlock(uint16_t id, uint16_t data, const Biome& biome,
+			uint16_t extra_data = 0);
+
 	uint16_t checkNeighbors(const mc::BlockPos& pos, uint16_t id, uint16_t data);
 
 	BlockImages* images;
@@ -70,6 +164,26 @@ protected:
 
 	bool render_biomes;
 	bool use_preblit_water;
+
+private:
+	typedef std::array<Biome, 16 * 16> BiomeGrid;
+	typedef std::pair<uint32_t, uint64_t> BiomeBlockKey;
+
+	struct BiomeBlockKeyHash {
+		size_t operator()(const BiomeBlockKey& key) const {
+			return std::hash<uint64_t>()(key.second * 31 + key.first);
+		}
+	};
+
+	/**
+	 * Returns the averaged biomes of all block columns of a chunk.
+	 */
+	const BiomeGrid& getBiomeGrid(const mc::Chunk* chunk);
+
+	// averaged biomes of recently used chunks, mapped like the chunks of the world cache
+	std::vector<mc::CacheEntry<mc::ChunkPos, BiomeGrid> > biome_grids;
+	// created biome blocks, key is (id | data << 16, biome color key)
+	std::unordered_map<BiomeBlockKey, RGBAImage, BiomeBlockKeyHash> biome_blocks;
 };
 
 }
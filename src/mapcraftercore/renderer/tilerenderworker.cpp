@@ -20,6 +20,7 @@
 #include "tilerenderworker.h"
 
 #include "blockimages.h"
+#include "fingerprints.h"
 #include "image.h"
 #include "rendermode.h"
 #include "renderview.h"
@@ -28,6 +29,10 @@
 #include "../mc/worldcache.h"
 #include "../util.h"
 
+#include <ctime>
+#include <fstream>
+#include <sstream>
+
 namespace mapcrafter {
 namespace renderer {
 
@@ -48,6 +53,8 @@ TileRenderWorker::~TileRenderWorker() {
 
 void TileRenderWorker::setRenderContext(const RenderContext& context) {
 	render_context = context;
+	if (render_context.world_cache)
+		chunk_stats = render_context.world_cache->getChunkCacheStats();
 }
 
 void TileRenderWorker::setRenderWork(const RenderWork& work) {
@@ -60,11 +67,11 @@ const RenderWorkResult& TileRenderWorker::getRenderWorkResult() const {
 	return render_work_result;
 }
 
-void TileRenderWorker::setProgressHandler(util::IProgressHandler* progress) {
+void TileRenderWorker::setProgressCounter(util::AtomicProgressCounter* progress) {
 	this->progress = progress;
 }
 
-void TileRenderWorker::saveTile(const TilePath& tile, const RGBAImage& image) {
+bool TileRenderWorker::saveTile(const TilePath& tile, const RGBAImage& image, bool force) {
 	bool png = render_context.map_config.getImageFormat() == config::ImageFormat::PNG;
 	bool png_indexed = render_context.map_config.isPNGIndexed();
 	std::string suffix = std::string(".") + render_context.map_config.getImageFormatSuffix();
@@ -72,45 +79,100 @@ void TileRenderWorker::saveTile(const TilePath& tile, const RGBAImage& image) {
 	if (tile.getDepth() == 0)
 		filename = std::string("base") + suffix;
 	fs::path file = render_context.output_dir / filename;
+
+	// no need to encode and write the image again if the pixels are the same
+	bool changed = true;
+	if (render_context.tile_fingerprints != nullptr)
+		changed = render_context.tile_fingerprints->update(tile,
+				TileFingerprints::compute(image));
+	if (!changed && !force && fs::exists(file)) {
+		// the modification time of the tile is used to check whether it is required if
+		// there are no chunk fingerprints, otherwise the unchanged file is not touched
+		const config::MapSection& map_config = render_context.map_config;
+		if (map_config.useImageModificationTimes() && !map_config.useChunkFingerprints()) {
+			boost::system::error_code ec;
+			fs::last_write_time(file, std::time(nullptr), ec);
+		}
+		return false;
+	}
+
 	if (!fs::exists(file.branch_path()))
 		fs::create_directories(file.branch_path());
 
-	if ((png && !png_indexed) && !image.writePNG(file.string()))
-		LOG(WARNING) << "Unable to write '" << file.string() << "'.";
+	// the image is encoded to memory first, so encoding and writing the file are
+	// measured separately
+	std::string data;
+	{
+		util::ProfileTimer timer(util::ProfileStage::ENCODE);
+		std::ostringstream out(std::ios::binary);
+		config::Color bg = render_context.background_color;
+		bool encoded;
+		if (png && !png_indexed)
+			encoded = image.writePNG(out);
+		else if (png && png_indexed)
+			encoded = image.writeIndexedPNG(out);
+		else
+			encoded = image.writeJPEG(out, render_context.map_config.getJPEGQuality(),
+					rgba(bg.red, bg.green, bg.blue, 255));
+		if (!encoded) {
+			LOG(WARNING) << "Unable to encode '" << file.string() << "'.";
+			return changed;
+		}
+		data = out.str();
+	}
 
-	if ((png && png_indexed) && !image.writeIndexedPNG(file.string()))
-		LOG(WARNING) << "Unable to write '" << file.string() << "'.";
+	{
+		util::ProfileTimer timer(util::ProfileStage::WRITE);
+		std::ofstream out(file.string().c_str(), std::ios::binary);
+		out.write(data.data(), data.size());
+		out.close();
+		if (out.fail()) {
+			LOG(WARNING) << "Unable to write '" << file.string() << "'.";
+			return changed;
+		}
+	}
 
-	config::Color bg = render_context.background_color;
-	if (!png && !image.writeJPEG(file.string(),
-			render_context.map_config.getJPEGQuality(), rgba(bg.red, bg.green, bg.blue, 255)))
-		LOG(WARNING) << "Unable to write '" << file.string() << "'.";
+	if (render_context.metrics != nullptr)
+		render_context.metrics->bytes_written += data.size();
+	return changed;
 }
 
-void TileRenderWorker::renderRecursive(const TilePath& tile, RGBAImage& image) {
+bool TileRenderWorker::renderRecursive(const TilePath& tile, RGBAImage& image, bool force) {
 	// if this is tile is not required or we should skip it, try to load it from file
-	if (!render_context.tile_set->isTileRequired(tile)
-			|| render_work.tiles_skip.count(tile)) {
-		bool png = render_context.map_config.getImageFormat() == config::ImageFormat::PNG;
-		fs::path file = render_context.output_dir
-				/ (tile.toString() + "." + render_context.map_config.getImageFormatSuffix());
-		if ((png && image.readPNG(file.string()))
-				|| (!png && image.readJPEG(file.string()))) {
-			if (render_work.tiles_skip.count(tile) && progress != nullptr)
-				progress->setValue(progress->getValue()
-						+ render_context.tile_set->getContainingRenderTiles(tile));
-			return;
-		}
+	if (!force && (!render_context.tile_set->isTileRequired(tile)
+			|| render_work.tiles_skip.count(tile))) {
+		if (readTile(tile, image))
+			return render_work.tiles_changed.count(tile) > 0;
 
 		LOG(WARNING) << "Unable to read tile '" << tile.toString()
 				<< "', I will just render it again.";
+		force = true;
 	}
 
 	if (tile.getDepth() == render_context.tile_set->getDepth()) {
 		// this tile is a render tile, render it
-		render_context.tile_renderer->renderTile(tile.getTilePos()
-				+ render_context.tile_set->getTileOffset(), image);
+		// if only some chunks of it changed, re-render only the parts of the previous
+		// image affected by them (not with lossy/indexed images, they would degrade)
+		TilePos tile_pos = tile.getTilePos() + render_context.tile_set->getTileOffset();
+		int size = render_context.tile_renderer->getTileSize();
+		bool lossless = render_context.map_config.getImageFormat() == config::ImageFormat::PNG
+				&& !render_context.map_config.isPNGIndexed();
+		std::vector<mc::ChunkPos> chunks;
+		std::vector<TileRegion> regions;
+		if (!force && lossless && render_context.map_config.usePartialRendering()
+				&& render_context.tile_set->getChangedChunks(tile.getTilePos(), chunks)
+				&& render_context.tile_renderer->getChangedRegions(tile_pos, chunks, regions)
+				&& readTile(tile, image)
+				&& image.getWidth() == size && image.getHeight() == size) {
+			util::ProfileTimer timer(util::ProfileStage::ROW_WALK);
+			render_context.tile_renderer->renderTileRegions(tile_pos, regions, image);
+		} else {
+			image.clear();
+			util::ProfileTimer timer(util::ProfileStage::ROW_WALK);
+			render_context.tile_renderer->renderTile(tile_pos, image);
+		}
 		render_work_result.tiles_rendered++;
+		updateMetrics();
 
 		/*
 		// draws a border on the tile
@@ -125,80 +187,130 @@ void TileRenderWorker::renderRecursive(const TilePath& tile, RGBAImage& image) {
 		*/
 
 		// save it
-		saveTile(tile, image);
+		bool changed = saveTile(tile, image, force);
 
 		// update progress
 		if (progress != nullptr)
-			progress->setValue(progress->getValue() + 1);
-	} else {
-		// this tile is a composite tile, we need to compose it from its children
-		// just check, if children 1, 2, 3, 4 exists, render it, resize it to the half size
-		// and blit it to the properly position
-		//int size = render_context.map_config.getTextureSize() * 32 * TILE_WIDTH;
-		// TODO
-		int size = render_context.tile_renderer->getTileSize();
-		image.setSize(size, size);
+			progress->add(1);
+		return changed;
+	}
 
-		RGBAImage other;
-		RGBAImage resized;
-		if (render_context.tile_set->hasTile(tile + 1)) {
-			renderRecursive(tile + 1, other);
-			other.resize(resized, 0, 0, InterpolationType::HALF);
-			image.simpleAlphaBlit(resized, 0, 0);
-			other.clear();
-		}
-		if (render_context.tile_set->hasTile(tile + 2)) {
-			renderRecursive(tile + 2, other);
-			other.resize(resized, 0, 0, InterpolationType::HALF);
-			image.simpleAlphaBlit(resized, size / 2, 0);
-			other.clear();
-		}
-		if (render_context.tile_set->hasTile(tile + 3)) {
-			renderRecursive(tile + 3, other);
-			other.resize(resized, 0, 0, InterpolationType::HALF);
-			image.simpleAlphaBlit(resized, 0, size / 2);
-			other.clear();
+	// this tile is a composite tile, we need to compose it from its children
+	// just check, if children 1, 2, 3, 4 exists, render it, resize it to the half size
+	// and blit it to the properly position
+	//int size = render_context.map_config.getTextureSize() * 32 * TILE_WIDTH;
+	// TODO
+	int size = render_context.tile_renderer->getTileSize();
+	int offsets[4][2] = {{0, 0}, {size / 2, 0}, {0, size / 2}, {size / 2, size / 2}};
+
+	// the required children are rendered first, the other children are read from
+	// their files later, but only if the tile actually needs to be composed
+	bool changed = force || render_context.tile_fingerprints == nullptr;
+	std::vector<int> unchanged_children;
+	RGBAImage other;
+	RGBAImage resized;
+	for (int i = 1; i <= 4; i++) {
+		TilePath child = tile + i;
+		if (!render_context.tile_set->hasTile(child))
+			continue;
+		if (!render_context.tile_set->isTileRequired(child)
+				|| render_work.tiles_skip.count(child)) {
+			if (render_work.tiles_changed.count(child))
+				changed = true;
+			unchanged_children.push_back(i);
+			continue;
 		}
-		if (render_context.tile_set->hasTile(tile + 4)) {
-			renderRecursive(tile + 4, other);
-			other.resize(resized, 0, 0, InterpolationType::HALF);
-			image.simpleAlphaBlit(resized, size / 2, size / 2);
+
+		bool child_changed = renderRecursive(child, other);
+		changed = changed || child_changed;
+		if (other.getWidth() == 0) {
+			unchanged_children.push_back(i);
+			continue;
 		}
+		util::ProfileTimer timer(util::ProfileStage::COMPOSITE);
+		if (image.getWidth() == 0)
+			image.setSize(size, size);
+		other.resize(resized, 0, 0, InterpolationType::HALF);
+		image.simpleAlphaBlit(resized, offsets[i - 1][0], offsets[i - 1][1]);
+		other.clear();
+	}
 
-		/*
-		// draws a border on the tile
-		for (int x = 0; x < size; x++)
-			for (int y = 0; y < size; y++) {
-				if (x < 5 || x > size-5)
-					tile.setPixel(x, y, rgba(255, 0, 0, 255));
-				if (y < 5 || y > size-5)
-					tile.setPixel(x, y, rgba(255, 0, 0, 255));
-			}
-		*/
+	// nothing changed, the existing tile is still up to date
+	std::string suffix = std::string(".") + render_context.map_config.getImageFormatSuffix();
+	fs::path file = render_context.output_dir
+			/ (tile.getDepth() == 0 ? std::string("base") + suffix : tile.toString() + suffix);
+	if (!changed && fs::exists(file)) {
+		image.clear();
+		return false;
+	}
 
-		// then save the tile
-		saveTile(tile, image);
+	if (image.getWidth() == 0)
+		image.setSize(size, size);
+	for (auto it = unchanged_children.begin(); it != unchanged_children.end(); ++it) {
+		TilePath child = tile + *it;
+		if (!readTile(child, other)) {
+			LOG(WARNING) << "Unable to read tile '" << child.toString()
+					<< "', I will just render it again.";
+			renderRecursive(child, other, true);
+		}
+		util::ProfileTimer timer(util::ProfileStage::COMPOSITE);
+		other.resize(resized, 0, 0, InterpolationType::HALF);
+		image.simpleAlphaBlit(resized, offsets[*it - 1][0], offsets[*it - 1][1]);
+		other.clear();
 	}
+
+	/*
+	// draws a border on the tile
+	for (int x = 0; x < size; x++)
+		for (int y = 0; y < size; y++) {
+			if (x < 5 || x > size-5)
+				tile.setPixel(x, y, rgba(255, 0, 0, 255));
+			if (y < 5 || y > size-5)
+				tile.setPixel(x, y, rgba(255, 0, 0, 255));
+		}
+	*/
+
+	// then save the tile
+	return saveTile(tile, image, force);
 }
 
 void TileRenderWorker::operator()() {
-	int work = 0;
-	for (auto it = render_work.tiles.begin(); it != render_work.tiles.end(); ++it)
-		work += render_context.tile_set->getContainingRenderTiles(*it);
-	if (progress != nullptr) {
-		progress->setMax(work);
-		progress->setValue(0);
-	}
-	
+	bool profile = util::Profiler::isEnabled();
+	if (profile)
+		util::Profiler::setThreadCounters(&render_work_result.profile);
+	if (render_context.chunk_fingerprints != nullptr)
+		render_context.world_cache->setChunkHashes(&render_work_result.chunk_fingerprints);
+
 	RGBAImage image;
 	// iterate through the start composite tiles
 	for (auto it = render_work.tiles.begin(); it != render_work.tiles.end(); ++it) {
 		// render this composite tile
-		renderRecursive(*it, image);
+		if (renderRecursive(*it, image))
+			render_work_result.tiles_changed.insert(*it);
 
 		// clear image
 		image.clear();
 	}
+
+	if (profile)
+		util::Profiler::setThreadCounters(nullptr);
+	render_context.world_cache->setChunkHashes(nullptr);
+}
+
+void TileRenderWorker::updateMetrics() {
+	if (render_context.metrics == nullptr)
+		return;
+	const mc::CacheStats& stats = render_context.world_cache->getChunkCacheStats();
+	render_context.metrics->chunks_decoded += stats.misses - chunk_stats.misses;
+	render_context.metrics->chunk_cache_hits += stats.hits - chunk_stats.hits;
+	chunk_stats = stats;
+}
+
+bool TileRenderWorker::readTile(const TilePath& tile, RGBAImage& image) const {
+	bool png = render_context.map_config.getImageFormat() == config::ImageFormat::PNG;
+	fs::path file = render_context.output_dir
+			/ (tile.toString() + "." + render_context.map_config.getImageFormatSuffix());
+	return (png && image.readPNG(file.string())) || (!png && image.readJPEG(file.string()));
 }
 
 } /* namespace render */
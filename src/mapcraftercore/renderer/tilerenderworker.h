@@ -24,26 +24,27 @@
 #include "../config/configsections/map.h"
 #include "../config/configsections/world.h"
 #include "../mc/world.h"
+#include "../mc/worldcache.h"
 
+#include <map>
 #include <memory>
 #include <set>
+#include <vector>
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
 
 namespace mapcrafter {
 
-namespace mc {
-class WorldCache;
-}
-
 namespace renderer {
 
 class BlockImages;
+class ChunkFingerprints;
 class RenderMode;
 class RenderView;
 class RGBAImage;
 class TilePath;
+class TileFingerprints;
 class TileRenderer;
 class TileSet;
 
@@ -55,7 +56,21 @@ struct RenderContext {
 
 	RenderView* render_view;
 	BlockImages* block_images;
+	// optional copies of the block images for every NUMA node the render threads are
+	// placed on, render threads use the one of their node instead of block_images
+	std::vector<BlockImages*> node_block_images;
 	TileSet* tile_set;
+	// optional fingerprints of the tiles, tiles whose pixels did not change are not
+	// written again then
+	TileFingerprints* tile_fingerprints;
+	// optional fingerprints the dispatcher adds the fingerprints of all chunks loaded
+	// for rendering to (to have them for the next rendering without reading all chunks)
+	ChunkFingerprints* chunk_fingerprints;
+	// optional counters the dispatcher adds the profile counters of all render work
+	// to, the render threads measure only if profiling is enabled (see util::Profiler)
+	util::ProfileCounters* profile;
+	// optional counters of the rendering the render threads update while rendering
+	util::RenderMetrics* metrics;
 	mc::World world;
 
 	std::shared_ptr<mc::WorldCache> world_cache;
@@ -75,6 +90,8 @@ struct RenderContext {
 
 struct RenderWork {
 	std::set<renderer::TilePath> tiles, tiles_skip;
+	// tiles to skip whose pixels changed when they were rendered
+	std::set<renderer::TilePath> tiles_changed;
 };
 
 struct RenderWorkResult {
@@ -83,6 +100,12 @@ struct RenderWorkResult {
 	RenderWork render_work;
 
 	int tiles_rendered;
+	// tiles of the work whose pixels changed
+	std::set<renderer::TilePath> tiles_changed;
+	// time spent in the render stages while rendering the work (if profiling)
+	util::ProfileCounters profile;
+	// fingerprints of the chunks loaded while rendering the work (if wanted)
+	std::map<mc::ChunkPos, uint64_t> chunk_fingerprints;
 };
 
 class TileRenderWorker {
@@ -94,20 +117,43 @@ public:
 	void setRenderWork(const RenderWork& work);
 	const RenderWorkResult& getRenderWorkResult() const;
 
-	void setProgressHandler(util::IProgressHandler* progress);
+	/**
+	 * Sets a progress counter the count of rendered render tiles is added to.
+	 * The counter can be shared by multiple workers.
+	 */
+	void setProgressCounter(util::AtomicProgressCounter* progress);
+
+	/**
+	 * Saves a tile and returns whether its pixels changed. The image is not written
+	 * if it did not change and the tile file exists, except if forced.
+	 */
+	bool saveTile(const TilePath& tile, const RGBAImage& image, bool force = false);
 
-	void saveTile(const TilePath& tile, const RGBAImage& image);
-	void renderRecursive(const TilePath& path, RGBAImage& image);
+	/**
+	 * Renders a tile and returns whether its pixels changed. A composite tile is only
+	 * composed if one of its children changed (or if forced), the image is empty if
+	 * it is not composed.
+	 */
+	bool renderRecursive(const TilePath& path, RGBAImage& image, bool force = false);
 
 	void operator()();
 
 private:
+	bool readTile(const TilePath& tile, RGBAImage& image) const;
+
+	/**
+	 * Adds the chunk cache statistics since the last call to the render metrics.
+	 */
+	void updateMetrics();
+
 	RenderContext render_context;
 	RenderWork render_work;
 	RenderWorkResult render_work_result;
 
-	// progress handler
-	util::IProgressHandler* progress;
+	// progress counter
+	util::AtomicProgressCounter* progress;
+	// chunk cache statistics already added to the render metrics
+	mc::CacheStats chunk_stats;
 };
 
 } /* namespace render */
@@ -22,11 +22,17 @@
 #include "../mc/chunk.h"
 #include "../mc/pos.h"
 #include "../mc/world.h"
+#include "../thread/parallel.h"
+#include "../util.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <set>
@@ -88,50 +94,76 @@ std::ostream& operator<<(std::ostream& stream, const TilePos& tile) {
 	return stream;
 }
 
-TilePath::TilePath() {
+namespace {
+
+/**
+ * Returns the zoom level of a packed quadkey, this is the half position of the
+ * leading 1 bit.
+ */
+inline int getKeyDepth(uint64_t key) {
+#if defined(__GNUC__)
+	return (63 - __builtin_clzll(key)) / 2;
+#else
+	int depth = 0;
+	while (key >>= 2)
+		depth++;
+	return depth;
+#endif
+}
+
+}
+
+TilePath::TilePath()
+	: key(1) {
 }
 
 TilePath::~TilePath() {
 }
 
 int TilePath::getDepth() const {
-	return path.size();
+	return getKeyDepth(key);
 }
 
-const std::vector<int>& TilePath::getPath() const {
+std::vector<int> TilePath::getPath() const {
+	int depth = getDepth();
+	std::vector<int> path(depth);
+	for (int i = 0; i < depth; i++)
+		path[i] = ((key >> (2 * (depth - i - 1))) & 3) + 1;
 	return path;
 }
 
 TilePath TilePath::parent() const {
 	TilePath copy(*this);
-	copy.path.pop_back();
+	// the root tile does not have a parent
+	if (key != 1)
+		copy.key >>= 2;
 	return copy;
 }
 
 TilePos TilePath::getTilePos() const {
-	// calculate the radius of all tiles on the top zoom level (2^zoomlevel / 2)
-	int radius = pow(2, path.size()) / 2;
-	// the startpoint is top left
-	int x = -radius;
-	int y = -radius;
-	for (size_t i = 0; i < path.size(); i++) {
-		// now for every zoom level:
-		// get the current tile
-		int tile = path[i];
-		// increase x by the radius if this tile is on the right side (2 or 4)
-		if (tile == 2 || tile == 4)
-			x += radius;
-		// increase y by the radius if this tile is on the bottom side (3 or 4)
-		if (tile == 3 || tile == 4)
-			y += radius;
-		// divide size by two, because the next zoom level has only the half radius
-		radius /= 2;
+	// the bits of each node are the bits of the x/y coordinates on this zoom level:
+	// 2 and 4 are on the right side, 3 and 4 are on the bottom side
+	int depth = getDepth();
+	int x = 0, y = 0;
+	for (int i = depth - 1; i >= 0; i--) {
+		int node = (key >> (2 * i)) & 3;
+		x = (x << 1) | (node & 1);
+		y = (y << 1) | (node >> 1);
 	}
-	return TilePos(x, y);
+	// the tile coordinates are relative to the center of the zoom level,
+	// with the startpoint on the top left
+	int radius = depth == 0 ? 0 : 1 << (depth - 1);
+	return TilePos(x - radius, y - radius);
+}
+
+uint64_t TilePath::getKey() const {
+	return key;
 }
 
 TilePath& TilePath::operator+=(int node) {
-	path.push_back(node);
+	if (getDepth() >= MAX_DEPTH)
+		throw std::runtime_error("Tile path " + toString() + " is too long!");
+	key = (key << 2) | (node - 1);
 	return *this;
 }
 
@@ -140,11 +172,15 @@ TilePath TilePath::operator+(int node) const {
 }
 
 bool TilePath::operator==(const TilePath& other) const {
-	return path == other.path;
+	return key == other.key;
+}
+
+bool TilePath::operator!=(const TilePath& other) const {
+	return key != other.key;
 }
 
 bool TilePath::operator<(const TilePath& other) const {
-	return path < other.path;
+	return key < other.key;
 }
 
 std::ostream& operator<<(std::ostream& stream, const TilePath& path) {
@@ -153,84 +189,275 @@ std::ostream& operator<<(std::ostream& stream, const TilePath& path) {
 }
 
 std::string TilePath::toString() const {
-	std::stringstream ss;
+	std::string str;
+	std::vector<int> path = getPath();
 	for (size_t i = 0; i < path.size(); i++) {
-		ss << path[i];
+		str += '0' + path[i];
 		if (i != path.size() - 1)
-			ss << "/";
+			str += '/';
 	}
-	return ss.str();
+	return str;
 }
 
 TilePath TilePath::byTilePos(const TilePos& tile, int depth) {
-	TilePath path;
+	if (depth < 0 || depth > MAX_DEPTH)
+		throw std::runtime_error("Invalid tile depth " + util::str(depth));
 
 	// at first calculate the radius in tiles of this zoom level
-	int radius = pow(2, depth) / 2;
+	int64_t radius = depth == 0 ? 0 : (int64_t) 1 << (depth - 1);
 	// check if the tile is in this bounds
 	if (tile.getX() > radius  || tile.getY() > radius
 			|| tile.getX() < -radius || tile.getY() < -radius)
 		throw std::runtime_error("Invalid tile position " + util::str(tile.getX())
 			+ ":" + util::str(tile.getY()) + " on depth " + util::str(depth));
-	// the tactic is here to calculate the bounds where the tile is inside
-	int bounds_left = -radius;
-	int bounds_right = radius;
-	int bounds_top = radius;
-	int bounds_bottom = -radius;
-
-	for (int level = 1; level <= depth; level++) {
-		// for each zoom level (but we already have the 1st zoom level):
-		// calculate the midpoint in the bounds
-		int middle_x = (bounds_right + bounds_left) / 2;
-		int middle_y = (bounds_top + bounds_bottom) / 2;
-		// with this midpoint we can decide what the next part in the path is
-		// when tile x < midpoint x:
-		//   and tile y < midpoint y -> top left tile
-		//   and tile y >= midpoint y -> bottom left tile
-		// when tile y >= midpoint y:
-		//   and tile y < midpoint y -> top right tile
-		//   and tile y >= midpoint y -> bottom right tile
-
-		// if we have a midpoint, we update the bounds with the midpoint
-		// the (smaller) bounds are now the part of the path, we found out
-		if (tile.getX() < middle_x) {
-			if (tile.getY() < middle_y) {
-				path += 1;
-				bounds_right = middle_x;
-				bounds_top = middle_y;
-			} else {
-				path += 3;
-				bounds_right = middle_x;
-				bounds_bottom = middle_y;
-			}
-		} else {
-			if (tile.getY() < middle_y) {
-				path += 2;
-				bounds_left = middle_x;
-				bounds_top = middle_y;
-			} else {
-				path += 4;
-				bounds_left = middle_x;
-				bounds_bottom = middle_y;
+
+	// move the tile coordinates to [0, 2^depth), then every bit of the coordinates
+	// decides for one zoom level whether the tile is on the left/right or top/bottom
+	// (tiles on the right/bottom border are treated like the ones next to them)
+	int64_t max = ((int64_t) 1 << depth) - 1;
+	int64_t x = std::min(tile.getX() + radius, max);
+	int64_t y = std::min(tile.getY() + radius, max);
+
+	TilePath path;
+	for (int i = depth - 1; i >= 0; i--) {
+		int node = ((x >> i) & 1) | (((y >> i) & 1) << 1);
+		path.key = (path.key << 2) | node;
+	}
+	return path;
+}
+
+TilePath TilePath::byKey(uint64_t key) {
+	TilePath path;
+	if (key != 0)
+		path.key = key;
+	return path;
+}
+
+namespace {
+
+const char CHUNK_INDEX_MAGIC[4] = {'M', 'C', 'C', 'I'};
+const int32_t CHUNK_INDEX_VERSION = 1;
+
+template <typename T>
+bool readValue(std::istream& in, T& value) {
+	in.read(reinterpret_cast<char*>(&value), sizeof(T));
+	return !in.fail();
+}
+
+template <typename T>
+void writeValue(std::ostream& out, T value) {
+	out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+}
+
+ChunkIndex::ChunkIndex()
+	: rotation(0), regions_read(0) {
+}
+
+ChunkIndex::~ChunkIndex() {
+}
+
+void ChunkIndex::read(const mc::World& world, int threads) {
+	// the already read regions can only be used if they are from the same world
+	if (region_dir != world.getRegionDir().string() || rotation != world.getRotation())
+		regions.clear();
+	region_dir = world.getRegionDir().string();
+	rotation = world.getRotation();
+
+	auto available_regions = world.getAvailableRegions();
+	std::vector<RegionEntry> old_regions;
+	old_regions.swap(regions);
+	regions.resize(available_regions.size());
+
+	// every thread checks some region files and reads the headers of the changed ones,
+	// the chunks are put into the slot of the region, that way no synchronization
+	// is needed
+	std::vector<mc::RegionPos> positions(available_regions.begin(), available_regions.end());
+	std::sort(positions.begin(), positions.end());
+	std::atomic<int> read_count(0);
+	std::time_t now = std::time(nullptr);
+	thread::parallelFor(positions.size(), threads, [&](size_t i) {
+		RegionEntry& entry = regions[i];
+		entry.pos = positions[i];
+		entry.mtime = 0;
+		entry.size = 0;
+
+		fs::path path = world.getRegionPath(positions[i]);
+		boost::system::error_code ec;
+		std::time_t mtime = fs::last_write_time(path, ec);
+		uintmax_t size = ec ? 0 : fs::file_size(path, ec);
+		if (!ec) {
+			entry.mtime = mtime;
+			entry.size = size;
+		}
+
+		// the old regions are sorted by position as well
+		auto old_it = std::lower_bound(old_regions.begin(), old_regions.end(), entry,
+				[](const RegionEntry& a, const RegionEntry& b) { return a.pos < b.pos; });
+		if (!ec && old_it != old_regions.end() && old_it->pos == entry.pos
+				&& old_it->mtime == entry.mtime && old_it->size == entry.size) {
+			entry.chunks.swap(old_it->chunks);
+			return;
+		}
+
+		// read the header without world crop, the chunks are cropped afterwards
+		mc::RegionFile region;
+		if (!world.getRegion(positions[i], region))
+			return;
+		region.setWorldCrop(mc::WorldCrop());
+		read_count++;
+		if (!region.readOnlyHeaders()) {
+			// make sure a broken region file is read again next time
+			entry.mtime = entry.size = 0;
+			return;
+		}
+		// the modification time has a resolution of seconds only, so a region file
+		// modified right now might be modified again without a visible change
+		if (entry.mtime >= now - 1)
+			entry.mtime = 0;
+		const std::set<mc::ChunkPos>& containing = region.getContainingChunks();
+		entry.chunks.reserve(containing.size());
+		for (auto chunk_it = containing.begin(); chunk_it != containing.end(); ++chunk_it)
+			entry.chunks.push_back(std::make_pair(
+					chunk_it->getLocalZ() * 32 + chunk_it->getLocalX(),
+					region.getChunkTimestamp(*chunk_it)));
+	});
+	regions_read = read_count;
+
+	// now collect the chunks which are within the world crop
+	mc::WorldCrop world_crop = world.getWorldCrop();
+	chunks.clear();
+	for (auto region_it = regions.begin(); region_it != regions.end(); ++region_it) {
+		for (auto chunk_it = region_it->chunks.begin();
+				chunk_it != region_it->chunks.end(); ++chunk_it) {
+			mc::ChunkPos chunk(region_it->pos.x * 32 + chunk_it->first % 32,
+					region_it->pos.z * 32 + chunk_it->first / 32);
+			// the world crop is in the original (not rotated) coordinates
+			mc::ChunkPos original = chunk;
+			if (rotation)
+				original.rotate(4 - rotation);
+			if (world_crop.isChunkContained(original))
+				chunks.push_back(std::make_pair(chunk, chunk_it->second));
+		}
+	}
+}
+
+bool ChunkIndex::readFile(const fs::path& file) {
+	region_dir.clear();
+	rotation = 0;
+	regions.clear();
+	chunks.clear();
+
+	std::ifstream in(file.string().c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	// header: magic, version, region directory and rotation of the world and count of
+	// regions, then every region with position, modification time, size and chunks,
+	// everything big endian
+	char magic[4];
+	int32_t version, length, value, region_count;
+	in.read(magic, 4);
+	bool valid = in && std::memcmp(magic, CHUNK_INDEX_MAGIC, 4) == 0
+			&& readValue(in, version) && util::bigEndian32(version) == CHUNK_INDEX_VERSION
+			&& readValue(in, length);
+	if (valid) {
+		region_dir.resize(std::max(util::bigEndian32(length), 0));
+		in.read(&region_dir[0], region_dir.size());
+		valid = in && readValue(in, value) && readValue(in, region_count);
+		rotation = util::bigEndian32(value);
+		region_count = util::bigEndian32(region_count);
+	}
+
+	for (int32_t i = 0; valid && i < region_count; i++) {
+		RegionEntry entry;
+		int32_t x, z, chunk_count;
+		int64_t mtime, size;
+		valid = readValue(in, x) && readValue(in, z) && readValue(in, mtime)
+				&& readValue(in, size) && readValue(in, chunk_count);
+		if (!valid)
+			break;
+		entry.pos = mc::RegionPos(util::bigEndian32(x), util::bigEndian32(z));
+		entry.mtime = util::bigEndian64(mtime);
+		entry.size = util::bigEndian64(size);
+		chunk_count = util::bigEndian32(chunk_count);
+		valid = chunk_count >= 0 && chunk_count <= 1024
+				&& (regions.empty() || regions.back().pos < entry.pos);
+		for (int32_t j = 0; valid && j < chunk_count; j++) {
+			int16_t index;
+			int32_t timestamp;
+			valid = readValue(in, index) && readValue(in, timestamp);
+			entry.chunks.push_back(std::make_pair(util::bigEndian16(index),
+					util::bigEndian32(timestamp)));
+		}
+		regions.push_back(entry);
+	}
+
+	if (!valid) {
+		LOG(WARNING) << "Invalid chunk index file '" << file.string() << "'.";
+		region_dir.clear();
+		regions.clear();
+		return false;
+	}
+	return true;
+}
+
+bool ChunkIndex::writeFile(const fs::path& file) const {
+	// write to a temporary file first, a half-written file must not be used
+	fs::path tmp_file = file.string() + ".tmp";
+	{
+		std::ofstream out(tmp_file.string().c_str(), std::ios::binary);
+		if (!out)
+			return false;
+		out.write(CHUNK_INDEX_MAGIC, 4);
+		writeValue(out, util::bigEndian32(CHUNK_INDEX_VERSION));
+		writeValue(out, util::bigEndian32(region_dir.size()));
+		out.write(region_dir.c_str(), region_dir.size());
+		writeValue(out, util::bigEndian32(rotation));
+		writeValue(out, util::bigEndian32(regions.size()));
+		for (auto region_it = regions.begin(); region_it != regions.end(); ++region_it) {
+			writeValue(out, util::bigEndian32(region_it->pos.x));
+			writeValue(out, util::bigEndian32(region_it->pos.z));
+			writeValue(out, util::bigEndian64(region_it->mtime));
+			writeValue(out, util::bigEndian64(region_it->size));
+			writeValue(out, util::bigEndian32(region_it->chunks.size()));
+			for (auto chunk_it = region_it->chunks.begin();
+					chunk_it != region_it->chunks.end(); ++chunk_it) {
+				writeValue(out, util::bigEndian16(chunk_it->first));
+				writeValue(out, util::bigEndian32(chunk_it->second));
 			}
 		}
+		if (!out)
+			return false;
 	}
 
-	return path;
+	boost::system::error_code ec;
+	fs::rename(tmp_file, file, ec);
+	return !ec;
+}
+
+const std::vector<ChunkIndex::ChunkTimestamp>& ChunkIndex::getChunks() const {
+	return chunks;
+}
+
+int ChunkIndex::getRegionsRead() const {
+	return regions_read;
 }
 
 TileSet::TileSet(int tile_width)
-	: tile_width(tile_width), min_depth(0), depth(0) {
+	: tile_width(tile_width), min_depth(0), depth(0), changed_chunks_known(false) {
 }
 
 TileSet::~TileSet() {
 }
 
-void TileSet::findRenderTiles(const mc::World& world, bool auto_center,
-		TilePos& tile_offset) {
+void TileSet::findRenderTiles(const ChunkIndex& chunks, int rotation,
+		bool auto_center, TilePos& tile_offset) {
 	// clear maybe already calculated tiles
 	render_tiles.clear();
 	required_render_tiles.clear();
+	tile_timestamps.clear();
 
 	// the min/max x/y coordinates of the tiles in the world
 	int tiles_x_min = std::numeric_limits<int>::max(),
@@ -238,40 +465,42 @@ void TileSet::findRenderTiles(const mc::World& world, bool auto_center,
 	    tiles_y_min = std::numeric_limits<int>::max(),
 	    tiles_y_max = std::numeric_limits<int>::min();
 
-	// go through all chunks in the world
-	auto regions = world.getAvailableRegions();
-	for (auto region_it = regions.begin(); region_it != regions.end(); ++region_it) {
-		mc::RegionFile region;
-		if (!world.getRegion(*region_it, region) || !region.readOnlyHeaders())
-			continue;
-		const std::set<mc::ChunkPos>& region_chunks = region.getContainingChunks();
-		for (auto chunk_it = region_chunks.begin(); chunk_it != region_chunks.end();
-		        ++chunk_it) {
-			int timestamp = region.getChunkTimestamp(*chunk_it);
-
-			// now get all tiles of the chunk
-			std::set<TilePos> tiles;
-			mapChunkToTiles(*chunk_it, tiles);
-			for (std::set<TilePos>::const_iterator tile_it = tiles.begin();
-			        tile_it != tiles.end(); ++tile_it) {
-
-				// and update the bounds
-				tiles_x_min = std::min(tiles_x_min, tile_it->getX());
-				tiles_x_max = std::max(tiles_x_max, tile_it->getX());
-				tiles_y_min = std::min(tiles_y_min, tile_it->getY());
-				tiles_y_max = std::max(tiles_y_max, tile_it->getY());
-
-				// update tile timestamp
-				if (!render_tiles.count(*tile_it))
-					tile_timestamps[*tile_it] = timestamp;
-				else
-					tile_timestamps[*tile_it] = std::max(tile_timestamps[*tile_it], timestamp);
-
-				// insert the tile to the set of available render tiles
-				// and also make it required by default
-				render_tiles.insert(*tile_it);
-				required_render_tiles.insert(*tile_it);
-			}
+	// go through all chunks in the world and collect all tiles with the timestamps of
+	// the chunks, a tile may be in there multiple times for now
+	std::vector<std::pair<TilePos, int> > chunk_tiles;
+	std::set<TilePos> tiles;
+	const std::vector<ChunkIndex::ChunkTimestamp>& index = chunks.getChunks();
+	for (auto chunk_it = index.begin(); chunk_it != index.end(); ++chunk_it) {
+		mc::ChunkPos chunk = chunk_it->first;
+		if (rotation)
+			chunk.rotate(rotation);
+		int timestamp = chunk_it->second;
+
+		// now get all tiles of the chunk
+		tiles.clear();
+		mapChunkToTiles(chunk, tiles);
+		for (std::set<TilePos>::const_iterator tile_it = tiles.begin();
+				tile_it != tiles.end(); ++tile_it) {
+
+			// and update the bounds
+			tiles_x_min = std::min(tiles_x_min, tile_it->getX());
+			tiles_x_max = std::max(tiles_x_max, tile_it->getX());
+			tiles_y_min = std::min(tiles_y_min, tile_it->getY());
+			tiles_y_max = std::max(tiles_y_max, tile_it->getY());
+
+			chunk_tiles.push_back(std::make_pair(*tile_it, timestamp));
+		}
+	}
+
+	// sort the tiles and merge the duplicates,
+	// the timestamp of a tile is the highest timestamp of its chunks
+	std::sort(chunk_tiles.begin(), chunk_tiles.end());
+	for (auto it = chunk_tiles.begin(); it != chunk_tiles.end(); ++it) {
+		if (!render_tiles.empty() && render_tiles.back() == it->first)
+			tile_timestamps.back() = std::max(tile_timestamps.back(), it->second);
+		else {
+			render_tiles.push_back(it->first);
+			tile_timestamps.push_back(it->second);
 		}
 	}
 
@@ -281,24 +510,17 @@ void TileSet::findRenderTiles(const mc::World& world, bool auto_center,
 		if (auto_center)
 			tile_offset = TilePos((tiles_x_min + tiles_x_max) / 2, (tiles_y_min + tiles_y_max) / 2);
 
-		// update all tile positions
-		std::set<TilePos> render_tiles_tmp, required_render_tiles_tmp;
-		std::map<TilePos, int> tile_timestamps_tmp;
+		// update all tile positions, moving all tiles keeps them sorted
 		for (auto it = render_tiles.begin(); it != render_tiles.end(); ++it)
-			render_tiles_tmp.insert(*it - tile_offset);
-		for (auto it = required_render_tiles.begin(); it != required_render_tiles.end(); ++it)
-			required_render_tiles_tmp.insert(*it - tile_offset);
-		for (auto it = tile_timestamps.begin(); it != tile_timestamps.end(); ++it)
-			tile_timestamps_tmp[it->first - tile_offset] = it->second;
-
-		render_tiles = render_tiles_tmp;
-		required_render_tiles = required_render_tiles_tmp;
-		tile_timestamps = tile_timestamps_tmp;
+			*it -= tile_offset;
 		this->tile_offset = tile_offset;
 	}
 
+	// all tiles are required by default
+	required_render_tiles = render_tiles;
+
 	// now get the necessary depth of the tile quadtree
-	for (min_depth = 0; min_depth < 32; min_depth++) {
+	for (min_depth = 0; min_depth < TilePath::MAX_DEPTH; min_depth++) {
 		// for each level calculate the radius and check if the tiles fit in this bounds
 		// also don't forget the tile offset
 		int radius = pow(2, min_depth) / 2;
@@ -310,43 +532,66 @@ void TileSet::findRenderTiles(const mc::World& world, bool auto_center,
 	}
 }
 
-void TileSet::findRequiredCompositeTiles(const std::set<TilePos>& render_tiles,
-		std::set<TilePath>& tiles) {
+void TileSet::findRequiredCompositeTiles(const std::vector<TilePos>& render_tiles,
+		std::vector<TilePath>& tiles, std::vector<int>& containing) {
+	tiles.clear();
+	containing.clear();
+	if (depth == 0)
+		return;
 
-	// iterate through the render tiles on the max zoom level
-	// add their parent composite tiles
-	for (std::set<TilePos>::iterator it = render_tiles.begin(); it != render_tiles.end(); ++it) {
-		TilePath path = TilePath::byTilePos(*it, depth);
-		tiles.insert(path.parent());
+	// get the quadkeys of the render tiles on the max zoom level and sort them
+	std::vector<uint64_t> level(render_tiles.size());
+	for (size_t i = 0; i < render_tiles.size(); i++)
+		level[i] = TilePath::byTilePos(render_tiles[i], depth).getKey();
+	std::sort(level.begin(), level.end());
+	std::vector<int> level_containing(level.size(), 1);
+
+	// now go from bottom to top through the zoom levels: the parent quadkey of a
+	// quadkey is just the quadkey shifted by two bits, so the parents of a sorted zoom
+	// level are sorted too and children of the same parent are next to each other,
+	// the parents and their containing render tiles are found in a single pass
+	std::vector<std::vector<uint64_t> > levels;
+	std::vector<std::vector<int> > levels_containing;
+	for (int d = depth; d > 0; d--) {
+		std::vector<uint64_t> parents;
+		std::vector<int> parents_containing;
+		for (size_t i = 0; i < level.size(); i++) {
+			uint64_t parent = level[i] >> 2;
+			if (!parents.empty() && parents.back() == parent)
+				parents_containing.back() += level_containing[i];
+			else {
+				parents.push_back(parent);
+				parents_containing.push_back(level_containing[i]);
+			}
+		}
+		level.swap(parents);
+		level_containing.swap(parents_containing);
+		levels.push_back(level);
+		levels_containing.push_back(level_containing);
 	}
 
-	// now iterate through the composite tiles from bottom to top
-	// and also add their parent composite tiles
-	for (int d = depth - 1; d > 0; d--) {
-		std::set<TilePath> tmp;
-		for (std::set<TilePath>::iterator it = tiles.begin(); it != tiles.end(); ++it) {
-			if (it->getDepth() == d)
-				tmp.insert(it->parent());
-		}
-		for (std::set<TilePath>::iterator it = tmp.begin(); it != tmp.end(); ++it)
-			tiles.insert(*it);
+	// the quadkeys of a lower zoom level are always smaller than the ones of a
+	// higher zoom level, so putting the levels together from top to bottom
+	// results in sorted composite tiles
+	for (size_t i = levels.size(); i > 0; i--) {
+		const std::vector<uint64_t>& keys = levels[i - 1];
+		for (size_t j = 0; j < keys.size(); j++)
+			tiles.push_back(TilePath::byKey(keys[j]));
+		containing.insert(containing.end(), levels_containing[i - 1].begin(),
+				levels_containing[i - 1].end());
 	}
 }
 
-void TileSet::updateContainingRenderTiles() {
-	containing_render_tiles.clear();
-	// initialize every composite tile with 0
-	for (auto it = composite_tiles.begin(); it != composite_tiles.end(); ++it)
-		containing_render_tiles[*it] = 0;
-	// go through all required render tiles
-	// set the containing render tiles for every parent composite tile +1
-	// to have the number of required render tiles in every composite tile
-	for (auto it = required_render_tiles.begin(); it != required_render_tiles.end(); ++it) {
-		TilePath tile = TilePath::byTilePos(*it, depth);
-		while (tile.getDepth() != 0) {
-			tile = tile.parent();
-			containing_render_tiles[tile]++;
-		}
+void TileSet::updateContainingRenderTiles(const std::vector<int>& required_containing) {
+	// every required composite tile is also a composite tile and both are sorted,
+	// so just walk through them at the same time, all other composite tiles don't
+	// contain any required render tiles
+	containing_render_tiles.assign(composite_tiles.size(), 0);
+	size_t j = 0;
+	for (size_t i = 0; i < composite_tiles.size()
+			&& j < required_composite_tiles.size(); i++) {
+		if (composite_tiles[i] == required_composite_tiles[j])
+			containing_render_tiles[i] = required_containing[j++];
 	}
 }
 
@@ -357,53 +602,115 @@ void TileSet::scan(const mc::World& world) {
 }
 
 void TileSet::scan(const mc::World& world, bool auto_center, TilePos& tile_offset) {
-	findRenderTiles(world, auto_center, tile_offset);
+	ChunkIndex chunks;
+	chunks.read(world);
+	scan(chunks, 0, auto_center, tile_offset);
+}
+
+void TileSet::scan(const ChunkIndex& chunks, int rotation, bool auto_center,
+		TilePos& tile_offset) {
+	findRenderTiles(chunks, rotation, auto_center, tile_offset);
 	setDepth(min_depth);
 }
 
 void TileSet::resetRequired() {
-	required_render_tiles.clear();
-
-	for (auto it = tile_timestamps.begin(); it != tile_timestamps.end(); ++it)
-		required_render_tiles.insert(it->first);
+	required_render_tiles = render_tiles;
+	changed_chunks_known = false;
+	changed_chunks.clear();
 
-	required_composite_tiles.clear();
-	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles);
+	std::vector<int> required_containing;
+	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles,
+			required_containing);
 
-	updateContainingRenderTiles();
+	updateContainingRenderTiles(required_containing);
 }
 
 void TileSet::scanRequiredByTimestamp(int last_change) {
 	required_render_tiles.clear();
+	changed_chunks_known = false;
+	changed_chunks.clear();
 
-	for (std::map<TilePos, int>::iterator it = tile_timestamps.begin();
-			it != tile_timestamps.end(); ++it) {
-		if (it->second >= last_change)
-			required_render_tiles.insert(it->first);
+	for (size_t i = 0; i < render_tiles.size(); i++) {
+		if (tile_timestamps[i] >= last_change)
+			required_render_tiles.push_back(render_tiles[i]);
 	}
 
-	required_composite_tiles.clear();
-	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles);
+	std::vector<int> required_containing;
+	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles,
+			required_containing);
 
-	updateContainingRenderTiles();
+	updateContainingRenderTiles(required_containing);
 }
 
 void TileSet::scanRequiredByFiletimes(const fs::path& output_dir,
 		std::string image_format) {
 	required_render_tiles.clear();
+	changed_chunks_known = false;
+	changed_chunks.clear();
 
-	for (std::map<TilePos, int>::iterator it = tile_timestamps.begin();
-			it != tile_timestamps.end(); ++it) {
-		TilePath path = TilePath::byTilePos(it->first, depth);
+	for (size_t i = 0; i < render_tiles.size(); i++) {
+		TilePath path = TilePath::byTilePos(render_tiles[i], depth);
 		fs::path file = output_dir / (path.toString() + "." + image_format);
-		if (!fs::exists(file) || fs::last_write_time(file) <= it->second)
-			required_render_tiles.insert(it->first);
+		if (!fs::exists(file) || fs::last_write_time(file) <= tile_timestamps[i])
+			required_render_tiles.push_back(render_tiles[i]);
 	}
 
-	required_composite_tiles.clear();
-	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles);
+	std::vector<int> required_containing;
+	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles,
+			required_containing);
 
-	updateContainingRenderTiles();
+	updateContainingRenderTiles(required_containing);
+}
+
+void TileSet::scanRequiredByChunks(const std::vector<mc::ChunkPos>& chunks,
+		int rotation) {
+	required_render_tiles.clear();
+	changed_chunks_known = true;
+	changed_chunks.clear();
+
+	std::set<TilePos> tiles;
+	for (auto chunk_it = chunks.begin(); chunk_it != chunks.end(); ++chunk_it) {
+		mc::ChunkPos chunk = *chunk_it;
+		if (rotation)
+			chunk.rotate(rotation);
+
+		tiles.clear();
+		mapChunkToTiles(chunk, tiles);
+		for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it) {
+			// tiles of removed chunks might not exist anymore
+			TilePos tile = *tile_it - tile_offset;
+			if (std::binary_search(render_tiles.begin(), render_tiles.end(), tile)) {
+				required_render_tiles.push_back(tile);
+				changed_chunks.push_back(std::make_pair(tile, chunk));
+			}
+		}
+	}
+	std::sort(required_render_tiles.begin(), required_render_tiles.end());
+	required_render_tiles.erase(std::unique(required_render_tiles.begin(),
+			required_render_tiles.end()), required_render_tiles.end());
+	std::sort(changed_chunks.begin(), changed_chunks.end());
+	changed_chunks.erase(std::unique(changed_chunks.begin(), changed_chunks.end()),
+			changed_chunks.end());
+
+	std::vector<int> required_containing;
+	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles,
+			required_containing);
+
+	updateContainingRenderTiles(required_containing);
+}
+
+bool TileSet::getChangedChunks(const TilePos& tile,
+		std::vector<mc::ChunkPos>& chunks) const {
+	chunks.clear();
+	if (!changed_chunks_known)
+		return false;
+	auto it = std::lower_bound(changed_chunks.begin(), changed_chunks.end(), tile,
+			[](const std::pair<TilePos, mc::ChunkPos>& a, const TilePos& b) {
+		return a.first < b;
+	});
+	for (; it != changed_chunks.end() && it->first == tile; ++it)
+		chunks.push_back(it->second);
+	return true;
 }
 
 int TileSet::getTileWidth() const {
@@ -425,14 +732,13 @@ void TileSet::setDepth(int depth) {
 
 	this->depth = depth;
 
-	// clear already calculated composite tiles and recalculate them
-	composite_tiles.clear();
-	required_composite_tiles.clear();
-
-	findRequiredCompositeTiles(render_tiles, composite_tiles);
-	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles);
+	// recalculate the composite tiles
+	std::vector<int> containing, required_containing;
+	findRequiredCompositeTiles(render_tiles, composite_tiles, containing);
+	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles,
+			required_containing);
 
-	updateContainingRenderTiles();
+	updateContainingRenderTiles(required_containing);
 }
 
 const TilePos& TileSet::getTileOffset() const {
@@ -441,21 +747,32 @@ const TilePos& TileSet::getTileOffset() const {
 
 bool TileSet::hasTile(const TilePath& path) const {
 	if (path.getDepth() == depth)
-		return render_tiles.count(path.getTilePos()) != 0;
-	return composite_tiles.count(path) != 0;
+		return std::binary_search(render_tiles.begin(), render_tiles.end(),
+				path.getTilePos());
+	return std::binary_search(composite_tiles.begin(), composite_tiles.end(), path);
 }
 
 bool TileSet::isTileRequired(const TilePath& path) const {
-	if(path.getDepth() == depth)
-		return required_render_tiles.count(path.getTilePos()) != 0;
-	return required_composite_tiles.count(path) != 0;
+	if (path.getDepth() == depth)
+		return std::binary_search(required_render_tiles.begin(),
+				required_render_tiles.end(), path.getTilePos());
+	return std::binary_search(required_composite_tiles.begin(),
+			required_composite_tiles.end(), path);
+}
+
+const std::vector<TilePos>& TileSet::getRenderTiles() const {
+	return render_tiles;
+}
+
+const std::vector<TilePath>& TileSet::getCompositeTiles() const {
+	return composite_tiles;
 }
 
 int TileSet::getRequiredRenderTilesCount() const {
 	return required_render_tiles.size();
 }
 
-const std::set<TilePos>& TileSet::getRequiredRenderTiles() const {
+const std::vector<TilePos>& TileSet::getRequiredRenderTiles() const {
 	return required_render_tiles;
 }
 
@@ -463,12 +780,15 @@ int TileSet::getRequiredCompositeTilesCount() const {
 	return required_composite_tiles.size();
 }
 
-const std::set<TilePath>& TileSet::getRequiredCompositeTiles() const {
+const std::vector<TilePath>& TileSet::getRequiredCompositeTiles() const {
 	return required_composite_tiles;
 }
 
 int TileSet::getContainingRenderTiles(const TilePath& tile) const {
-	return containing_render_tiles.at(tile);
+	auto it = std::lower_bound(composite_tiles.begin(), composite_tiles.end(), tile);
+	if (it == composite_tiles.end() || *it != tile)
+		throw std::out_of_range("Tile " + tile.toString() + " is not a composite tile!");
+	return containing_render_tiles[it - composite_tiles.begin()];
 }
 
 }
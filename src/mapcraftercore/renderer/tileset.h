@@ -20,8 +20,12 @@
 #ifndef TILE_H_
 #define TILE_H_
 
-#include <map>
+#include "../mc/pos.h"
+
+#include <cstdint>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
 #include <boost/filesystem.hpp>
 
@@ -61,7 +65,6 @@ namespace fs = boost::filesystem;
 namespace mapcrafter {
 
 namespace mc {
-class ChunkPos;
 class World;
 }
 
@@ -105,9 +108,17 @@ std::ostream& operator<<(std::ostream& stream, const TilePos& tile);
  * This class represents the path to a tile in the quadtree.
  * Every part in the path is a 1, 2, 3 or 4.
  * The length of the path is the zoom level of the tile.
+ *
+ * The path is packed into a single 64 bit integer (a quadkey): A leading 1 bit marks the
+ * start of the path, followed by two bits (node - 1) for every node of the path. This
+ * allows paths with a maximum length of 31. Paths are ordered by their quadkey, this
+ * means at first by their zoom level and then lexicographically by their nodes.
  */
 class TilePath {
 public:
+	// maximum zoom level a path can have
+	static const int MAX_DEPTH = 31;
+
 	TilePath();
 	~TilePath();
 
@@ -117,9 +128,9 @@ public:
 	int getDepth() const;
 
 	/**
-	 * Returns the path.
+	 * Returns the nodes of the path.
 	 */
-	const std::vector<int>& getPath() const;
+	std::vector<int> getPath() const;
 
 	/**
 	 * Returns the path of the parent tile.
@@ -132,6 +143,11 @@ public:
 	 */
 	TilePos getTilePos() const;
 
+	/**
+	 * Returns the packed quadkey of the path.
+	 */
+	uint64_t getKey() const;
+
 	/**
 	 * Adds a node to the path.
 	 */
@@ -140,6 +156,7 @@ public:
 
 	// some more comparison operations
 	bool operator==(const TilePath& other) const;
+	bool operator!=(const TilePath& other) const;
 	bool operator<(const TilePath& other) const;
 
 	/**
@@ -153,12 +170,87 @@ public:
 	 */
 	static TilePath byTilePos(const TilePos& tile, int depth);
 
+	/**
+	 * Constructs a path from a packed quadkey (see getKey-method).
+	 */
+	static TilePath byKey(uint64_t key);
+
 private:
-	std::vector<int> path;
+	uint64_t key;
 };
 
 std::ostream& operator<<(std::ostream& stream, const TilePath& path);
 
+/**
+ * This class contains the positions and timestamps of all chunks of a world, read from
+ * the region headers.
+ *
+ * The region headers of a world only need to be read once this way. Since the tiles of
+ * a tile set depend only on the chunk positions, the tile sets of all rotations and
+ * tile widths of a world can be scanned from the same chunk index.
+ *
+ * The index can also be stored in a file. When reading a world with an index read from
+ * a file, only the headers of the region files whose modification time or size
+ * changed are read again.
+ */
+class ChunkIndex {
+public:
+	typedef std::pair<mc::ChunkPos, uint32_t> ChunkTimestamp;
+
+	ChunkIndex();
+	~ChunkIndex();
+
+	/**
+	 * Reads the headers of all region files of a world with the specified count of
+	 * threads. The chunk positions are stored like the world returns them, so you
+	 * usually want to use a world that is not rotated and rotate the chunk positions
+	 * when scanning the tile sets.
+	 *
+	 * Regions which were already read (from the same world, for example with an index
+	 * read from a file) and whose files did not change are not read again.
+	 */
+	void read(const mc::World& world, int threads = 1);
+
+	/**
+	 * Reads/writes the index from/to a file. Returns false if the file does not exist
+	 * or is invalid, the index is empty then.
+	 */
+	bool readFile(const fs::path& file);
+	bool writeFile(const fs::path& file) const;
+
+	/**
+	 * Returns the chunks with their timestamps.
+	 */
+	const std::vector<ChunkTimestamp>& getChunks() const;
+
+	/**
+	 * Returns the count of region files whose headers were actually read by the last
+	 * call of the read method.
+	 */
+	int getRegionsRead() const;
+
+private:
+	struct RegionEntry {
+		mc::RegionPos pos;
+		// modification time and size of the region file when the header was read
+		int64_t mtime;
+		uint64_t size;
+		// all chunks of the region (not cropped) as local index (z * 32 + x)
+		// with timestamps
+		std::vector<std::pair<uint16_t, uint32_t> > chunks;
+	};
+
+	// region directory and rotation of the world the index was read from
+	std::string region_dir;
+	int rotation;
+	// the regions sorted by position
+	std::vector<RegionEntry> regions;
+	int regions_read;
+
+	// the chunks of all regions within the world crop
+	std::vector<ChunkTimestamp> chunks;
+};
+
 /**
  * This class manages all tiles required to render a world.
  */
@@ -182,6 +274,14 @@ public:
 	void scan(const mc::World& world);
 	void scan(const mc::World& world, bool auto_center, TilePos& tile_offset);
 
+	/**
+	 * Scans the tiles from an already read chunk index. The chunk positions of the
+	 * index are rotated by the specified rotation before mapping them to tiles.
+	 * See the other scan method for the auto_center and tile_offset parameters.
+	 */
+	void scan(const ChunkIndex& chunks, int rotation, bool auto_center,
+			TilePos& tile_offset);
+
 	/**
 	 * Resets which tiles are required / not required. All tiles will be required.
 	 */
@@ -200,6 +300,22 @@ public:
 	void scanRequiredByFiletimes(const fs::path& output_dir,
 			std::string image_format = "png");
 
+	/**
+	 * Sets the tiles of some changed chunks required. Like the chunk index, the chunk
+	 * positions are rotated by the specified rotation before mapping them to tiles.
+	 *
+	 * The changed chunks of every required render tile are remembered, so the tile
+	 * renderer can re-render only the parts of the tiles affected by them.
+	 */
+	void scanRequiredByChunks(const std::vector<mc::ChunkPos>& chunks, int rotation);
+
+	/**
+	 * Returns the (rotated) changed chunks of a required render tile. Returns false
+	 * if they are not known because the required tiles were not scanned by chunks,
+	 * the whole tile needs to be rendered then.
+	 */
+	bool getChangedChunks(const TilePos& tile, std::vector<mc::ChunkPos>& chunks) const;
+
 	/**
 	 * Returns the width of the tiles in chunks.
 	 */
@@ -236,15 +352,21 @@ public:
 	 */
 	bool isTileRequired(const TilePath& path) const;
 
+	/**
+	 * Returns all render tiles / composite tiles (sorted).
+	 */
+	const std::vector<TilePos>& getRenderTiles() const;
+	const std::vector<TilePath>& getCompositeTiles() const;
+
 	/**
 	 * Returns the count of required render tiles.
 	 */
 	int getRequiredRenderTilesCount() const;
 
 	/**
-	 * Returns the required render tiles.
+	 * Returns the required render tiles (sorted).
 	 */
-	const std::set<TilePos>& getRequiredRenderTiles() const;
+	const std::vector<TilePos>& getRequiredRenderTiles() const;
 
 	/**
 	 * Returns the count of required composite tiles.
@@ -252,9 +374,9 @@ public:
 	int getRequiredCompositeTilesCount() const;
 
 	/**
-	 * Returns the required composite tiles.
+	 * Returns the required composite tiles (sorted).
 	 */
-	const std::set<TilePath>& getRequiredCompositeTiles() const;
+	const std::vector<TilePath>& getRequiredCompositeTiles() const;
 
 	/**
 	 * Returns the count of required render tiles a specific composite tiles contains.
@@ -275,21 +397,29 @@ private:
 	// but are actually rendered as pos+tile_offset
 	TilePos tile_offset;
 
+	// all tiles are stored in sorted vectors, looking up a tile is a binary search
+
 	// all available render tiles
 	// (= tiles with the highest zoom level, tree leaves in the quadtree)
-	std::set<TilePos> render_tiles;
-	// the render tiles which actually need to get rendered
-	std::set<TilePos> required_render_tiles;
+	std::vector<TilePos> render_tiles;
 	// timestamps of render tiles required to re-render a tile
-	// (= highest timestamp of all chunks in a tile)
-	std::map<TilePos, int> tile_timestamps;
+	// (= highest timestamp of all chunks in a tile), same order as render_tiles
+	std::vector<int> tile_timestamps;
+	// the render tiles which actually need to get rendered
+	std::vector<TilePos> required_render_tiles;
 
 	// same here for composite tiles
-	std::set<TilePath> composite_tiles;
-	std::set<TilePath> required_composite_tiles;
+	std::vector<TilePath> composite_tiles;
+	std::vector<TilePath> required_composite_tiles;
+
+	// count of required render tiles contained in a composite tile,
+	// same order as composite_tiles
+	std::vector<int> containing_render_tiles;
 
-	// count of required render tiles contained in a composite tile
-	std::map<TilePath, int> containing_render_tiles;
+	// the changed chunks of the required render tiles (sorted), if the required tiles
+	// were scanned by chunks
+	bool changed_chunks_known;
+	std::vector<std::pair<TilePos, mc::ChunkPos> > changed_chunks;
 
 	/**
 	 * This method finds out which render level tiles a world has and which maximum
@@ -298,21 +428,26 @@ private:
 	 * The auto_center parameter describes whether it should automatically center the
 	 * found tiles. If set to false (default), it will use tile_offset as center.
 	 */
-	void findRenderTiles(const mc::World& world, bool auto_center, TilePos& tile_offset);
+	void findRenderTiles(const ChunkIndex& chunks, int rotation, bool auto_center,
+			TilePos& tile_offset);
 
 	/**
 	 * This method finds out which composite tiles are needed, depending on a
-	 * list of available/required render tiles, and puts them into a set.
+	 * list of available/required render tiles, and puts them sorted into a vector.
 	 * So we can find out which composite tiles are available and which composite tiles
-	 * need to get rendered.
+	 * need to get rendered. The count of render tiles each composite tile contains is
+	 * put into the containing vector.
+	 *
+	 * This is done in a single bottom-up pass over the quadkeys of the render tiles.
 	 */
-	void findRequiredCompositeTiles(const std::set<TilePos>& render_tiles,
-			std::set<TilePath>& tiles);
+	void findRequiredCompositeTiles(const std::vector<TilePos>& render_tiles,
+			std::vector<TilePath>& tiles, std::vector<int>& containing);
 
 	/**
-	 * Updates the containing_render_tiles map.
+	 * Updates the containing_render_tiles counts from the counts of the required
+	 * composite tiles.
 	 */
-	void updateContainingRenderTiles();
+	void updateContainingRenderTiles(const std::vector<int>& required_containing);
 };
 
 }
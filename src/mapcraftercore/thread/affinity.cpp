@@ -0,0 +1,237 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "affinity.h"
+
+#include "../compat/thread.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <boost/filesystem.hpp>
+
+#ifdef HAVE_SCHED_SETAFFINITY
+#  include <sched.h>
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace thread {
+
+std::ostream& operator<<(std::ostream& out, ThreadPinning pinning) {
+	switch (pinning) {
+	case ThreadPinning::NONE: return out << "none";
+	case ThreadPinning::CPU: return out << "cpu";
+	case ThreadPinning::NUMA: return out << "numa";
+	default: return out << "unknown";
+	}
+}
+
+bool parseThreadPinning(const std::string& name, ThreadPinning& pinning) {
+	if (name == "none")
+		pinning = ThreadPinning::NONE;
+	else if (name == "cpu")
+		pinning = ThreadPinning::CPU;
+	else if (name == "numa")
+		pinning = ThreadPinning::NUMA;
+	else
+		return false;
+	return true;
+}
+
+std::vector<int> parseCPUList(const std::string& list) {
+	std::vector<int> cpus;
+	std::stringstream ss(list);
+	std::string range;
+	while (std::getline(ss, range, ',')) {
+		range = util::trim(range);
+		if (range.empty())
+			continue;
+		size_t dash = range.find('-');
+		try {
+			if (dash == std::string::npos)
+				cpus.push_back(util::as<int>(range));
+			else {
+				int first = util::as<int>(range.substr(0, dash));
+				int last = util::as<int>(range.substr(dash + 1));
+				for (int cpu = first; cpu <= last; cpu++)
+					cpus.push_back(cpu);
+			}
+		} catch (std::invalid_argument& e) {
+			LOG(WARNING) << "Invalid CPU list '" << list << "'.";
+			return std::vector<int>();
+		}
+	}
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return cpus;
+}
+
+std::vector<int> getAvailableCPUs() {
+	std::vector<int> cpus;
+#ifdef HAVE_SCHED_SETAFFINITY
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &set))
+				cpus.push_back(cpu);
+		return cpus;
+	}
+#endif
+	int count = thread_ns::thread::hardware_concurrency();
+	for (int cpu = 0; cpu < std::max(count, 1); cpu++)
+		cpus.push_back(cpu);
+	return cpus;
+}
+
+std::vector<std::vector<int> > getNUMANodes() {
+	std::vector<int> available = getAvailableCPUs();
+
+	// node id -> available CPUs of the node
+	std::map<int, std::vector<int> > node_cpus;
+	fs::path node_dir("/sys/devices/system/node");
+	boost::system::error_code ec;
+	if (fs::is_directory(node_dir, ec)) {
+		for (fs::directory_iterator it(node_dir, ec), end; !ec && it != end; it.increment(ec)) {
+			std::string name = it->path().filename().string();
+			if (name.size() <= 4 || name.substr(0, 4) != "node"
+					|| name.find_first_not_of("0123456789", 4) != std::string::npos)
+				continue;
+
+			std::ifstream in((it->path() / "cpulist").string().c_str());
+			std::string list;
+			if (!in || !std::getline(in, list))
+				continue;
+
+			std::vector<int> cpus = parseCPUList(list), usable;
+			std::set_intersection(cpus.begin(), cpus.end(), available.begin(),
+					available.end(), std::back_inserter(usable));
+			if (!usable.empty())
+				node_cpus[util::as<int>(name.substr(4))] = usable;
+		}
+	}
+
+	std::vector<std::vector<int> > nodes;
+	for (auto it = node_cpus.begin(); it != node_cpus.end(); ++it)
+		nodes.push_back(it->second);
+	if (nodes.empty())
+		nodes.push_back(available);
+	return nodes;
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+#ifdef HAVE_SCHED_SETAFFINITY
+	if (cpus.empty())
+		return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (auto it = cpus.begin(); it != cpus.end(); ++it)
+		if (*it >= 0 && *it < CPU_SETSIZE)
+			CPU_SET(*it, &set);
+	// on Linux a pid of 0 means the calling thread, not the whole process
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+ThreadPlacement::ThreadPlacement(ThreadPinning pinning)
+	: pinning(pinning) {
+	assign(1, std::vector<std::vector<int> >());
+}
+
+ThreadPlacement::~ThreadPlacement() {
+}
+
+void ThreadPlacement::assign(int threads) {
+	if (pinning == ThreadPinning::NONE)
+		assign(threads, std::vector<std::vector<int> >());
+	else
+		assign(threads, getNUMANodes());
+}
+
+void ThreadPlacement::assign(int threads, const std::vector<std::vector<int> >& system_nodes) {
+	nodes.clear();
+	thread_nodes.assign(threads, 0);
+	thread_cpus.assign(threads, std::vector<int>());
+
+	std::vector<std::vector<int> > usable_nodes;
+	for (auto it = system_nodes.begin(); it != system_nodes.end(); ++it)
+		if (!it->empty())
+			usable_nodes.push_back(*it);
+
+	if (pinning == ThreadPinning::NONE || usable_nodes.empty() || threads <= 0) {
+		// everything runs on one (virtual) node without any pinning
+		nodes.push_back(std::vector<int>());
+		return;
+	}
+
+	// thread i runs on node i % n, so the first min(n, threads) nodes are used
+	int node_count = std::min((int) usable_nodes.size(), threads);
+	nodes.assign(usable_nodes.begin(), usable_nodes.begin() + node_count);
+	for (int i = 0; i < threads; i++) {
+		int node = i % node_count;
+		thread_nodes[i] = node;
+		if (pinning == ThreadPinning::NUMA)
+			thread_cpus[i] = nodes[node];
+		else {
+			// the k-th thread of a node gets the k-th CPU of the node
+			const std::vector<int>& cpus = nodes[node];
+			thread_cpus[i].push_back(cpus[(i / node_count) % cpus.size()]);
+		}
+	}
+}
+
+ThreadPinning ThreadPlacement::getPinning() const {
+	return pinning;
+}
+
+int ThreadPlacement::getThreadCount() const {
+	return thread_nodes.size();
+}
+
+int ThreadPlacement::getNodeCount() const {
+	return nodes.size();
+}
+
+int ThreadPlacement::getThreadNode(int thread) const {
+	return thread_nodes.at(thread);
+}
+
+const std::vector<int>& ThreadPlacement::getNodeCPUs(int node) const {
+	return nodes.at(node);
+}
+
+const std::vector<int>& ThreadPlacement::getThreadCPUs(int thread) const {
+	return thread_cpus.at(thread);
+}
+
+void ThreadPlacement::pin(int thread) const {
+	const std::vector<int>& cpus = getThreadCPUs(thread);
+	if (!cpus.empty() && !pinCurrentThread(cpus))
+		LOG(WARNING) << "Unable to pin render thread " << thread << " to its CPUs.";
+}
+
+} /* namespace thread */
+} /* namespace mapcrafter */
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AFFINITY_H_
+#define AFFINITY_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace mapcrafter {
+namespace thread {
+
+/**
+ * How render threads are pinned to the processors:
+ * - none: threads are not pinned at all
+ * - cpu: every thread is pinned to a single CPU
+ * - numa: every thread is pinned to all CPUs of a NUMA node
+ */
+enum class ThreadPinning {
+	NONE,
+	CPU,
+	NUMA
+};
+
+std::ostream& operator<<(std::ostream& out, ThreadPinning pinning);
+
+/**
+ * Parses the name of a thread pinning mode (see operator<<). Returns false if the name
+ * is unknown.
+ */
+bool parseThreadPinning(const std::string& name, ThreadPinning& pinning);
+
+/**
+ * Parses a Linux CPU list like "0-3,8,10-11" to a sorted list of CPU numbers.
+ */
+std::vector<int> parseCPUList(const std::string& list);
+
+/**
+ * Returns the CPUs the calling thread is allowed to run on.
+ */
+std::vector<int> getAvailableCPUs();
+
+/**
+ * Returns the CPUs of every NUMA node which are also available to this process. If the
+ * system has no NUMA information, all available CPUs are returned as one node.
+ */
+std::vector<std::vector<int> > getNUMANodes();
+
+/**
+ * Restricts the calling thread to the specified CPUs. Returns false if that is not
+ * supported on this platform or failed.
+ */
+bool pinCurrentThread(const std::vector<int>& cpus);
+
+/**
+ * Distributes a count of threads to the NUMA nodes and CPUs of the system.
+ *
+ * Threads are spread over the NUMA nodes round-robin so every node gets about the same
+ * count of threads. Only nodes which actually get a thread are used, so you can
+ * allocate per-node data for every used node (see getNodeCount/getThreadNode).
+ */
+class ThreadPlacement {
+public:
+	ThreadPlacement(ThreadPinning pinning = ThreadPinning::NONE);
+	~ThreadPlacement();
+
+	/**
+	 * Assigns the threads to nodes/CPUs. The nodes are the ones of the system
+	 * (see getNUMANodes) if not specified otherwise.
+	 */
+	void assign(int threads);
+	void assign(int threads, const std::vector<std::vector<int> >& nodes);
+
+	ThreadPinning getPinning() const;
+
+	/**
+	 * Returns the count of threads assigned.
+	 */
+	int getThreadCount() const;
+
+	/**
+	 * Returns the count of nodes used by the assigned threads. That's always 1 if
+	 * threads are not pinned.
+	 */
+	int getNodeCount() const;
+
+	/**
+	 * Returns the node a thread is assigned to (0 <= node < getNodeCount()).
+	 */
+	int getThreadNode(int thread) const;
+
+	/**
+	 * Returns the CPUs of a used node.
+	 */
+	const std::vector<int>& getNodeCPUs(int node) const;
+
+	/**
+	 * Returns the CPUs a thread is pinned to, empty if the thread is not pinned.
+	 */
+	const std::vector<int>& getThreadCPUs(int thread) const;
+
+	/**
+	 * Pins the calling thread as the specified thread. Does nothing if threads are not
+	 * pinned.
+	 */
+	void pin(int thread) const;
+
+private:
+	ThreadPinning pinning;
+
+	// CPUs of the used nodes
+	std::vector<std::vector<int> > nodes;
+	// node and CPUs of every thread
+	std::vector<int> thread_nodes;
+	std::vector<std::vector<int> > thread_cpus;
+};
+
+} /* namespace thread */
+} /* namespace mapcrafter */
+
+#endif /* AFFINITY_H_ */
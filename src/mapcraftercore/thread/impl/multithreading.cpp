@@ -20,29 +20,60 @@
 #include "multithreading.h"
 
 #include "../../mc/worldcache.h"
+#include "../../renderer/fingerprints.h"
 #include "../../renderer/tileset.h"
 #include "../../util.h"
 
+#include <algorithm>
 #include <cstdlib>
 
 namespace mapcrafter {
 namespace thread {
 
 ThreadManager::ThreadManager()
-	: finished(false) {
+	: tile_set(nullptr), progress(nullptr), profile(nullptr), metrics(nullptr),
+	  chunk_fingerprints(nullptr), finished(false) {
 }
 
 ThreadManager::~ThreadManager() {
 }
 
+void ThreadManager::initialize(const renderer::TileSet* tile_set, int work_depth,
+		util::AtomicProgressCounter* progress, util::ProfileCounters* profile,
+		util::RenderMetrics* metrics, renderer::ChunkFingerprints* chunk_fingerprints) {
+	this->tile_set = tile_set;
+	this->progress = progress;
+	this->profile = profile;
+	this->metrics = metrics;
+	this->chunk_fingerprints = chunk_fingerprints;
+
+	// every required tile on the work zoom level or above is rendered as work,
+	// so count them at their parent tile
+	const std::vector<renderer::TilePath>& tiles = tile_set->getRequiredCompositeTiles();
+	remaining_children.reset(new std::atomic<int>[tiles.size()]);
+	tile_changed.reset(new std::atomic<char>[tiles.size()]);
+	for (size_t i = 0; i < tiles.size(); i++) {
+		remaining_children[i] = 0;
+		tile_changed[i] = 0;
+	}
+	for (size_t i = 0; i < tiles.size(); i++) {
+		if (tiles[i].getDepth() == 0 || tiles[i].getDepth() > work_depth)
+			continue;
+		auto parent = std::lower_bound(tiles.begin(), tiles.end(), tiles[i].parent());
+		remaining_children[parent - tiles.begin()]++;
+	}
+}
+
 void ThreadManager::addWork(const renderer::RenderWork& work) {
 	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
 	work_queue.push(work);
+	updateQueueDepth();
 }
 
 void ThreadManager::addExtraWork(const renderer::RenderWork& work) {
 	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
 	work_extra_queue.push(work);
+	updateQueueDepth();
 	condition_wait_jobs.notify_one();
 }
 
@@ -50,7 +81,6 @@ void ThreadManager::setFinished() {
 	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
 	this->finished = true;
 	condition_wait_jobs.notify_all();
-	condition_wait_results.notify_all();
 }
 
 bool ThreadManager::getWork(renderer::RenderWork& work) {
@@ -63,40 +93,82 @@ bool ThreadManager::getWork(renderer::RenderWork& work) {
 		work = work_extra_queue.pop();
 	else if (!work_queue.empty())
 		work = work_queue.pop();
+	updateQueueDepth();
 	return true;
 }
 
 void ThreadManager::workFinished(const renderer::RenderWork& work,
 		const renderer::RenderWorkResult& result) {
-	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
-	if (!result_queue.empty())
-		result_queue.push(result);
-	else {
-		result_queue.push(result);
-		condition_wait_results.notify_one();
+	if (profile != nullptr || chunk_fingerprints != nullptr) {
+		thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+		if (profile != nullptr)
+			profile->add(result.profile);
+		if (chunk_fingerprints != nullptr)
+			chunk_fingerprints->set(result.chunk_fingerprints);
+	}
+
+	const std::vector<renderer::TilePath>& tiles = tile_set->getRequiredCompositeTiles();
+	for (auto tile_it = work.tiles.begin(); tile_it != work.tiles.end(); ++tile_it) {
+		if (*tile_it == renderer::TilePath()) {
+			setFinished();
+			if (progress != nullptr)
+				progress->setFinished();
+			continue;
+		}
+
+		if (result.tiles_changed.count(*tile_it)) {
+			auto tile = std::lower_bound(tiles.begin(), tiles.end(), *tile_it);
+			tile_changed[tile - tiles.begin()] = 1;
+		}
+
+		// only the thread that rendered the last child of the parent tile
+		// sees the counter dropping to zero and enqueues the parent tile
+		renderer::TilePath parent = tile_it->parent();
+		auto parent_it = std::lower_bound(tiles.begin(), tiles.end(), parent);
+		if (--remaining_children[parent_it - tiles.begin()] != 0)
+			continue;
+
+		renderer::RenderWork parent_work;
+		parent_work.tiles.insert(parent);
+		for (int i = 1; i <= 4; i++) {
+			renderer::TilePath child = parent + i;
+			if (!tile_set->hasTile(child))
+				continue;
+			parent_work.tiles_skip.insert(child);
+			auto child_it = std::lower_bound(tiles.begin(), tiles.end(), child);
+			if (child_it != tiles.end() && *child_it == child
+					&& tile_changed[child_it - tiles.begin()])
+				parent_work.tiles_changed.insert(child);
+		}
+		addExtraWork(parent_work);
 	}
 }
 
-bool ThreadManager::getResult(renderer::RenderWorkResult& result) {
-	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
-	while (!finished && result_queue.empty())
-		condition_wait_results.wait(lock);
-	if (finished)
-		return false;
-	result = result_queue.pop();
-	return true;
+void ThreadManager::updateQueueDepth() {
+	if (metrics != nullptr)
+		metrics->queue_depth = work_queue.size() + work_extra_queue.size();
 }
 
 ThreadWorker::ThreadWorker(WorkerManager<renderer::RenderWork, renderer::RenderWorkResult>& manager,
-		const renderer::RenderContext& context)
-	: manager(manager), render_context(context) {
-	render_worker.setRenderContext(context);
+		const renderer::RenderContext& context, util::AtomicProgressCounter* progress,
+		const ThreadPlacement& placement, int thread_index)
+	: manager(manager), render_context(context), placement(placement),
+	  thread_index(thread_index) {
+	render_worker.setProgressCounter(progress);
 }
 
 ThreadWorker::~ThreadWorker() {
 }
 
 void ThreadWorker::operator()() {
+	// pin this thread first, memory allocated from now on is local to its node
+	placement.pin(thread_index);
+	int node = placement.getThreadNode(thread_index);
+	if (node < (int) render_context.node_block_images.size())
+		render_context.block_images = render_context.node_block_images[node];
+	render_context.initializeTileRenderer();
+	render_worker.setRenderContext(render_context);
+
 	renderer::RenderWork work;
 
 	while (manager.getWork(work)) {
@@ -107,8 +179,11 @@ void ThreadWorker::operator()() {
 	}
 }
 
-MultiThreadingDispatcher::MultiThreadingDispatcher(int threads)
-	: thread_count(threads) {
+MultiThreadingDispatcher::MultiThreadingDispatcher(int threads,
+		const ThreadPlacement& placement)
+	: thread_count(threads), placement(placement) {
+	if (this->placement.getThreadCount() != threads)
+		this->placement.assign(threads);
 }
 
 MultiThreadingDispatcher::~MultiThreadingDispatcher() {
@@ -116,13 +191,20 @@ MultiThreadingDispatcher::~MultiThreadingDispatcher() {
 
 void MultiThreadingDispatcher::dispatch(const renderer::RenderContext& context,
 		util::IProgressHandler* progress) {
-	auto tiles = context.tile_set->getRequiredCompositeTiles();
+	const auto& tiles = context.tile_set->getRequiredCompositeTiles();
 	if (tiles.size() == 0)
 		return;
 
+	// the composite tiles two zoom levels above the render tiles are the initial work,
+	// or the root tile if the tile set is not that deep
+	int work_depth = std::max(context.tile_set->getDepth() - 2, 0);
+	util::AtomicProgressCounter progress_counter;
+	manager.initialize(context.tile_set, work_depth, &progress_counter, context.profile,
+			context.metrics, context.chunk_fingerprints);
+
 	int jobs = 0;
 	for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it)
-		if (tile_it->getDepth() == context.tile_set->getDepth() - 2) {
+		if (tile_it->getDepth() == work_depth) {
 			renderer::RenderWork work;
 			work.tiles.insert(*tile_it);
 			manager.addWork(work);
@@ -132,42 +214,17 @@ void MultiThreadingDispatcher::dispatch(const renderer::RenderContext& context,
 	//int render_tiles = context.tile_set->getRequiredRenderTilesCount();
 	//LOG(INFO) << thread_count << " threads will render " << render_tiles << " render tiles.";
 
-	for (int i = 0; i < thread_count; i++) {
-		renderer::RenderContext thread_context = context;
-		thread_context.initializeTileRenderer();
-		threads.push_back(thread_ns::thread(ThreadWorker(manager, thread_context)));
-	}
-
-	progress->setMax(context.tile_set->getRequiredRenderTilesCount());
-	renderer::RenderWorkResult result;
-	while (manager.getResult(result)) {
-		progress->setValue(progress->getValue() + result.tiles_rendered);
-		for (auto tile_it = result.render_work.tiles.begin();
-				tile_it != result.render_work.tiles.end(); ++tile_it) {
-			rendered_tiles.insert(*tile_it);
-			if (*tile_it == renderer::TilePath()) {
-				manager.setFinished();
-				continue;
-			}
-
-			renderer::TilePath parent = tile_it->parent();
-			bool childs_rendered = true;
-			for (int i = 1; i <= 4; i++)
-				if (context.tile_set->isTileRequired(parent + i)
-						&& !rendered_tiles.count(parent + i)) {
-					childs_rendered = false;
-				}
-
-			if (childs_rendered) {
-				renderer::RenderWork work;
-				work.tiles.insert(parent);
-				for (int i = 1; i <= 4; i++)
-					if (context.tile_set->hasTile(parent + i))
-						work.tiles_skip.insert(parent + i);
-				manager.addExtraWork(work);
-			}
-		}
+	for (int i = 0; i < thread_count; i++)
+		threads.push_back(thread_ns::thread(ThreadWorker(manager, context,
+				&progress_counter, placement, i)));
+
+	// the render threads do everything on their own now,
+	// we just show the progress until the root tile is rendered
+	if (progress != nullptr) {
+		progress->setMax(context.tile_set->getRequiredRenderTilesCount());
+		progress->setValue(0);
 	}
+	progress_counter.wait(progress);
 
 	for (int i = 0; i < thread_count; i++)
 		threads[i].join();
@@ -21,23 +21,46 @@
 #define MULTITHREADING_H_
 
 #include "concurrentqueue.h"
+#include "../affinity.h"
 #include "../dispatcher.h"
 #include "../workermanager.h"
 #include "../../compat/thread.h"
 #include "../../renderer/tilerenderworker.h"
 
-#include <set>
+#include <atomic>
+#include <memory>
 #include <thread>
 #include <vector>
 
 namespace mapcrafter {
 namespace thread {
 
+/**
+ * Manages the render work of the render threads.
+ *
+ * Every required composite tile has a counter of its required children which are not
+ * rendered yet. When a render thread finishes a tile, it decreases the counter of the
+ * parent tile and the render thread that finishes the last child enqueues the parent
+ * tile as new work right away. Rendering is finished when the root tile is rendered.
+ */
 class ThreadManager : public WorkerManager<renderer::RenderWork, renderer::RenderWorkResult> {
 public:
 	ThreadManager();
 	virtual ~ThreadManager();
 
+	/**
+	 * Initializes the child counters of all required composite tiles of a tile set
+	 * above the specified zoom level (the zoom level of the initial work). The
+	 * progress counter is marked as finished when the root tile is rendered.
+	 * The profile counters and chunk fingerprints of the finished work are added to the
+	 * optional counters and fingerprints, the count of queued work is kept up to date
+	 * in the optional render metrics.
+	 */
+	void initialize(const renderer::TileSet* tile_set, int work_depth,
+			util::AtomicProgressCounter* progress, util::ProfileCounters* profile = nullptr,
+			util::RenderMetrics* metrics = nullptr,
+			renderer::ChunkFingerprints* chunk_fingerprints = nullptr);
+
 	void addWork(const renderer::RenderWork& work);
 	void addExtraWork(const renderer::RenderWork& work);
 	void setFinished();
@@ -45,20 +68,41 @@ public:
 	virtual bool getWork(renderer::RenderWork& work);
 	virtual void workFinished(const renderer::RenderWork& work, const renderer::RenderWorkResult& result);
 
-	bool getResult(renderer::RenderWorkResult& result);
 private:
+	/**
+	 * Updates the queue depth of the render metrics, the mutex must be locked.
+	 */
+	void updateQueueDepth();
+
 	ConcurrentQueue<renderer::RenderWork> work_queue, work_extra_queue;
-	ConcurrentQueue<renderer::RenderWorkResult> result_queue;
+
+	const renderer::TileSet* tile_set;
+	util::AtomicProgressCounter* progress;
+	util::ProfileCounters* profile;
+	util::RenderMetrics* metrics;
+	renderer::ChunkFingerprints* chunk_fingerprints;
+	// count of required children not rendered yet of every required composite tile,
+	// same order as the required composite tiles of the tile set
+	std::unique_ptr<std::atomic<int>[]> remaining_children;
+	// whether the pixels of a rendered required composite tile changed, set before
+	// the counter of the parent tile is decreased
+	std::unique_ptr<std::atomic<char>[]> tile_changed;
 
 	bool finished;
 	thread_ns::mutex mutex;
-	thread_ns::condition_variable condition_wait_jobs, condition_wait_results;
+	thread_ns::condition_variable condition_wait_jobs;
 };
 
 class ThreadWorker {
 public:
+	/**
+	 * Creates a render thread. The thread pins itself according to the thread
+	 * placement and creates its tile renderer (and world cache) after that, so they
+	 * are allocated on the NUMA node of the thread.
+	 */
 	ThreadWorker(WorkerManager<renderer::RenderWork, renderer::RenderWorkResult>& manager,
-			const renderer::RenderContext& context);
+			const renderer::RenderContext& context, util::AtomicProgressCounter* progress,
+			const ThreadPlacement& placement, int thread_index);
 	~ThreadWorker();
 
 	void operator()();
@@ -66,23 +110,29 @@ private:
 	WorkerManager<renderer::RenderWork, renderer::RenderWorkResult>& manager;
 
 	renderer::RenderContext render_context;
+	const ThreadPlacement& placement;
+	int thread_index;
 	renderer::TileRenderWorker render_worker;
 };
 
 class MultiThreadingDispatcher : public Dispatcher {
 public:
-	MultiThreadingDispatcher(int threads);
+	/**
+	 * Creates a dispatcher with a count of render threads. The threads are pinned
+	 * according to the specified thread placement (which is assigned for this count
+	 * of threads if that's not done yet).
+	 */
+	MultiThreadingDispatcher(int threads, const ThreadPlacement& placement = ThreadPlacement());
 	virtual ~MultiThreadingDispatcher();
 
 	virtual void dispatch(const renderer::RenderContext& context,
 			util::IProgressHandler* progress);
 private:
 	int thread_count;
+	ThreadPlacement placement;
 
 	ThreadManager manager;
 	std::vector<thread_ns::thread> threads;
-
-	std::set<renderer::TilePath> rendered_tiles;
 };
 
 } /* namespace thread */
@@ -20,11 +20,13 @@
 #include "singlethread.h"
 
 #include "../../mc/worldcache.h"
+#include "../../renderer/fingerprints.h"
 #include "../../renderer/tilerenderworker.h"
 #include "../../renderer/tileset.h"
 #include "../../util.h"
 
 #include <set>
+#include <thread>
 
 namespace mapcrafter {
 namespace thread {
@@ -46,11 +48,29 @@ void SingleThreadDispatcher::dispatch(const renderer::RenderContext& context,
 	renderer::RenderWork work;
 	work.tiles.insert(renderer::TilePath());
 
+	util::AtomicProgressCounter progress_counter;
 	renderer::TileRenderWorker worker;
 	worker.setRenderContext(context);
 	worker.setRenderWork(work);
-	worker.setProgressHandler(progress);
-	worker();
+	worker.setProgressCounter(&progress_counter);
+
+	// the worker renders in its own thread, so it doesn't have to deal with the
+	// progress handler, we just show the progress here until it is finished
+	thread_ns::thread worker_thread([&worker, &progress_counter]() {
+		worker();
+		progress_counter.setFinished();
+	});
+	if (progress != nullptr) {
+		progress->setMax(render_tiles);
+		progress->setValue(0);
+	}
+	progress_counter.wait(progress);
+	worker_thread.join();
+
+	if (context.profile != nullptr)
+		context.profile->add(worker.getRenderWorkResult().profile);
+	if (context.chunk_fingerprints != nullptr)
+		context.chunk_fingerprints->set(worker.getRenderWorkResult().chunk_fingerprints);
 }
 
 } /* namespace thread */
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include "../compat/thread.h"
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace mapcrafter {
+namespace thread {
+
+/**
+ * Calls function(i) for every i in [0, count) using up to the specified count of
+ * threads (the calling thread is one of them) and returns when all calls finished.
+ *
+ * The indices are handed out one after another to the threads, so the function must
+ * not rely on a specific order and has to take care of synchronization on its own if
+ * it touches shared data.
+ */
+template <typename Function>
+void parallelFor(size_t count, int threads, Function function) {
+	if (threads > (int) count)
+		threads = count;
+	if (threads <= 1) {
+		for (size_t i = 0; i < count; i++)
+			function(i);
+		return;
+	}
+
+	std::atomic<size_t> next(0);
+	auto work = [&next, count, &function]() {
+		for (size_t i = next++; i < count; i = next++)
+			function(i);
+	};
+
+	std::vector<thread_ns::thread> workers;
+	for (int i = 1; i < threads; i++)
+		workers.push_back(thread_ns::thread(work));
+	work();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+} /* namespace thread */
+} /* namespace mapcrafter */
+
+#endif /* PARALLEL_H_ */
@@ -32,11 +32,14 @@
 #include "compat/nullptr.h"
 
 #include "util/filesystem.h"
+#include "util/filewatcher.h"
 #include "util/json.h"
 #include "util/logging.h"
 #include "util/progress.h"
 #include "util/math.h"
+#include "util/metrics.h"
 #include "util/other.h"
+#include "util/profiling.h"
 #include "util/terminal.h"
 
 #endif /* UTIL_H_ */
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filewatcher.h"
+
+#include "../util.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#  include <poll.h>
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#endif
+
+namespace mapcrafter {
+namespace util {
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+FileWatcher::FileWatcher(const std::string& extension)
+	: extension(extension) {
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+		LOG(ERROR) << "Unable to initialize inotify.";
+}
+
+FileWatcher::~FileWatcher() {
+	if (fd >= 0)
+		close(fd);
+}
+
+bool FileWatcher::addDirectory(const fs::path& dir) {
+	if (fd < 0)
+		return false;
+	// region files are modified in place, but might also be replaced or deleted
+	int wd = inotify_add_watch(fd, dir.string().c_str(), IN_MODIFY | IN_CLOSE_WRITE
+			| IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+	if (wd < 0)
+		return false;
+	watches[wd] = dir;
+	directories.push_back(dir);
+	return true;
+}
+
+bool FileWatcher::wait(std::set<fs::path>& changed, int timeout) {
+	if (fd < 0)
+		return false;
+
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+	while (true) {
+		int remaining = -1;
+		if (timeout >= 0)
+			remaining = std::max(0, (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+					deadline - std::chrono::steady_clock::now()).count());
+		int ready = poll(&pfd, 1, remaining);
+		if (ready < 0 && errno != EINTR)
+			return false;
+
+		// read all pending events, the events are aligned in the buffer
+		alignas(struct inotify_event) char buffer[4096];
+		bool found = false;
+		while (ready > 0) {
+			ssize_t length = read(fd, buffer, sizeof(buffer));
+			if (length <= 0)
+				break;
+			for (char* ptr = buffer; ptr < buffer + length; ) {
+				const struct inotify_event* event = (const struct inotify_event*) ptr;
+				ptr += sizeof(struct inotify_event) + event->len;
+				if (event->len == 0 || !watches.count(event->wd))
+					continue;
+				fs::path file = watches[event->wd] / event->name;
+				if (!isRelevant(file))
+					continue;
+				changed.insert(file);
+				found = true;
+			}
+		}
+
+		// interrupted by a signal or only changes of other files, wait for the rest
+		// of the time
+		if (found)
+			return true;
+		if (timeout >= 0 && remaining == 0)
+			return false;
+	}
+}
+
+#else
+
+FileWatcher::FileWatcher(const std::string& extension)
+	: extension(extension) {
+}
+
+FileWatcher::~FileWatcher() {
+}
+
+bool FileWatcher::addDirectory(const fs::path& dir) {
+	if (!fs::is_directory(dir))
+		return false;
+	directories.push_back(dir);
+	scan(dir, files);
+	return true;
+}
+
+bool FileWatcher::wait(std::set<fs::path>& changed, int timeout) {
+	auto start = std::chrono::steady_clock::now();
+	while (true) {
+		FileStates current;
+		for (auto it = directories.begin(); it != directories.end(); ++it)
+			scan(*it, current);
+
+		// files which are new, changed or do not exist anymore
+		bool found = false;
+		for (auto it = current.begin(); it != current.end(); ++it) {
+			auto old = files.find(it->first);
+			if (old == files.end() || old->second != it->second) {
+				changed.insert(it->first);
+				found = true;
+			}
+		}
+		for (auto it = files.begin(); it != files.end(); ++it) {
+			if (!current.count(it->first)) {
+				changed.insert(it->first);
+				found = true;
+			}
+		}
+		files.swap(current);
+		if (found)
+			return true;
+
+		int waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - start).count();
+		if (timeout >= 0 && waited >= timeout)
+			return false;
+		int sleep = timeout >= 0 ? std::min(1000, timeout - waited) : 1000;
+		std::this_thread::sleep_for(std::chrono::milliseconds(sleep));
+	}
+}
+
+void FileWatcher::scan(const fs::path& dir, FileStates& states) const {
+	boost::system::error_code ec;
+	for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+		if (!isRelevant(it->path()))
+			continue;
+		boost::system::error_code ec_file;
+		std::time_t mtime = fs::last_write_time(it->path(), ec_file);
+		uintmax_t size = fs::file_size(it->path(), ec_file);
+		if (!ec_file)
+			states[it->path()] = std::make_pair(mtime, size);
+	}
+}
+
+#endif
+
+bool FileWatcher::isRelevant(const fs::path& file) const {
+	return extension.empty() || file.extension() == extension;
+}
+
+} /* namespace util */
+} /* namespace mapcrafter */
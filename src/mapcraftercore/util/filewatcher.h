@@ -0,0 +1,92 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILEWATCHER_H_
+#define FILEWATCHER_H_
+
+#include "../config.h"
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace util {
+
+/**
+ * Watches directories for files which are created, modified, moved or deleted.
+ *
+ * Uses inotify if available, the directories are polled every second otherwise.
+ * Only files with the specified extension (for example ".mca") are reported, or all
+ * files if the extension is empty.
+ */
+class FileWatcher {
+public:
+	FileWatcher(const std::string& extension = "");
+	~FileWatcher();
+
+	/**
+	 * Starts watching a directory (not recursively). Returns false if that's not
+	 * possible.
+	 */
+	bool addDirectory(const fs::path& dir);
+
+	/**
+	 * Waits up to timeout milliseconds (or forever if negative) for changed files in
+	 * the watched directories and adds them to the set. Returns whether files changed,
+	 * changes of other files and interruptions by signals don't end the waiting.
+	 */
+	bool wait(std::set<fs::path>& changed, int timeout = -1);
+
+private:
+	/**
+	 * Returns whether changes of a file are reported (i.e. it has the extension).
+	 */
+	bool isRelevant(const fs::path& file) const;
+
+	std::string extension;
+	std::vector<fs::path> directories;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	int fd;
+	// inotify watch descriptor -> watched directory
+	std::map<int, fs::path> watches;
+#else
+	typedef std::map<fs::path, std::pair<std::time_t, uintmax_t> > FileStates;
+
+	/**
+	 * Adds the modification times and sizes of the files of a directory.
+	 */
+	void scan(const fs::path& dir, FileStates& states) const;
+
+	// modification times and sizes of the files when they were checked the last time
+	FileStates files;
+#endif
+};
+
+} /* namespace util */
+} /* namespace mapcrafter */
+
+#endif /* FILEWATCHER_H_ */
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "metrics.h"
+
+#include "json.h"
+#include "logging.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace mapcrafter {
+namespace util {
+
+RenderMetrics::RenderMetrics() {
+	reset();
+}
+
+void RenderMetrics::reset() {
+	chunks_decoded = 0;
+	chunk_cache_hits = 0;
+	bytes_written = 0;
+	queue_depth = 0;
+}
+
+MetricsSample::MetricsSample()
+	: tiles_rendered(0), tiles_total(0), tiles_per_second(0), chunks_decoded(0),
+	  chunk_cache_hits(0), bytes_written(0), queue_depth(0), elapsed(0), eta(-1),
+	  finished(false) {
+}
+
+double MetricsSample::getChunkCacheHitRate() const {
+	uint64_t lookups = chunk_cache_hits + chunks_decoded;
+	if (lookups == 0)
+		return 0;
+	return (double) chunk_cache_hits / lookups;
+}
+
+std::ostream& operator<<(std::ostream& out, MetricsFormat format) {
+	if (format == MetricsFormat::PROMETHEUS)
+		return out << "prometheus";
+	return out << "jsonl";
+}
+
+bool parseMetricsFormat(const std::string& name, MetricsFormat& format) {
+	if (name == "prometheus")
+		format = MetricsFormat::PROMETHEUS;
+	else if (name == "jsonl")
+		format = MetricsFormat::JSON_LINES;
+	else
+		return false;
+	return true;
+}
+
+MetricsSink::MetricsSink(const fs::path& file, MetricsFormat format)
+	: file(file), format(format), warned(false) {
+}
+
+MetricsSink::~MetricsSink() {
+}
+
+void MetricsSink::write(const std::string& map, const std::string& rotation,
+		const MetricsSample& sample) {
+	samples[std::make_pair(map, rotation)] = sample;
+	if (format == MetricsFormat::PROMETHEUS)
+		writePrometheus();
+	else
+		writeJSONLine(map, rotation, sample);
+}
+
+namespace {
+
+/**
+ * Escapes a Prometheus label value.
+ */
+std::string escapeLabel(const std::string& value) {
+	std::string escaped;
+	for (size_t i = 0; i < value.size(); i++) {
+		if (value[i] == '\\' || value[i] == '"')
+			escaped += '\\';
+		if (value[i] == '\n')
+			escaped += "\\n";
+		else
+			escaped += value[i];
+	}
+	return escaped;
+}
+
+}
+
+void MetricsSink::writePrometheus() {
+	struct Metric {
+		const char* name;
+		const char* help;
+		double (*get)(const MetricsSample&);
+	};
+	static const Metric METRICS[] = {
+		{"tiles_rendered", "Render tiles rendered so far.",
+			[](const MetricsSample& s) { return (double) s.tiles_rendered; }},
+		{"tiles_total", "Render tiles to render.",
+			[](const MetricsSample& s) { return (double) s.tiles_total; }},
+		{"tiles_per_second", "Average count of render tiles rendered per second.",
+			[](const MetricsSample& s) { return s.tiles_per_second; }},
+		{"chunks_decoded", "Chunks read from the region files.",
+			[](const MetricsSample& s) { return (double) s.chunks_decoded; }},
+		{"chunk_cache_hit_ratio", "Share of the chunk lookups served by the chunk caches.",
+			[](const MetricsSample& s) { return s.getChunkCacheHitRate(); }},
+		{"bytes_written", "Bytes of the written tile images.",
+			[](const MetricsSample& s) { return (double) s.bytes_written; }},
+		{"queue_depth", "Render work waiting for a render thread.",
+			[](const MetricsSample& s) { return (double) s.queue_depth; }},
+		{"elapsed_seconds", "Seconds since the rendering started.",
+			[](const MetricsSample& s) { return (double) s.elapsed; }},
+		{"eta_seconds", "Estimated seconds until the rendering is finished, -1 if unknown.",
+			[](const MetricsSample& s) { return (double) s.eta; }},
+		{"finished", "Whether the rendering is finished.",
+			[](const MetricsSample& s) { return s.finished ? 1.0 : 0.0; }},
+	};
+
+	// enough precision to write the byte counts exactly
+	std::ostringstream out;
+	out.precision(15);
+	for (size_t i = 0; i < sizeof(METRICS) / sizeof(METRICS[0]); i++) {
+		std::string name = std::string("mapcrafter_") + METRICS[i].name;
+		out << "# HELP " << name << " " << METRICS[i].help << "\n";
+		out << "# TYPE " << name << " gauge\n";
+		for (auto it = samples.begin(); it != samples.end(); ++it)
+			out << name << "{map=\"" << escapeLabel(it->first.first) << "\",rotation=\""
+					<< escapeLabel(it->first.second) << "\"} "
+					<< METRICS[i].get(it->second) << "\n";
+	}
+
+	fs::path temp = file;
+	temp += ".tmp";
+	std::ofstream stream(temp.string().c_str());
+	stream << out.str();
+	stream.close();
+	boost::system::error_code ec;
+	if (stream)
+		fs::rename(temp, file, ec);
+	if ((!stream || ec) && !warned) {
+		LOG(WARNING) << "Unable to write metrics file '" << file.string() << "'.";
+		warned = true;
+	}
+}
+
+void MetricsSink::writeJSONLine(const std::string& map, const std::string& rotation,
+		const MetricsSample& sample) {
+	picojson::object json;
+	json["time"] = picojson::value((double) std::time(nullptr));
+	json["map"] = picojson::value(map);
+	json["rotation"] = picojson::value(rotation);
+	json["tiles_rendered"] = picojson::value((double) sample.tiles_rendered);
+	json["tiles_total"] = picojson::value((double) sample.tiles_total);
+	json["tiles_per_second"] = picojson::value(sample.tiles_per_second);
+	json["chunks_decoded"] = picojson::value((double) sample.chunks_decoded);
+	json["chunk_cache_hit_ratio"] = picojson::value(sample.getChunkCacheHitRate());
+	json["bytes_written"] = picojson::value((double) sample.bytes_written);
+	json["queue_depth"] = picojson::value((double) sample.queue_depth);
+	json["elapsed_seconds"] = picojson::value((double) sample.elapsed);
+	json["eta_seconds"] = picojson::value((double) sample.eta);
+	json["finished"] = picojson::value(sample.finished);
+
+	std::ofstream stream(file.string().c_str(), std::ios::app);
+	stream << picojson::value(json).serialize() << "\n";
+	if (!stream && !warned) {
+		LOG(WARNING) << "Unable to write metrics file '" << file.string() << "'.";
+		warned = true;
+	}
+}
+
+MetricsProgressHandler::MetricsProgressHandler(MetricsSink* sink,
+		const std::string& map, const std::string& rotation,
+		const RenderMetrics* metrics, int interval)
+	: sink(sink), map(map), rotation(rotation), metrics(metrics), interval(interval),
+	  start(std::time(nullptr)), last_write(0) {
+}
+
+MetricsProgressHandler::~MetricsProgressHandler() {
+}
+
+void MetricsProgressHandler::setValue(int value) {
+	this->value = value;
+	if (std::time(nullptr) >= last_write + interval)
+		write(false);
+}
+
+void MetricsProgressHandler::finish() {
+	write(true);
+}
+
+void MetricsProgressHandler::write(bool finished) {
+	std::time_t now = std::time(nullptr);
+	last_write = now;
+
+	MetricsSample sample;
+	sample.tiles_rendered = value;
+	sample.tiles_total = max;
+	sample.elapsed = now - start;
+	if (sample.elapsed > 0)
+		sample.tiles_per_second = (double) value / sample.elapsed;
+	if (!finished && value != 0 && sample.tiles_per_second > 0)
+		sample.eta = (max - value) / sample.tiles_per_second;
+	if (finished)
+		sample.eta = 0;
+	if (metrics != nullptr) {
+		sample.chunks_decoded = metrics->chunks_decoded;
+		sample.chunk_cache_hits = metrics->chunk_cache_hits;
+		sample.bytes_written = metrics->bytes_written;
+		sample.queue_depth = metrics->queue_depth;
+	}
+	sample.finished = finished;
+	sink->write(map, rotation, sample);
+}
+
+} /* namespace util */
+} /* namespace mapcrafter */
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include "progress.h"
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace util {
+
+/**
+ * Counters of a rendering which are updated by the render threads.
+ */
+struct RenderMetrics {
+	RenderMetrics();
+
+	/**
+	 * Resets all counters to zero.
+	 */
+	void reset();
+
+	// chunks read from the region files and chunk lookups served by the chunk caches
+	std::atomic<uint64_t> chunks_decoded, chunk_cache_hits;
+	// bytes of the written tile images
+	std::atomic<uint64_t> bytes_written;
+	// count of render work waiting for a render thread
+	std::atomic<int> queue_depth;
+};
+
+/**
+ * A snapshot of the progress and metrics of the rendering of a map rotation.
+ */
+struct MetricsSample {
+	MetricsSample();
+
+	int tiles_rendered, tiles_total;
+	double tiles_per_second;
+	uint64_t chunks_decoded, chunk_cache_hits, bytes_written;
+	int queue_depth;
+	// seconds since the rendering started and estimated seconds remaining (-1 if unknown)
+	int elapsed, eta;
+	bool finished;
+
+	/**
+	 * Returns the share of the chunk lookups served by the chunk caches (0 if there
+	 * were none).
+	 */
+	double getChunkCacheHitRate() const;
+};
+
+enum class MetricsFormat {
+	// a file for the textfile collector of the Prometheus node exporter
+	PROMETHEUS,
+	// a JSON object per line, appended to the file
+	JSON_LINES
+};
+
+std::ostream& operator<<(std::ostream& out, MetricsFormat format);
+
+/**
+ * Parses the name of a metrics format (see operator<<). Returns false if the name is
+ * unknown.
+ */
+bool parseMetricsFormat(const std::string& name, MetricsFormat& format);
+
+/**
+ * Writes metrics samples of map rotations to a file.
+ *
+ * A Prometheus file always contains the last sample of every map rotation, it is
+ * written to a temporary file first and then renamed, so a scraper never sees a
+ * partially written file. With JSON lines every sample is appended to the file.
+ */
+class MetricsSink {
+public:
+	MetricsSink(const fs::path& file, MetricsFormat format);
+	~MetricsSink();
+
+	/**
+	 * Adds the sample of a map rotation and writes it to the file.
+	 */
+	void write(const std::string& map, const std::string& rotation,
+			const MetricsSample& sample);
+
+private:
+	void writePrometheus();
+	void writeJSONLine(const std::string& map, const std::string& rotation,
+			const MetricsSample& sample);
+
+	fs::path file;
+	MetricsFormat format;
+	// (map, rotation) -> last sample
+	std::map<std::pair<std::string, std::string>, MetricsSample> samples;
+	bool warned;
+};
+
+/**
+ * A progress handler which passes the progress of the rendering of a map rotation and
+ * the render metrics to a metrics sink every interval seconds.
+ */
+class MetricsProgressHandler : public DummyProgressHandler {
+public:
+	MetricsProgressHandler(MetricsSink* sink, const std::string& map,
+			const std::string& rotation, const RenderMetrics* metrics, int interval = 10);
+	virtual ~MetricsProgressHandler();
+
+	virtual void setValue(int value);
+
+	/**
+	 * Writes the last sample, marked as finished.
+	 */
+	void finish();
+
+private:
+	void write(bool finished);
+
+	MetricsSink* sink;
+	std::string map, rotation;
+	const RenderMetrics* metrics;
+	int interval;
+
+	std::time_t start, last_write;
+};
+
+} /* namespace util */
+} /* namespace mapcrafter */
+
+#endif /* METRICS_H_ */
@@ -22,6 +22,7 @@
 #include "../config.h"
 
 #include <cctype>
+#include <cstring>
 
 #ifdef HAVE_ENDIAN_H
 # ifdef ENDIAN_H_FREEBSD
@@ -211,5 +212,43 @@ bool endswith(const std::string& str, const std::string& end) {
 	return str.substr(str.size() - end.size(), end.size()) == end;
 }
 
+namespace {
+
+// finalizer of MurmurHash3, mixes all bits of a 64-bit word
+inline uint64_t mix64(uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+inline uint64_t hashWord(uint64_t hash, uint64_t word) {
+	hash ^= mix64(word);
+	return ((hash << 27) | (hash >> 37)) * 0x9e3779b97f4a7c15ULL;
+}
+
+}
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	uint64_t hash = hashWord(seed, size);
+
+	// hash eight bytes at once, the remaining bytes are padded with zeros
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes + i, 8);
+		hash = hashWord(hash, word);
+	}
+	if (i < size) {
+		uint64_t word = 0;
+		std::memcpy(&word, bytes + i, size - i);
+		hash = hashWord(hash, word);
+	}
+	return mix64(hash);
+}
+
 } /* namespace util */
 } /* namespace mapcrafter */
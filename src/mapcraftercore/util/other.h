@@ -20,6 +20,7 @@
 #ifndef OTHER_H_
 #define OTHER_H_
 
+#include <cstdint>
 #include <string>
 #include <sstream>
 #include <boost/filesystem.hpp>
@@ -94,6 +95,13 @@ std::string replaceAll(const std::string& str, const std::string& from, const st
 bool startswith(const std::string& str, const std::string& start);
 bool endswith(const std::string& str, const std::string& end);
 
+/**
+ * Computes a fast 64-bit hash of a memory block. It is not a cryptographic hash, but
+ * good enough to detect whether some data has changed. You can hash multiple blocks
+ * by passing the hash of the previous block as seed.
+ */
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
 /**
  * TODO this is unused, maybe use it for the config option values? ... or remove it
  */
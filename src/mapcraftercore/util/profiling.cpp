@@ -0,0 +1,156 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "profiling.h"
+
+#include "../compat/thread.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#ifdef OPT_USE_BOOST_THREAD
+#  include <boost/thread/tss.hpp>
+#endif
+
+namespace mapcrafter {
+namespace util {
+
+namespace {
+
+const char* PROFILE_STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+	"region_read", "decompress", "nbt_parse", "chunk_build", "row_walk",
+	"check_neighbors", "render_mode_draw", "blit", "composite", "encode", "write"
+};
+
+/**
+ * The counters of a thread and its innermost running timer.
+ */
+struct ProfileThreadState {
+	ProfileThreadState() : counters(nullptr), active(nullptr) {}
+
+	ProfileCounters* counters;
+	ProfileTimer* active;
+};
+
+#ifdef OPT_USE_BOOST_THREAD
+boost::thread_specific_ptr<ProfileThreadState> thread_states;
+
+ProfileThreadState& getThreadState() {
+	if (thread_states.get() == nullptr)
+		thread_states.reset(new ProfileThreadState);
+	return *thread_states;
+}
+#else
+thread_local ProfileThreadState thread_state;
+
+ProfileThreadState& getThreadState() {
+	return thread_state;
+}
+#endif
+
+}
+
+std::ostream& operator<<(std::ostream& out, ProfileStage stage) {
+	return out << PROFILE_STAGE_NAMES[static_cast<int>(stage)];
+}
+
+ProfileCounters::ProfileCounters() {
+	std::fill(counts, counts + PROFILE_STAGE_COUNT, 0);
+	std::fill(times, times + PROFILE_STAGE_COUNT, 0);
+}
+
+void ProfileCounters::add(const ProfileCounters& other) {
+	for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+		counts[i] += other.counts[i];
+		times[i] += other.times[i];
+	}
+}
+
+uint64_t ProfileCounters::getTotalTime() const {
+	uint64_t total = 0;
+	for (int i = 0; i < PROFILE_STAGE_COUNT; i++)
+		total += times[i];
+	return total;
+}
+
+void ProfileCounters::log(const std::string& title) const {
+	uint64_t total = getTotalTime();
+	LOG(INFO) << title << " (" << std::fixed << std::setprecision(3)
+			<< total / 1e9 << " seconds in all threads):";
+	for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+		if (counts[i] == 0)
+			continue;
+		std::ostringstream line;
+		line << "  " << std::left << std::setw(18) << static_cast<ProfileStage>(i)
+				<< std::right << std::fixed
+				<< std::setw(10) << std::setprecision(3) << times[i] / 1e9 << " s "
+				<< std::setw(6) << std::setprecision(1) << 100.0 * times[i] / total << " % "
+				<< std::setw(12) << counts[i] << " calls";
+		LOG(INFO) << line.str();
+	}
+}
+
+picojson::value ProfileCounters::toJSON() const {
+	picojson::object stages;
+	for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+		picojson::object stage;
+		stage["count"] = picojson::value((double) counts[i]);
+		stage["seconds"] = picojson::value(times[i] / 1e9);
+		stages[PROFILE_STAGE_NAMES[i]] = picojson::value(stage);
+	}
+	return picojson::value(stages);
+}
+
+bool Profiler::enabled = false;
+
+void Profiler::setEnabled(bool enabled) {
+	Profiler::enabled = enabled;
+}
+
+void Profiler::setThreadCounters(ProfileCounters* counters) {
+	ProfileThreadState& state = getThreadState();
+	state.counters = counters;
+	state.active = nullptr;
+}
+
+void ProfileTimer::start(ProfileStage stage) {
+	ProfileThreadState& state = getThreadState();
+	if (state.counters == nullptr)
+		return;
+	counters = state.counters;
+	parent = state.active;
+	state.active = this;
+	this->stage = static_cast<int>(stage);
+	nested_time = 0;
+	start_time = std::chrono::steady_clock::now();
+}
+
+void ProfileTimer::stop() {
+	uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start_time).count();
+	counters->counts[stage]++;
+	counters->times[stage] += elapsed - std::min(elapsed, nested_time);
+	if (parent != nullptr)
+		parent->nested_time += elapsed;
+	getThreadState().active = parent;
+}
+
+} /* namespace util */
+} /* namespace mapcrafter */
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PROFILING_H_
+#define PROFILING_H_
+
+#include "picojson.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace mapcrafter {
+namespace util {
+
+/**
+ * The stages of rendering which are measured when profiling.
+ */
+enum class ProfileStage {
+	// reading a region file into memory
+	REGION_READ,
+	// decompressing the NBT data of a chunk
+	DECOMPRESS,
+	// parsing the NBT data of a chunk
+	NBT_PARSE,
+	// creating the chunk from the NBT data (sections, heights, ...)
+	CHUNK_BUILD,
+	// going through the blocks of a tile and looking them up
+	ROW_WALK,
+	// looking at the neighbors of blocks (TileRenderer::checkNeighbors)
+	CHECK_NEIGHBORS,
+	// drawing the render modes to the block images
+	RENDER_MODE_DRAW,
+	// blitting the block images to the tile
+	BLIT,
+	// composing a tile from its four children
+	COMPOSITE,
+	// encoding a tile image
+	ENCODE,
+	// writing a tile image to disk
+	WRITE
+};
+
+const int PROFILE_STAGE_COUNT = 11;
+
+std::ostream& operator<<(std::ostream& out, ProfileStage stage);
+
+/**
+ * Call counts and times of the render stages, collected by one or more threads.
+ *
+ * The times of a stage do not include the times of other stages measured while it is
+ * running (for example the blitting during the row walk), so the times of all stages
+ * add up to the total measured time.
+ */
+struct ProfileCounters {
+	ProfileCounters();
+
+	/**
+	 * Adds the counts and times of other counters to these ones.
+	 */
+	void add(const ProfileCounters& other);
+
+	/**
+	 * Returns the sum of the times of all stages (in nanoseconds).
+	 */
+	uint64_t getTotalTime() const;
+
+	/**
+	 * Logs the time of every stage and its share of the total time.
+	 */
+	void log(const std::string& title) const;
+
+	/**
+	 * Returns the counts and times (in seconds) of the stages as json object.
+	 */
+	picojson::value toJSON() const;
+
+	// how often every stage was measured
+	uint64_t counts[PROFILE_STAGE_COUNT];
+	// time of every stage in nanoseconds
+	uint64_t times[PROFILE_STAGE_COUNT];
+};
+
+class ProfileTimer;
+
+/**
+ * Profiling is enabled globally, but only threads which have counters collect
+ * measurements. Timers are not much more than a check of a flag when profiling is
+ * disabled.
+ */
+class Profiler {
+public:
+	/**
+	 * Enables/disables profiling. Do this before the render threads are started.
+	 */
+	static void setEnabled(bool enabled);
+
+	static bool isEnabled() {
+		return enabled;
+	}
+
+	/**
+	 * Sets the counters the timers of the calling thread add their measurements to, or
+	 * nullptr to stop measuring in this thread. Must not be called while a timer of the
+	 * thread is running.
+	 */
+	static void setThreadCounters(ProfileCounters* counters);
+
+private:
+	static bool enabled;
+
+	friend class ProfileTimer;
+};
+
+/**
+ * Measures a stage from its construction to its destruction if profiling is enabled
+ * and the current thread has profile counters.
+ */
+class ProfileTimer {
+public:
+	ProfileTimer(ProfileStage stage)
+		: counters(nullptr) {
+		if (Profiler::enabled)
+			start(stage);
+	}
+
+	~ProfileTimer() {
+		if (counters != nullptr)
+			stop();
+	}
+
+private:
+	void start(ProfileStage stage);
+	void stop();
+
+	ProfileCounters* counters;
+	// the timer of the enclosing stage, its time does not include the time of this one
+	ProfileTimer* parent;
+	int stage;
+	std::chrono::steady_clock::time_point start_time;
+	// time of the stages measured while this one was running
+	uint64_t nested_time;
+};
+
+} /* namespace util */
+} /* namespace mapcrafter */
+
+#endif /* PROFILING_H_ */
@@ -124,6 +124,42 @@ void DummyProgressHandler::setValue(int value) {
 	this->value = value;
 }
 
+AtomicProgressCounter::AtomicProgressCounter()
+	: value(0), finished(false) {
+}
+
+AtomicProgressCounter::~AtomicProgressCounter() {
+}
+
+void AtomicProgressCounter::add(int value) {
+	this->value += value;
+}
+
+int AtomicProgressCounter::getValue() const {
+	return value;
+}
+
+void AtomicProgressCounter::setFinished() {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	finished = true;
+	condition_finished.notify_all();
+}
+
+void AtomicProgressCounter::wait(IProgressHandler* progress, int interval) {
+	bool done = false;
+	while (!done) {
+		{
+			thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+			if (!finished)
+				condition_finished.wait_for(lock, thread_ns::chrono::milliseconds(interval));
+			done = finished;
+		}
+		// don't hold the lock while the progress handler outputs something
+		if (progress != nullptr)
+			progress->setValue(value);
+	}
+}
+
 AbstractOutputProgressHandler::AbstractOutputProgressHandler()
 	: start(std::time(nullptr)), last_update(0), last_value(0), last_percentage(0) {
 }
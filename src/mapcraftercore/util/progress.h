@@ -20,6 +20,9 @@
 #ifndef PROGRESS_H_
 #define PROGRESS_H_
 
+#include "../compat/thread.h"
+
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -81,6 +84,47 @@ protected:
 	int max, value;
 };
 
+/**
+ * A progress counter that can be increased by multiple worker threads at the same time
+ * without locking. The workers don't pass the progress to a progress handler, instead
+ * the thread waiting for the workers samples the counter periodically and passes the
+ * value to a progress handler.
+ */
+class AtomicProgressCounter {
+public:
+	AtomicProgressCounter();
+	~AtomicProgressCounter();
+
+	/**
+	 * Increases the progress value. Can be called by any thread.
+	 */
+	void add(int value);
+
+	/**
+	 * Returns the current progress value.
+	 */
+	int getValue() const;
+
+	/**
+	 * Marks the progress as finished. Can be called by any thread.
+	 */
+	void setFinished();
+
+	/**
+	 * Blocks until the progress is marked as finished. Meanwhile the progress value is
+	 * passed to the progress handler (may be a nullptr) every interval milliseconds,
+	 * and once more when finished.
+	 */
+	void wait(IProgressHandler* progress, int interval = 250);
+
+private:
+	std::atomic<int> value;
+
+	bool finished;
+	thread_ns::mutex mutex;
+	thread_ns::condition_variable condition_finished;
+};
+
 class AbstractOutputProgressHandler : public DummyProgressHandler {
 public:
 	AbstractOutputProgressHandler();
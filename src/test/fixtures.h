@@ -0,0 +1,39 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIXTURES_H_
+#define FIXTURES_H_
+
+#include "../mapcraftercore/mc/world.h"
+
+#include <boost/test/unit_test.hpp>
+
+/**
+ * Fixture for the test cases which work on the test world in the data/ directory.
+ */
+struct WorldFixture {
+	WorldFixture()
+		: world("data") {
+		BOOST_REQUIRE(world.load());
+	}
+
+	mapcrafter::mc::World world;
+};
+
+#endif /* FIXTURES_H_ */
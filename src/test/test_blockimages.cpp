@@ -0,0 +1,46 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../mapcraftercore/renderer/blockimages.h"
+
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+using namespace mapcrafter::renderer;
+
+BOOST_AUTO_TEST_CASE(blockimages_blockImageTable) {
+	auto key = [](uint32_t id, uint32_t data) { return id | (data << 16); };
+	std::vector<uint32_t> keys = {
+		key(1, 0), key(1, 6), key(2, EDGE_NORTH), key(2, 3 | EDGE_BOTTOM),
+		key(55, REDSTONE_POWERED | REDSTONE_TOPWEST), key(300, 0xffff),
+	};
+	BlockImageTable table;
+	table.build(keys);
+
+	for (size_t i = 0; i < keys.size(); i++)
+		BOOST_CHECK_EQUAL(table.get(keys[i] & 0xffff, keys[i] >> 16), (int) i);
+	BOOST_CHECK_EQUAL(table.get(0, 0), -1);
+	BOOST_CHECK_EQUAL(table.get(1, 3), -1);
+	BOOST_CHECK_EQUAL(table.get(1, 7), -1);
+	BOOST_CHECK_EQUAL(table.get(1, EDGE_NORTH), -1);
+	BOOST_CHECK_EQUAL(table.get(2, 3), -1);
+	BOOST_CHECK_EQUAL(table.get(2, 3 | EDGE_NORTH), -1);
+	BOOST_CHECK_EQUAL(table.get(300, 0), -1);
+	BOOST_CHECK_EQUAL(table.get(301, 0), -1);
+}
@@ -50,3 +50,38 @@ BOOST_AUTO_TEST_CASE(image_testIO) {
 		}
 	}
 }
+
+BOOST_AUTO_TEST_CASE(image_testBlur) {
+	renderer::RGBAImage src(23, 17);
+	for (int x = 0; x < src.getWidth(); x++)
+		for (int y = 0; y < src.getHeight(); y++)
+			src.setPixel(x, y, renderer::rgba(rand() % 256, rand() % 256,
+					rand() % 256, rand() % 256));
+
+	// every pixel must be the average of the pixels around it (inside the image)
+	for (int radius = 0; radius < 4; radius++) {
+		renderer::RGBAImage dest;
+		src.blur(dest, radius);
+		BOOST_CHECK_EQUAL(dest.getWidth(), src.getWidth());
+		BOOST_CHECK_EQUAL(dest.getHeight(), src.getHeight());
+
+		for (int x = 0; x < src.getWidth(); x++) {
+			for (int y = 0; y < src.getHeight(); y++) {
+				int r = 0, g = 0, b = 0, a = 0, count = 0;
+				for (int x2 = x - radius; x2 <= x + radius; x2++)
+					for (int y2 = y - radius; y2 <= y + radius; y2++) {
+						if (x2 < 0 || y2 < 0 || x2 >= src.getWidth() || y2 >= src.getHeight())
+							continue;
+						renderer::RGBAPixel pixel = src.getPixel(x2, y2);
+						r += renderer::rgba_red(pixel);
+						g += renderer::rgba_green(pixel);
+						b += renderer::rgba_blue(pixel);
+						a += renderer::rgba_alpha(pixel);
+						count++;
+					}
+				BOOST_CHECK_EQUAL(dest.getPixel(x, y),
+						renderer::rgba(r / count, g / count, b / count, a / count));
+			}
+		}
+	}
+}
@@ -51,3 +51,27 @@ BOOST_AUTO_TEST_CASE(region_testReadWrite) {
 	}
 
 }
+
+BOOST_AUTO_TEST_CASE(region_testChunkHeights) {
+	// the heights must be the ones of the highest not-air blocks, also if rotated
+	for (int rotation = 0; rotation < 4; rotation++) {
+		mc::RegionFile in("data/region/r.-1.0.mca");
+		in.setRotation(rotation);
+		BOOST_REQUIRE(in.read());
+
+		auto chunks = in.getContainingChunks();
+		for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+			mc::Chunk chunk;
+			BOOST_REQUIRE(in.loadChunk(*it, chunk) == mc::RegionFile::CHUNK_OK);
+			for (int x = 0; x < 16; x++)
+				for (int z = 0; z < 16; z++) {
+					mc::LocalBlockPos pos(x, z, mc::CHUNK_HEIGHT * 16 - 1);
+					while (pos.y >= 0 && chunk.getBlockID(pos) == 0)
+						pos.y--;
+					BOOST_CHECK_MESSAGE(chunk.getHeightAt(pos) == pos.y, "Height of " << pos
+							<< " in chunk " << *it << " (rotation " << rotation
+							<< ") must be " << pos.y << ", not " << chunk.getHeightAt(pos) << "!");
+				}
+		}
+	}
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../mapcraftercore/thread/affinity.h"
+
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+namespace thread = mapcrafter::thread;
+
+BOOST_AUTO_TEST_CASE(thread_testCPUList) {
+	std::vector<int> expected = {0, 1, 2, 3, 8, 10, 11};
+	std::vector<int> cpus = thread::parseCPUList("0-3,8,10-11\n");
+	BOOST_CHECK_EQUAL_COLLECTIONS(cpus.begin(), cpus.end(), expected.begin(), expected.end());
+
+	BOOST_CHECK(thread::parseCPUList("").empty());
+	BOOST_CHECK(thread::parseCPUList("0-x").empty());
+}
+
+BOOST_AUTO_TEST_CASE(thread_testPlacement) {
+	std::vector<std::vector<int> > nodes = {{0, 1, 2, 3}, {4, 5, 6, 7}};
+
+	// not pinned: one node, no CPUs
+	thread::ThreadPlacement none;
+	none.assign(4, nodes);
+	BOOST_CHECK_EQUAL(none.getNodeCount(), 1);
+	for (int i = 0; i < 4; i++) {
+		BOOST_CHECK_EQUAL(none.getThreadNode(i), 0);
+		BOOST_CHECK(none.getThreadCPUs(i).empty());
+	}
+
+	// pinned to single CPUs: threads alternate between the nodes
+	thread::ThreadPlacement cpu(thread::ThreadPinning::CPU);
+	cpu.assign(5, nodes);
+	BOOST_CHECK_EQUAL(cpu.getNodeCount(), 2);
+	int expected_cpus[] = {0, 4, 1, 5, 2};
+	for (int i = 0; i < 5; i++) {
+		BOOST_CHECK_EQUAL(cpu.getThreadNode(i), i % 2);
+		BOOST_REQUIRE_EQUAL(cpu.getThreadCPUs(i).size(), 1);
+		BOOST_CHECK_EQUAL(cpu.getThreadCPUs(i)[0], expected_cpus[i]);
+	}
+
+	// pinned to nodes, only one node is used by a single thread
+	thread::ThreadPlacement numa(thread::ThreadPinning::NUMA);
+	numa.assign(1, nodes);
+	BOOST_CHECK_EQUAL(numa.getNodeCount(), 1);
+	BOOST_CHECK(numa.getThreadCPUs(0) == nodes[0]);
+	numa.assign(3, nodes);
+	BOOST_CHECK_EQUAL(numa.getNodeCount(), 2);
+	BOOST_CHECK(numa.getThreadCPUs(2) == nodes[0]);
+	BOOST_CHECK(numa.getThreadCPUs(1) == nodes[1]);
+}
@@ -17,11 +17,22 @@
  * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "fixtures.h"
+#include "../mapcraftercore/mc/world.h"
+#include "../mapcraftercore/mc/worldcache.h"
+#include "../mapcraftercore/renderer/fingerprints.h"
+#include "../mapcraftercore/renderer/image.h"
+#include "../mapcraftercore/renderer/tilerenderer.h"
 #include "../mapcraftercore/renderer/tileset.h"
+#include "../mapcraftercore/renderer/renderviews/isometric/tileset.h"
+#include "../mapcraftercore/renderer/renderviews/topdown/tileset.h"
 
+#include <algorithm>
+#include <limits>
 #include <map>
 #include <boost/test/unit_test.hpp>
 
+namespace mc = mapcrafter::mc;
 namespace renderer = mapcrafter::renderer;
 
 #define PATH(a, b, c, d) ((((renderer::TilePath() + a) + b) + c) + d)
@@ -51,3 +62,294 @@ BOOST_AUTO_TEST_CASE(test_tilepos) {
 	}
 	BOOST_CHECK_EQUAL(paths.size(), 256);
 }
+
+BOOST_AUTO_TEST_CASE(test_tilepath_key) {
+	renderer::TilePath path = PATH(1, 2, 3, 4);
+	BOOST_CHECK_EQUAL(path.getDepth(), 4);
+	BOOST_CHECK_EQUAL(path.toString(), "1/2/3/4");
+	BOOST_CHECK_EQUAL(path.parent(), PATH(1, 2, 3, 4).parent());
+	BOOST_CHECK_EQUAL(path.parent().toString(), "1/2/3");
+	BOOST_CHECK_EQUAL(renderer::TilePath::byKey(path.getKey()), path);
+	BOOST_CHECK_EQUAL(renderer::TilePath().getDepth(), 0);
+	BOOST_CHECK_EQUAL(renderer::TilePath().parent(), renderer::TilePath());
+
+	// paths are ordered by zoom level at first
+	BOOST_CHECK(renderer::TilePath() < renderer::TilePath() + 4);
+	BOOST_CHECK(renderer::TilePath() + 4 < PATH(1, 1, 1, 1));
+	BOOST_CHECK(PATH(1, 2, 3, 3) < path);
+
+	// the maximum zoom level still works with tile positions
+	int max_depth = renderer::TilePath::MAX_DEPTH;
+	renderer::TilePos pos(-(1 << (max_depth - 1)), (1 << (max_depth - 1)) - 1);
+	renderer::TilePath deepest = renderer::TilePath::byTilePos(pos, max_depth);
+	BOOST_CHECK_EQUAL(deepest.getDepth(), max_depth);
+	BOOST_CHECK_EQUAL(deepest.getTilePos(), pos);
+	BOOST_CHECK_THROW(deepest + 1, std::runtime_error);
+}
+
+template <typename TileSet>
+void checkTileSetScanRotation(int tile_width) {
+	mc::World world_unrotated("data");
+	BOOST_REQUIRE(world_unrotated.load());
+	renderer::ChunkIndex chunks;
+	chunks.read(world_unrotated, 4);
+	BOOST_CHECK_EQUAL(chunks.getChunks().size(), 120);
+
+	for (int rotation = 0; rotation < 4; rotation++) {
+		// scanning a rotated world and scanning the unrotated chunk index with
+		// a rotation has to result in the same tiles
+		mc::World world("data");
+		world.setRotation(rotation);
+		BOOST_REQUIRE(world.load());
+		TileSet tile_set1(tile_width), tile_set2(tile_width);
+		renderer::TilePos offset1, offset2;
+		tile_set1.scan(world, true, offset1);
+		tile_set2.scan(chunks, rotation, true, offset2);
+
+		BOOST_CHECK_EQUAL(offset1, offset2);
+		BOOST_CHECK_EQUAL(tile_set1.getDepth(), tile_set2.getDepth());
+		BOOST_CHECK(tile_set1.getRequiredRenderTiles() == tile_set2.getRequiredRenderTiles());
+		BOOST_CHECK(tile_set1.getRequiredCompositeTiles() == tile_set2.getRequiredCompositeTiles());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_tileset_scan_rotation) {
+	checkTileSetScanRotation<renderer::IsometricTileSet>(1);
+	checkTileSetScanRotation<renderer::IsometricTileSet>(3);
+	checkTileSetScanRotation<renderer::TopdownTileSet>(1);
+	checkTileSetScanRotation<renderer::TopdownTileSet>(2);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_tileset_composite_tiles, WorldFixture) {
+	renderer::ChunkIndex chunks;
+	chunks.read(world);
+
+	// use the median chunk timestamp to get only some required tiles
+	std::vector<uint32_t> timestamps;
+	for (auto it = chunks.getChunks().begin(); it != chunks.getChunks().end(); ++it)
+		timestamps.push_back(it->second);
+	std::sort(timestamps.begin(), timestamps.end());
+
+	renderer::IsometricTileSet tile_set(1);
+	renderer::TilePos offset;
+	tile_set.scan(chunks, 0, false, offset);
+	tile_set.setDepth(tile_set.getMinDepth() + 1);
+	tile_set.scanRequiredByTimestamp(timestamps[timestamps.size() / 2]);
+	BOOST_CHECK(tile_set.getRequiredRenderTilesCount() > 0);
+
+	// compare with the composite tiles and counts found the naive way
+	std::map<renderer::TilePath, int> containing;
+	const std::vector<renderer::TilePos>& render_tiles = tile_set.getRequiredRenderTiles();
+	for (auto it = render_tiles.begin(); it != render_tiles.end(); ++it) {
+		renderer::TilePath path = renderer::TilePath::byTilePos(*it, tile_set.getDepth());
+		BOOST_CHECK(tile_set.hasTile(path));
+		BOOST_CHECK(tile_set.isTileRequired(path));
+		while (path.getDepth() != 0) {
+			path = path.parent();
+			containing[path]++;
+		}
+	}
+
+	const std::vector<renderer::TilePath>& composite_tiles = tile_set.getRequiredCompositeTiles();
+	BOOST_CHECK_EQUAL(composite_tiles.size(), containing.size());
+	BOOST_CHECK(std::is_sorted(composite_tiles.begin(), composite_tiles.end()));
+	for (auto it = containing.begin(); it != containing.end(); ++it) {
+		BOOST_CHECK(tile_set.hasTile(it->first));
+		BOOST_CHECK(tile_set.isTileRequired(it->first));
+		BOOST_CHECK_EQUAL(tile_set.getContainingRenderTiles(it->first), it->second);
+	}
+	BOOST_CHECK_EQUAL(tile_set.getContainingRenderTiles(renderer::TilePath()),
+			tile_set.getRequiredRenderTilesCount());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_chunk_index_file, WorldFixture) {
+	renderer::ChunkIndex chunks1;
+	chunks1.read(world);
+	BOOST_CHECK_EQUAL(chunks1.getRegionsRead(), 1);
+	BOOST_REQUIRE(chunks1.writeFile("data/test.chunkindex"));
+
+	// the region file did not change, so nothing needs to be read again
+	renderer::ChunkIndex chunks2;
+	BOOST_REQUIRE(chunks2.readFile("data/test.chunkindex"));
+	chunks2.read(world);
+	BOOST_CHECK_EQUAL(chunks2.getRegionsRead(), 0);
+	BOOST_CHECK(chunks1.getChunks() == chunks2.getChunks());
+
+	// an index of another world is not used
+	mc::World world_rotated("data");
+	world_rotated.setRotation(1);
+	BOOST_REQUIRE(world_rotated.load());
+	BOOST_REQUIRE(chunks2.readFile("data/test.chunkindex"));
+	chunks2.read(world_rotated);
+	BOOST_CHECK_EQUAL(chunks2.getRegionsRead(), 1);
+	BOOST_CHECK_EQUAL(chunks2.getChunks().size(), 120);
+
+	boost::filesystem::remove("data/test.chunkindex");
+}
+
+BOOST_FIXTURE_TEST_CASE(test_chunk_fingerprints, WorldFixture) {
+	renderer::ChunkIndex chunks;
+	chunks.read(world);
+	const auto& index = chunks.getChunks();
+
+	// without stored fingerprints all chunks have changed
+	renderer::ChunkFingerprints cache, fingerprints;
+	auto changed = fingerprints.update(world, chunks, 0, cache, 4);
+	BOOST_CHECK_EQUAL(changed.size(), index.size());
+	BOOST_CHECK_EQUAL(fingerprints.size(), index.size());
+
+	// different chunks have different fingerprints
+	uint64_t fingerprint1, fingerprint2;
+	BOOST_REQUIRE(fingerprints.get(index[0].first, fingerprint1));
+	BOOST_REQUIRE(fingerprints.get(index[1].first, fingerprint2));
+	BOOST_CHECK(fingerprint1 != fingerprint2);
+
+	// nothing has changed now, the fingerprints are also the same when computed again
+	// and when written to a file and read again
+	renderer::ChunkFingerprints cache2;
+	BOOST_CHECK(fingerprints.update(world, chunks, 0, cache2, 1).empty());
+	BOOST_REQUIRE(fingerprints.writeFile("data/chunks.fingerprints"));
+	renderer::ChunkFingerprints read;
+	BOOST_REQUIRE(read.readFile("data/chunks.fingerprints"));
+	BOOST_CHECK(read.update(world, chunks, 0, cache, 1).empty());
+
+	// changed and removed chunks are detected, chunks older than the last
+	// change are not checked at all
+	read.set(index[0].first, fingerprint1 + 1);
+	read.set(mc::ChunkPos(1000, 1000), 42);
+	changed = read.update(world, chunks, 0, cache, 1);
+	BOOST_REQUIRE_EQUAL(changed.size(), 2);
+	BOOST_CHECK(std::count(changed.begin(), changed.end(), index[0].first));
+	BOOST_CHECK(std::count(changed.begin(), changed.end(), mc::ChunkPos(1000, 1000)));
+	BOOST_CHECK(!read.get(mc::ChunkPos(1000, 1000), fingerprint2));
+
+	read.set(index[0].first, fingerprint1 + 1);
+	BOOST_CHECK(read.update(world, chunks, std::numeric_limits<int>::max(), cache, 1).empty());
+
+	boost::filesystem::remove("data/chunks.fingerprints");
+}
+
+BOOST_FIXTURE_TEST_CASE(test_tile_fingerprints, WorldFixture) {
+	renderer::ChunkIndex chunks;
+	chunks.read(world);
+
+	renderer::TopdownTileSet tile_set(1);
+	renderer::TilePos offset;
+	tile_set.scan(chunks, 0, true, offset);
+	renderer::TilePath tile = renderer::TilePath::byTilePos(
+			tile_set.getRenderTiles()[0], tile_set.getDepth());
+
+	renderer::RGBAImage image1(16, 16), image2(16, 16);
+	image2.setPixel(3, 4, renderer::rgba(255, 0, 0, 255));
+	uint64_t fingerprint1 = renderer::TileFingerprints::compute(image1);
+	uint64_t fingerprint2 = renderer::TileFingerprints::compute(image2);
+	BOOST_CHECK(fingerprint1 != fingerprint2);
+	BOOST_CHECK(fingerprint1 != renderer::TileFingerprints::compute(renderer::RGBAImage(16, 8)));
+
+	// unknown tiles have always changed, known tiles only with different pixels
+	renderer::TileFingerprints fingerprints;
+	fingerprints.initialize(tile_set);
+	BOOST_CHECK(fingerprints.update(tile, fingerprint1));
+	BOOST_CHECK(!fingerprints.update(tile, fingerprint1));
+	BOOST_CHECK(fingerprints.update(tile, fingerprint2));
+	BOOST_CHECK(fingerprints.update(renderer::TilePath(), fingerprint1));
+
+	// the fingerprints are kept in the file for the same tile set depth only
+	BOOST_REQUIRE(fingerprints.writeFile("data/tiles.fingerprints"));
+	renderer::TileFingerprints read;
+	BOOST_REQUIRE(read.readFile("data/tiles.fingerprints"));
+	read.initialize(tile_set);
+	BOOST_CHECK(!read.update(tile, fingerprint2));
+
+	BOOST_REQUIRE(read.readFile("data/tiles.fingerprints"));
+	tile_set.setDepth(tile_set.getDepth() + 1);
+	read.initialize(tile_set);
+	tile = renderer::TilePath::byTilePos(tile_set.getRenderTiles()[0], tile_set.getDepth());
+	BOOST_CHECK(read.update(tile, fingerprint2));
+
+	boost::filesystem::remove("data/tiles.fingerprints");
+}
+
+BOOST_FIXTURE_TEST_CASE(test_tileset_changed_chunks, WorldFixture) {
+	renderer::ChunkIndex chunks;
+	chunks.read(world);
+	const auto& index = chunks.getChunks();
+
+	renderer::TopdownTileSet tile_set(2);
+	renderer::TilePos offset;
+	tile_set.scan(chunks, 0, true, offset);
+
+	// the changed chunks are only known when scanning by chunks
+	std::vector<mc::ChunkPos> changed;
+	tile_set.resetRequired();
+	BOOST_CHECK(!tile_set.getChangedChunks(tile_set.getRenderTiles()[0], changed));
+
+	std::vector<mc::ChunkPos> scan = {index[0].first, index[index.size() / 2].first};
+	tile_set.scanRequiredByChunks(scan, 0);
+	size_t count = 0;
+	const auto& required = tile_set.getRequiredRenderTiles();
+	for (auto it = required.begin(); it != required.end(); ++it) {
+		BOOST_REQUIRE(tile_set.getChangedChunks(*it, changed));
+		BOOST_CHECK(!changed.empty());
+		for (auto chunk_it = changed.begin(); chunk_it != changed.end(); ++chunk_it) {
+			std::set<renderer::TilePos> tiles;
+			tile_set.mapChunkToTiles(*chunk_it, tiles);
+			BOOST_CHECK(tiles.count(*it + offset));
+		}
+		count += changed.size();
+	}
+	BOOST_CHECK_EQUAL(count, scan.size());
+}
+
+BOOST_AUTO_TEST_CASE(test_tile_region) {
+	renderer::TileRegion region(10, 20, 30, 40);
+	BOOST_CHECK(!region.empty());
+	BOOST_CHECK(renderer::TileRegion(10, 20, 0, 40).empty());
+	BOOST_CHECK(region.intersects(0, 0, 11, 21));
+	BOOST_CHECK(!region.intersects(0, 0, 10, 21));
+	BOOST_CHECK(region.intersects(39, 59, 5, 5));
+	BOOST_CHECK(!region.intersects(40, 59, 5, 5));
+
+	std::vector<renderer::TileRegion> regions = {region, renderer::TileRegion(100, 100, 1, 1)};
+	BOOST_CHECK(renderer::intersectsRegions(regions, 100, 100, 1, 1));
+	BOOST_CHECK(!renderer::intersectsRegions(regions, 101, 100, 1, 1));
+}
+
+BOOST_FIXTURE_TEST_CASE(test_block_neighborhood, WorldFixture) {
+	mc::WorldCache cache(world);
+	mc::RegionFile* region = cache.getRegion(mc::RegionPos(-1, 0));
+	BOOST_REQUIRE(region != nullptr);
+
+	// blocks inside of the chunks and on their borders (also on the border of the
+	// region, where the neighbor chunks don't exist) and at the bottom and top
+	const int locals[] = {0, 1, 7, 14, 15};
+	const int heights[] = {0, 1, 63, 64, 254, 255};
+	const auto& chunks = region->getContainingChunks();
+	for (auto chunk_it = chunks.begin(); chunk_it != chunks.end(); ++chunk_it) {
+		const mc::Chunk* chunk = cache.getChunk(*chunk_it);
+		BOOST_REQUIRE(chunk != nullptr);
+		for (int x : locals)
+			for (int z : locals)
+				for (int y : heights) {
+					mc::BlockPos pos = mc::LocalBlockPos(x, z, y).toGlobalPos(*chunk_it);
+					// with and without the chunk of the center block given
+					renderer::BlockNeighborhood neighbors1(&cache, chunk, pos);
+					renderer::BlockNeighborhood neighbors2(&cache, nullptr, pos);
+					for (int dx = -1; dx <= 1; dx++)
+						for (int dz = -1; dz <= 1; dz++)
+							for (int dy = -1; dy <= 1; dy++) {
+								mc::BlockPos other = pos + mc::BlockPos(dx, dz, dy);
+								mc::Block expected = cache.getBlock(other, nullptr);
+								mc::Block block1 = neighbors1.get(dx, dz, dy);
+								mc::Block block2 = neighbors2.get(dx, dz, dy);
+								BOOST_CHECK_MESSAGE(block1.pos == other
+										&& block1.id == expected.id
+										&& block1.data == expected.data,
+										"Block " << other << " around " << pos << " differs!");
+								BOOST_CHECK_MESSAGE(block2.id == expected.id
+										&& block2.data == expected.data,
+										"Block " << other << " around " << pos << " differs!");
+							}
+				}
+	}
+}
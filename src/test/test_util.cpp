@@ -19,6 +19,10 @@
 
 #include "../mapcraftercore/util.h"
 
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
 #include <boost/test/unit_test.hpp>
 
 namespace util = mapcrafter::util;
@@ -47,3 +51,77 @@ BOOST_AUTO_TEST_CASE(util_testMath) {
 	BOOST_CHECK_EQUAL(util::binary<11011101>::value, 221);
 }
 
+
+BOOST_AUTO_TEST_CASE(util_testProfiling) {
+	util::ProfileCounters counters;
+
+	// nothing is measured without counters of this thread or if disabled
+	util::Profiler::setEnabled(true);
+	{
+		util::ProfileTimer timer(util::ProfileStage::BLIT);
+	}
+	util::Profiler::setEnabled(false);
+	util::Profiler::setThreadCounters(&counters);
+	{
+		util::ProfileTimer timer(util::ProfileStage::BLIT);
+	}
+	BOOST_CHECK_EQUAL(counters.getTotalTime(), 0);
+	BOOST_CHECK_EQUAL(counters.counts[(int) util::ProfileStage::BLIT], 0);
+
+	// the time of nested stages is not counted for the enclosing stage too,
+	// so all stages together can not take longer than the outermost one
+	util::Profiler::setEnabled(true);
+	auto start = std::chrono::steady_clock::now();
+	{
+		util::ProfileTimer walk(util::ProfileStage::ROW_WALK);
+		for (int i = 0; i < 3; i++) {
+			util::ProfileTimer blit(util::ProfileStage::BLIT);
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+	}
+	uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+	util::Profiler::setThreadCounters(nullptr);
+	util::Profiler::setEnabled(false);
+
+	BOOST_CHECK_EQUAL(counters.counts[(int) util::ProfileStage::ROW_WALK], 1);
+	BOOST_CHECK_EQUAL(counters.counts[(int) util::ProfileStage::BLIT], 3);
+	BOOST_CHECK(counters.times[(int) util::ProfileStage::BLIT] >= 6000000);
+	BOOST_CHECK(counters.getTotalTime() <= elapsed);
+
+	util::ProfileCounters sum;
+	sum.add(counters);
+	sum.add(counters);
+	BOOST_CHECK_EQUAL(sum.counts[(int) util::ProfileStage::BLIT], 6);
+	BOOST_CHECK_EQUAL(sum.getTotalTime(), 2 * counters.getTotalTime());
+}
+
+BOOST_AUTO_TEST_CASE(util_testMetrics) {
+	util::MetricsFormat format;
+	BOOST_CHECK(util::parseMetricsFormat("jsonl", format));
+	BOOST_CHECK(format == util::MetricsFormat::JSON_LINES);
+	BOOST_CHECK(!util::parseMetricsFormat("xml", format));
+
+	fs::path file = fs::temp_directory_path() / fs::unique_path("metrics-%%%%-%%%%.prom");
+	util::MetricsSink sink(file, util::MetricsFormat::PROMETHEUS);
+	util::MetricsSample sample;
+	sample.tiles_rendered = 3;
+	sample.chunks_decoded = 1;
+	sample.chunk_cache_hits = 3;
+	BOOST_CHECK_EQUAL(sample.getChunkCacheHitRate(), 0.75);
+	sink.write("world", "tl", sample);
+	sample.tiles_rendered = 5;
+	sink.write("world", "tl", sample);
+	sink.write("world", "br", sample);
+
+	// only the last sample of every map rotation is in the file
+	std::ifstream in(file.string().c_str());
+	std::stringstream content;
+	content << in.rdbuf();
+	BOOST_CHECK(content.str().find(
+			"mapcrafter_tiles_rendered{map=\"world\",rotation=\"tl\"} 5\n") != std::string::npos);
+	BOOST_CHECK(content.str().find(
+			"mapcrafter_tiles_rendered{map=\"world\",rotation=\"br\"} 5\n") != std::string::npos);
+	BOOST_CHECK(content.str().find("} 3\n") == std::string::npos);
+	fs::remove(file);
+}
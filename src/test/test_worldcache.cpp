@@ -0,0 +1,60 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fixtures.h"
+#include "../mapcraftercore/mc/worldcache.h"
+#include "../mapcraftercore/renderer/rendermode.h"
+#include "../mapcraftercore/renderer/tileset.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mapcrafter::renderer;
+namespace mc = mapcrafter::mc;
+
+BOOST_FIXTURE_TEST_CASE(worldcache_chunkData, WorldFixture) {
+	ChunkIndex chunks;
+	chunks.read(world);
+	BOOST_REQUIRE(!chunks.getChunks().empty());
+	mc::ChunkPos pos = chunks.getChunks()[0].first;
+
+	mc::WorldCache cache(world);
+	int slot1 = cache.addChunkDataSlot();
+	int slot2 = cache.addChunkDataSlot();
+	mc::Chunk* chunk = cache.getChunk(pos);
+	BOOST_REQUIRE(chunk != nullptr);
+	BOOST_CHECK(cache.getChunkData(chunk, slot1) == nullptr);
+
+	ChunkBlockGrid* grid = new ChunkBlockGrid(pos);
+	BOOST_REQUIRE(cache.setChunkData(chunk, slot2, grid));
+	BOOST_CHECK(cache.getChunkData(chunk, slot1) == nullptr);
+	BOOST_CHECK(cache.getChunkData(chunk, slot2) == grid);
+	BOOST_CHECK(cache.getChunk(pos) == chunk);
+	BOOST_CHECK(cache.getChunkData(chunk, slot2) == grid);
+
+	// the grid covers the chunk and a border of one block
+	mc::BlockPos origin = mc::LocalBlockPos(0, 0, 0).toGlobalPos(pos);
+	*grid->get(origin) = 42;
+	BOOST_CHECK_EQUAL(*grid->get(origin), 42);
+	BOOST_CHECK_EQUAL(*grid->get(origin + mc::BlockPos(1, 0, 0)), 0);
+	BOOST_CHECK(grid->get(origin + mc::BlockPos(-1, -1, -1)) != nullptr);
+	BOOST_CHECK(grid->get(origin + mc::BlockPos(16, 16, 256)) != nullptr);
+	BOOST_CHECK(grid->get(origin + mc::BlockPos(-2, 0, 0)) == nullptr);
+	BOOST_CHECK(grid->get(origin + mc::BlockPos(0, 17, 0)) == nullptr);
+	BOOST_CHECK(grid->get(origin + mc::BlockPos(0, 0, 257)) == nullptr);
+}
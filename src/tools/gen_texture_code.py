@@ -26,7 +26,12 @@ public:
 	BlockTextures();
 	~BlockTextures();
 
-	bool load(const std::string& block_dir, int size, int blur, double water_opacity);
+	/**
+	 * Loads all block textures from the 'blocks' directory. The textures are read and
+	 * processed with the specified count of threads.
+	 */
+	bool load(const std::string& block_dir, int size, int blur, double water_opacity,
+			int threads = 1);
 
 	TextureImage
 		%(texture_objects);
@@ -41,6 +46,7 @@ public:
 SOURCE_TEMPLATE = """#include "blocktextures.h"
 
 #include "../util.h"
+#include "../thread/parallel.h"
 
 #include <iostream>
 #include <boost/filesystem.hpp>
@@ -58,19 +64,23 @@ BlockTextures::BlockTextures()
 BlockTextures::~BlockTextures() {
 }
 
-/**
- * Loads all block textures from the 'blocks' directory.
- */
-bool BlockTextures::load(const std::string& block_dir, int size, int blur, double water_opacity) {
+bool BlockTextures::load(const std::string& block_dir, int size, int blur, double water_opacity,
+		int threads) {
 	if (!fs::exists(block_dir) || !fs::is_directory(block_dir)) {
 		LOG(ERROR) << "Directory '" << block_dir << "' with block textures does not exist.";
 		return false;
 	}
 
-	// go through all textures and load them
+	// go through all textures and load them,
+	// every texture is independent of the others, so they can be loaded in parallel
+	std::vector<char> loaded(textures.size());
+	thread::parallelFor(textures.size(), threads, [&](size_t i) {
+		loaded[i] = textures[i]->load(block_dir, size, blur, water_opacity);
+	});
+
 	bool loaded_all = true;
 	for (size_t i = 0; i < textures.size(); i++) {
-		if (!textures[i]->load(block_dir, size, blur, water_opacity)) {
+		if (!loaded[i]) {
 			LOG(WARNING) << "Unable to load block texture '" << textures[i]->getName() << ".png'.";
 			loaded_all = false;
 		}